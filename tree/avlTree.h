@@ -2,36 +2,87 @@
 #define __AVL_TREE_H__
 
 #include <cstddef>
+#include <cstdint>
 #include <utility>
 #include <algorithm>
 #include <list>
+#include <vector>
 
-template <class K, class V>
+#include "prefetch.h"
+#include "eytzinger.h"
+#include "treeIterator.h"
+
+template <class K, class V, class Prefetch = NoPrefetch, bool Compact = false>
 class AVLTree
 {
 public:
 
-    struct Node
+    // Node with the balance factor, the height of the left subtree less
+    // that of the right one, in a field of its own.
+    template <bool IsCompact, class Unused = void>
+    struct NodeLayout
     {
         typedef std::pair<const K, V> elem_type;
         typedef elem_type* elem_ptr;
         typedef size_t size_type;
 
         elem_type element;
-        size_type height;
-        Node *leftChild, *rightChild;
+        signed char balance;
+        NodeLayout *leftChild, *rightChild;
+
+        NodeLayout(const elem_type & element)
+            : element(element), balance(0), leftChild(NULL), rightChild(NULL) {}
+
+        NodeLayout * left() const { return leftChild; }
+        NodeLayout * right() const { return rightChild; }
+        void setLeft(NodeLayout * t) { leftChild = t; }
+        void setRight(NodeLayout * t) { rightChild = t; }
+
+        int getBalance() const { return balance; }
+        void setBalance(int b) { balance = b; }
+    };
+
+    // Node for large trees of small elements. The balance factor, one of
+    // -1, 0 and 1, is kept plus one in the two low bits of the right child
+    // pointer, which node alignment leaves free.
+    template <class Unused>
+    struct NodeLayout<true, Unused>
+    {
+        typedef std::pair<const K, V> elem_type;
+        typedef elem_type* elem_ptr;
+        typedef size_t size_type;
 
-        Node(const elem_type & element)
-            : element(element), height(1), leftChild(NULL), rightChild(NULL) {}
+        static const uintptr_t BALANCE_MASK = 3;
 
-        Node(const elem_type & element, Node * leftChild, Node * rightChild)
-            : element(element), height(1), 
-            leftChild(leftChild), rightChild(rightChild) {}
+        elem_type element;
+        NodeLayout * leftChild;
+        uintptr_t rightAndBalance;
+
+        NodeLayout(const elem_type & element)
+            : element(element), leftChild(NULL), rightAndBalance(1) {}
+
+        NodeLayout * left() const { return leftChild; }
+        NodeLayout * right() const
+        {
+            return reinterpret_cast<NodeLayout *>(rightAndBalance & ~BALANCE_MASK);
+        }
+        void setLeft(NodeLayout * t) { leftChild = t; }
+        void setRight(NodeLayout * t)
+        {
+            rightAndBalance = reinterpret_cast<uintptr_t>(t) |
+                    (rightAndBalance & BALANCE_MASK);
+        }
+
+        int getBalance() const { return int(rightAndBalance & BALANCE_MASK) - 1; }
+        void setBalance(int b)
+        {
+            rightAndBalance = (rightAndBalance & ~BALANCE_MASK) | uintptr_t(b + 1);
+        }
     };
 
 public:
 
-    typedef Node node_type;
+    typedef NodeLayout<Compact> node_type;
 
     typedef node_type* node_ptr;
 
@@ -41,8 +92,13 @@ public:
 
     typedef typename node_type::size_type size_type;
 
+    typedef BinaryTreeIterator<node_type> iterator;
+
     typedef int bf_type;
 
+    static_assert(alignof(NodeLayout<true>) > NodeLayout<true>::BALANCE_MASK,
+            "the balance factor must fit in the alignment bits");
+
 public:
 
     AVLTree();
@@ -57,6 +113,16 @@ public:
 
     elem_ptr find(const K &) const;
 
+    iterator begin() const;
+
+    iterator end() const;
+
+    iterator lower_bound(const K &) const;
+
+    iterator upper_bound(const K &) const;
+
+    std::pair<iterator, iterator> equal_range(const K &) const;
+
     void insert(const K &, const V &);
 
     void erase(const K &);
@@ -69,19 +135,18 @@ public:
 
     void levelOrder(void (*) (node_ptr));
 
-private:
-
-    static node_ptr insertRecursion(node_ptr, const K &, const V &);
+    EytzingerIndex<K, V> freeze() const;
 
-    static node_ptr eraseRecursion(node_ptr, const K &, bool & found);
+private:
 
-    static node_ptr rebalance(node_ptr);
+    static node_ptr insertRecursion(node_ptr, const K &, const V &,
+            bool & added, bool & grown);
 
-    static size_type updateHeight(node_ptr);
+    static node_ptr eraseRecursion(node_ptr, const K &, bool & found, bool & shrunk);
 
-    static bf_type getBF(node_ptr);
+    static node_ptr eraseLargest(node_ptr, node_ptr &, bool & shrunk);
 
-    static size_type heightRecursion(node_ptr);
+    static node_ptr rebalance(node_ptr, bf_type);
 
     static void preOrderRecursion(node_ptr, void (*) (node_ptr));
 
@@ -89,6 +154,8 @@ private:
 
     static void postOrderRecursion(node_ptr, void (*) (node_ptr));
 
+    static void freezeRecursion(node_ptr, std::vector<std::pair<K, V> > &);
+
     static node_ptr rotateLL(node_ptr);
 
     static node_ptr rotateRR(node_ptr);
@@ -97,57 +164,67 @@ private:
 
     static node_ptr rotateRL(node_ptr);
 
-    static node_ptr insertToBottomRight(node_ptr, node_ptr);
-
 protected:
     node_ptr mRoot;
     size_type mTreeSize;
 };
 
-template <class K, class V>
-AVLTree<K, V>::AVLTree()
+template <class K, class V, class Prefetch, bool Compact>
+AVLTree<K, V, Prefetch, Compact>::AVLTree()
     : mRoot(NULL), mTreeSize(0)
 {
 
 }
 
-template <class K, class V>
-AVLTree<K, V>::~AVLTree()
+template <class K, class V, class Prefetch, bool Compact>
+AVLTree<K, V, Prefetch, Compact>::~AVLTree()
 {
     clear();
 }
 
-template <class K, class V>
-typename AVLTree<K, V>::size_type
-AVLTree<K, V>::height() const
+template <class K, class V, class Prefetch, bool Compact>
+typename AVLTree<K, V, Prefetch, Compact>::size_type
+AVLTree<K, V, Prefetch, Compact>::height() const
 {
-    return heightRecursion(this->mRoot);
+    size_type result = 0;
+    for (node_ptr t = this->mRoot; t != NULL;
+            t = t->getBalance() < 0 ? t->right() : t->left())
+        result++;
+
+    return result;
 }
 
-template <class K, class V>
-bool AVLTree<K, V>::empty() const
+template <class K, class V, class Prefetch, bool Compact>
+bool AVLTree<K, V, Prefetch, Compact>::empty() const
 {
     return mTreeSize == 0;
 }
 
-template <class K, class V>
-void AVLTree<K, V>::clear()
+template <class K, class V, class Prefetch, bool Compact>
+void AVLTree<K, V, Prefetch, Compact>::clear()
 {
     postOrder([](node_ptr t){delete t;});
+
+    this->mRoot = NULL;
+    this->mTreeSize = 0;
 }
 
-template <class K, class V>
-typename AVLTree<K, V>::elem_ptr
-AVLTree<K, V>::find(const K & key) const
+template <class K, class V, class Prefetch, bool Compact>
+typename AVLTree<K, V, Prefetch, Compact>::elem_ptr
+AVLTree<K, V, Prefetch, Compact>::find(const K & key) const
 {
     node_ptr p = this->mRoot;
 
     while (p != NULL)
     {
+        // The next node is one of the two children; fetch both.
+        Prefetch::range(p->left(), sizeof(node_type));
+        Prefetch::range(p->right(), sizeof(node_type));
+
         if (key < p->element.first)
-            p = p->leftChild;
+            p = p->left();
         else if (key > p->element.first)
-            p = p->rightChild;
+            p = p->right();
         else
             return &p->element;
     }
@@ -155,52 +232,86 @@ AVLTree<K, V>::find(const K & key) const
     return NULL;
 }
 
-template <class K, class V>
-void AVLTree<K, V>::insert(const K & key, const V & value)
+template <class K, class V, class Prefetch, bool Compact>
+typename AVLTree<K, V, Prefetch, Compact>::iterator
+AVLTree<K, V, Prefetch, Compact>::begin() const
 {
-    if (this->mRoot == NULL)
-        this->mRoot = new node_type(elem_type(key, value));
-    else
-        this->mRoot = insertRecursion(this->mRoot, key, value);
+    return iterator::first(&mRoot);
+}
+
+template <class K, class V, class Prefetch, bool Compact>
+typename AVLTree<K, V, Prefetch, Compact>::iterator
+AVLTree<K, V, Prefetch, Compact>::end() const
+{
+    return iterator(&mRoot);
+}
 
-    this->mTreeSize++;
+template <class K, class V, class Prefetch, bool Compact>
+typename AVLTree<K, V, Prefetch, Compact>::iterator
+AVLTree<K, V, Prefetch, Compact>::lower_bound(const K & key) const
+{
+    return iterator::lowerBound(&mRoot, key);
+}
 
-    rebalance(this->mRoot);
+template <class K, class V, class Prefetch, bool Compact>
+typename AVLTree<K, V, Prefetch, Compact>::iterator
+AVLTree<K, V, Prefetch, Compact>::upper_bound(const K & key) const
+{
+    return iterator::upperBound(&mRoot, key);
 }
 
-template <class K, class V>
-void AVLTree<K, V>::erase(const K & key)
+template <class K, class V, class Prefetch, bool Compact>
+std::pair<typename AVLTree<K, V, Prefetch, Compact>::iterator, typename AVLTree<K, V, Prefetch, Compact>::iterator>
+AVLTree<K, V, Prefetch, Compact>::equal_range(const K & key) const
 {
-    if (this->mRoot == NULL)
-        return;
+    iterator first = lower_bound(key);
+    iterator last = first;
+    if (first != end() && !(key < first->first))
+        ++last;
 
-    bool found = false;
-    this->mRoot = eraseRecursion(this->mRoot, key, found);
+    return std::make_pair(first, last);
+}
 
-    if (found)
+template <class K, class V, class Prefetch, bool Compact>
+void AVLTree<K, V, Prefetch, Compact>::insert(const K & key, const V & value)
+{
+    bool added = false, grown = false;
+    this->mRoot = insertRecursion(this->mRoot, key, value, added, grown);
+
+    if (added)
         this->mTreeSize++;
 }
 
-template <class K, class V>
-void AVLTree<K, V>::preOrder(void (* visit) (node_ptr))
+template <class K, class V, class Prefetch, bool Compact>
+void AVLTree<K, V, Prefetch, Compact>::erase(const K & key)
+{
+    bool found = false, shrunk = false;
+    this->mRoot = eraseRecursion(this->mRoot, key, found, shrunk);
+
+    if (found)
+        this->mTreeSize--;
+}
+
+template <class K, class V, class Prefetch, bool Compact>
+void AVLTree<K, V, Prefetch, Compact>::preOrder(void (* visit) (node_ptr))
 {
     preOrderRecursion(this->mRoot, visit);
 }
 
-template <class K, class V>
-void AVLTree<K, V>::inOrder(void (* visit) (node_ptr))
+template <class K, class V, class Prefetch, bool Compact>
+void AVLTree<K, V, Prefetch, Compact>::inOrder(void (* visit) (node_ptr))
 {
     inOrderRecursion(this->mRoot, visit);
 }
 
-template <class K, class V>
-void AVLTree<K, V>::postOrder(void (* visit) (node_ptr))
+template <class K, class V, class Prefetch, bool Compact>
+void AVLTree<K, V, Prefetch, Compact>::postOrder(void (* visit) (node_ptr))
 {
     postOrderRecursion(this->mRoot, visit);
 }
 
-template <class K, class V>
-void AVLTree<K, V>::levelOrder(void (* visit) (node_ptr))
+template <class K, class V, class Prefetch, bool Compact>
+void AVLTree<K, V, Prefetch, Compact>::levelOrder(void (* visit) (node_ptr))
 {    
     std::list<node_ptr> l;
     node_ptr t = this->mRoot;
@@ -209,10 +320,10 @@ void AVLTree<K, V>::levelOrder(void (* visit) (node_ptr))
     {
         visit(t);
 
-        if (t->leftChild != NULL)
-            l.push_back(t->leftChild);
-        if (t->rightChild != NULL)
-            l.push_back(t->rightChild);
+        if (t->left() != NULL)
+            l.push_back(t->left());
+        if (t->right() != NULL)
+            l.push_back(t->right());
 
         if (l.empty())
             return;
@@ -223,192 +334,271 @@ void AVLTree<K, V>::levelOrder(void (* visit) (node_ptr))
 
 }
 
-template <class K, class V>
-typename AVLTree<K, V>::node_ptr
-AVLTree<K, V>::insertRecursion(AVLTree<K, V>::node_ptr t, const K & key, const V & value)
+// Copies the elements into a read-only index for faster searches; later
+// changes to the tree do not reach it.
+template <class K, class V, class Prefetch, bool Compact>
+EytzingerIndex<K, V> AVLTree<K, V, Prefetch, Compact>::freeze() const
+{
+    std::vector<std::pair<K, V> > elements;
+    elements.reserve(this->mTreeSize);
+    freezeRecursion(this->mRoot, elements);
+
+    return EytzingerIndex<K, V>(elements.begin(), elements.end());
+}
+
+template <class K, class V, class Prefetch, bool Compact>
+typename AVLTree<K, V, Prefetch, Compact>::node_ptr
+AVLTree<K, V, Prefetch, Compact>::insertRecursion(node_ptr t, const K & key, const V & value,
+        bool & added, bool & grown)
 {
+    if (t == NULL)
+    {
+        added = grown = true;
+        return new node_type(elem_type(key, value));
+    }
+
     if (key < t->element.first)
-        if (t->leftChild == NULL)
-            t->leftChild = new node_type(elem_type(key, value));
-        else
-            t->leftChild = insertRecursion(t->leftChild, key, value);
+    {
+        t->setLeft(insertRecursion(t->left(), key, value, added, grown));
+        if (grown)
+        {
+            t = rebalance(t, 1);
+            grown = t->getBalance() != 0;
+        }
+    }
+    else if (key > t->element.first)
+    {
+        t->setRight(insertRecursion(t->right(), key, value, added, grown));
+        if (grown)
+        {
+            t = rebalance(t, -1);
+            grown = t->getBalance() != 0;
+        }
+    }
     else
-        if (t->rightChild == NULL)
-            t->rightChild = new node_type(elem_type(key, value));
-        else
-            t->rightChild = insertRecursion(t->rightChild, key, value);
+        t->element.second = value;
 
-    return rebalance(t);
+    return t;
 }
 
-template <class K, class V>
-typename AVLTree<K, V>::node_ptr
-AVLTree<K, V>::eraseRecursion(AVLTree<K, V>::node_ptr t, const K & key, bool & found)
+// A node with two children is replaced by the largest node of its left
+// subtree. A subtree is one shorter afterwards exactly when its new root
+// is balanced: either it leaned to the side that lost a level, or a
+// rotation evened it out.
+template <class K, class V, class Prefetch, bool Compact>
+typename AVLTree<K, V, Prefetch, Compact>::node_ptr
+AVLTree<K, V, Prefetch, Compact>::eraseRecursion(node_ptr t, const K & key, bool & found, bool & shrunk)
 {
-    node_ptr newRoot = t;
+    if (t == NULL)
+        return NULL;
 
-    if (key == t->element.first)
+    if (key < t->element.first)
     {
-        if (t->leftChild != NULL && t->rightChild != NULL)
-            t->leftChild = insertToBottomRight(t->leftChild, t->rightChild);
+        t->setLeft(eraseRecursion(t->left(), key, found, shrunk));
+        if (shrunk)
+        {
+            t = rebalance(t, -1);
+            shrunk = t->getBalance() == 0;
+        }
+        return t;
+    }
 
-        newRoot = t->leftChild;
-        found = true;
-        delete t;
+    if (key > t->element.first)
+    {
+        t->setRight(eraseRecursion(t->right(), key, found, shrunk));
+        if (shrunk)
+        {
+            t = rebalance(t, 1);
+            shrunk = t->getBalance() == 0;
+        }
+        return t;
     }
-    else
+
+    found = true;
+
+    if (t->left() == NULL || t->right() == NULL)
     {
-        if (key < t->element.first)
-            t->leftChild = eraseRecursion(t->leftChild, key, found);
-        else if (key > t->element.first)
-            t->rightChild = eraseRecursion(t->rightChild, key, found);
+        node_ptr child = t->left() != NULL ? t->left() : t->right();
+        delete t;
+        shrunk = true;
+        return child;
+    }
 
-        newRoot = rebalance(newRoot);
+    node_ptr largest;
+    node_ptr left = eraseLargest(t->left(), largest, shrunk);
+
+    largest->setLeft(left);
+    largest->setRight(t->right());
+    largest->setBalance(t->getBalance());
+    delete t;
+
+    if (shrunk)
+    {
+        largest = rebalance(largest, -1);
+        shrunk = largest->getBalance() == 0;
     }
 
-    return newRoot;
+    return largest;
 }
 
-template <class K, class V>
-typename AVLTree<K, V>::node_ptr
-AVLTree<K, V>::rebalance(AVLTree<K, V>::node_ptr t)
+// Unlinks the largest node of the subtree under t and hands it out in
+// largest.
+template <class K, class V, class Prefetch, bool Compact>
+typename AVLTree<K, V, Prefetch, Compact>::node_ptr
+AVLTree<K, V, Prefetch, Compact>::eraseLargest(node_ptr t, node_ptr & largest,
+        bool & shrunk)
 {
-    updateHeight(t);
-
-    if (getBF(t) == 2)
+    if (t->right() == NULL)
     {
-        if (getBF(t->leftChild) == -1)
-            return rotateLR(t);
-        return rotateLL(t);
+        largest = t;
+        shrunk = true;
+        return t->left();
     }
-    else if (getBF(t) == -2)
+
+    t->setRight(eraseLargest(t->right(), largest, shrunk));
+    if (shrunk)
     {
-        if (getBF(t->rightChild) == 1)
-            return rotateRL(t);
-        return rotateRR(t);
+        t = rebalance(t, 1);
+        shrunk = t->getBalance() == 0;
     }
 
     return t;
 }
 
-template <class K, class V>
-typename AVLTree<K, V>::size_type
-AVLTree<K, V>::updateHeight(node_ptr t)
+// Adds change to the balance factor of t after one of its subtrees grew or
+// shrank by a level, rotating when t leans two levels to one side. The
+// factors are updated from the ones stored, without looking at heights.
+template <class K, class V, class Prefetch, bool Compact>
+typename AVLTree<K, V, Prefetch, Compact>::node_ptr
+AVLTree<K, V, Prefetch, Compact>::rebalance(node_ptr t, bf_type change)
 {
-    size_type l = heightRecursion(t->leftChild);
-    size_type r = heightRecursion(t->rightChild);
+    bf_type balance = t->getBalance() + change;
 
-    t->height = std::max(l, r) + 1;
+    if (balance == 2)
+        return t->left()->getBalance() >= 0 ? rotateLL(t) : rotateLR(t);
+    if (balance == -2)
+        return t->right()->getBalance() <= 0 ? rotateRR(t) : rotateRL(t);
 
-    return t->height;
-}
-
-template <class K, class V>
-typename AVLTree<K, V>::bf_type
-AVLTree<K, V>::getBF(AVLTree::node_ptr t)
-{
-    return heightRecursion(t->leftChild) - heightRecursion(t->rightChild);
+    t->setBalance(balance);
+    return t;
 }
 
-template <class K, class V>
-typename AVLTree<K, V>::size_type
-AVLTree<K, V>::heightRecursion(node_ptr t)
+template <class K, class V, class Prefetch, bool Compact>
+void AVLTree<K, V, Prefetch, Compact>::preOrderRecursion(node_ptr t, void (* visit) (node_ptr))
 {
-    if (t == NULL)
-        return 0;
-
-    return t->height;
+    if (t != NULL)
+    {
+        visit(t);
+        preOrderRecursion(t->left(), visit);
+        preOrderRecursion(t->right(), visit);
+    }
 }
 
-template <class K, class V>
-void AVLTree<K, V>::preOrderRecursion(node_ptr t, void (* visit) (node_ptr))
+template <class K, class V, class Prefetch, bool Compact>
+void AVLTree<K, V, Prefetch, Compact>::inOrderRecursion(node_ptr t, void (* visit) (node_ptr))
 {
     if (t != NULL)
     {
+        inOrderRecursion(t->left(), visit);
         visit(t);
-        preOrderRecursion(t->leftChild, visit);
-        preOrderRecursion(t->rightChild, visit);
+        inOrderRecursion(t->right(), visit);
     }
 }
 
-template <class K, class V>
-void AVLTree<K, V>::inOrderRecursion(node_ptr t, void (* visit) (node_ptr))
+template <class K, class V, class Prefetch, bool Compact>
+void AVLTree<K, V, Prefetch, Compact>::postOrderRecursion(node_ptr t, void (* visit) (node_ptr))
 {
     if (t != NULL)
     {
-        inOrderRecursion(t->leftChild, visit);
+        postOrderRecursion(t->left(), visit);
+        postOrderRecursion(t->right(), visit);
         visit(t);
-        inOrderRecursion(t->rightChild, visit);
     }
 }
 
-template <class K, class V>
-void AVLTree<K, V>::postOrderRecursion(node_ptr t, void (* visit) (node_ptr))
+template <class K, class V, class Prefetch, bool Compact>
+void AVLTree<K, V, Prefetch, Compact>::freezeRecursion(node_ptr t,
+        std::vector<std::pair<K, V> > & elements)
 {
     if (t != NULL)
     {
-        postOrderRecursion(t->leftChild, visit);
-        postOrderRecursion(t->rightChild, visit);
-        visit(t);
+        freezeRecursion(t->left(), elements);
+        elements.push_back(t->element);
+        freezeRecursion(t->right(), elements);
     }
 }
 
-template <class K, class V>
-typename AVLTree<K, V>::node_ptr
-AVLTree<K, V>::rotateLL(AVLTree<K, V>::node_ptr t)
+template <class K, class V, class Prefetch, bool Compact>
+typename AVLTree<K, V, Prefetch, Compact>::node_ptr
+AVLTree<K, V, Prefetch, Compact>::rotateLL(node_ptr t)
 {
-    node_ptr newRoot = t->leftChild;
-    t->leftChild = newRoot->rightChild;
-    newRoot->rightChild = t;
+    node_ptr newRoot = t->left();
+    t->setLeft(newRoot->right());
+    newRoot->setRight(t);
 
-    updateHeight(t);
-    updateHeight(newRoot);
+    // The left child leaned left (1) or, after an erase, not at all (0).
+    bf_type balance = newRoot->getBalance();
+    t->setBalance(1 - balance);
+    newRoot->setBalance(balance - 1);
 
     return newRoot;
 }
 
-template <class K, class V>
-typename AVLTree<K, V>::node_ptr
-AVLTree<K, V>::rotateRR(AVLTree<K, V>::node_ptr t)
+template <class K, class V, class Prefetch, bool Compact>
+typename AVLTree<K, V, Prefetch, Compact>::node_ptr
+AVLTree<K, V, Prefetch, Compact>::rotateRR(node_ptr t)
 {
-    node_ptr newRoot = t->rightChild;
-    t->rightChild = newRoot->leftChild;
-    newRoot->leftChild = t;
+    node_ptr newRoot = t->right();
+    t->setRight(newRoot->left());
+    newRoot->setLeft(t);
 
-    updateHeight(t);
-    updateHeight(newRoot);
+    bf_type balance = newRoot->getBalance();
+    t->setBalance(-1 - balance);
+    newRoot->setBalance(balance + 1);
 
     return newRoot;
 }
 
-template <class K, class V>
-typename AVLTree<K, V>::node_ptr
-AVLTree<K, V>::rotateLR(AVLTree<K, V>::node_ptr t)
+// The grandchild becomes the root, balanced; whichever of its subtrees was
+// the shorter one leaves its new parent leaning the other way.
+template <class K, class V, class Prefetch, bool Compact>
+typename AVLTree<K, V, Prefetch, Compact>::node_ptr
+AVLTree<K, V, Prefetch, Compact>::rotateLR(node_ptr t)
 {
-    t->leftChild = rotateRR(t->leftChild);
-    return rotateLL(t);
-}
+    node_ptr child = t->left();
+    node_ptr newRoot = child->right();
+    bf_type balance = newRoot->getBalance();
 
-template <class K, class V>
-typename AVLTree<K, V>::node_ptr
-AVLTree<K, V>::rotateRL(AVLTree<K, V>::node_ptr t)
-{
-    t->rightChild = rotateLL(t->rightChild);
-    return rotateRR(t);
+    child->setRight(newRoot->left());
+    t->setLeft(newRoot->right());
+    newRoot->setLeft(child);
+    newRoot->setRight(t);
+
+    child->setBalance(balance < 0 ? 1 : 0);
+    t->setBalance(balance > 0 ? -1 : 0);
+    newRoot->setBalance(0);
+
+    return newRoot;
 }
 
-template <class K, class V>
-typename AVLTree<K, V>::node_ptr
-AVLTree<K, V>::insertToBottomRight(
-        AVLTree<K, V>::node_ptr t,
-        AVLTree<K, V>::node_ptr n)
+template <class K, class V, class Prefetch, bool Compact>
+typename AVLTree<K, V, Prefetch, Compact>::node_ptr
+AVLTree<K, V, Prefetch, Compact>::rotateRL(node_ptr t)
 {
-    if (t->rightChild == NULL)
-        t->rightChild = n;
-    else
-        t->rightChild = insertToBottomRight(t->rightChild, n);
+    node_ptr child = t->right();
+    node_ptr newRoot = child->left();
+    bf_type balance = newRoot->getBalance();
+
+    child->setLeft(newRoot->right());
+    t->setRight(newRoot->left());
+    newRoot->setRight(child);
+    newRoot->setLeft(t);
 
-    return rebalance(t);
+    child->setBalance(balance > 0 ? -1 : 0);
+    t->setBalance(balance < 0 ? 1 : 0);
+    newRoot->setBalance(0);
+
+    return newRoot;
 }
 
 #endif//__AVL_TREE_H__
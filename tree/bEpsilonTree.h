@@ -0,0 +1,845 @@
+#ifndef __B_EPSILON_TREE_H__
+#define __B_EPSILON_TREE_H__
+
+#include <vector>
+#include <cstddef>
+#include <utility>
+#include <algorithm>
+#include <functional>
+
+// Write-optimised B+ tree (B-epsilon tree).
+//
+// Internal nodes carry buffers of pending messages besides their pivots,
+// one sorted buffer per child. insert, erase and upsert only add a message
+// to the root; when the messages of a node exceed BufferSize, the largest
+// child buffer moves down one level in a single batch, and only batches
+// that reach a leaf change it. A buffer holds at most one message per key:
+// a newer message for the same key is folded into the older one. Lookups
+// fold the messages met on the way down into the leaf value.
+//
+// upsert(key, delta) sets the value to Combine()(old, delta), or to delta
+// if the key is absent; Combine has to be associative.
+//
+// Node contents are vectors because a flush changes node sizes by whole
+// batches; nodes are split and merged after each flush.
+template <class K, class V, size_t N, size_t BufferSize = 32 * N,
+        class Combine = std::plus<V> >
+class BEpsilonTree
+{
+public:
+
+    enum MessageType
+    {
+        MESSAGE_INSERT,
+        MESSAGE_ERASE,
+        MESSAGE_UPSERT
+    };
+
+    struct Message
+    {
+        K key;
+        V value;
+        MessageType type;
+    };
+
+    typedef std::vector<Message> buffer_type;
+
+    struct Node
+    {
+        typedef size_t size_type;
+
+        bool leaf;
+        std::vector<K> keys;
+
+        Node(bool leaf)
+            : leaf(leaf) {}
+    };
+
+    struct InnerNode : Node
+    {
+        std::vector<Node *> children;
+        std::vector<buffer_type> buffers;
+        size_t buffered;
+
+        InnerNode()
+            : Node(false), buffered(0) {}
+    };
+
+    struct LeafNode : Node
+    {
+        std::vector<V> values;
+
+        LeafNode()
+            : Node(true) {}
+    };
+
+    typedef Node node_type;
+    typedef node_type* node_ptr;
+    typedef InnerNode* inner_ptr;
+    typedef LeafNode* leaf_ptr;
+    typedef K key_type;
+    typedef V value_type;
+    typedef typename node_type::size_type size_type;
+
+    static_assert(N >= 4, "B-epsilon tree needs a fan-out of at least 4");
+
+public:
+
+    BEpsilonTree();
+
+    ~BEpsilonTree();
+
+    size_type size() const;
+
+    size_type height() const;
+
+    bool empty() const;
+
+    bool find(const K &, V &) const;
+
+    void insert(const K &, const V &);
+
+    void erase(const K &);
+
+    void upsert(const K &, const V &);
+
+    void flush();
+
+    void clear();
+
+    void preOrder(void (*) (node_ptr));
+
+    void inOrder(void (*) (const K &, V &));
+
+    void postOrder(void (*) (node_ptr));
+
+private:
+
+    // Leaves are as large as node buffers, so that a batch lands in a
+    // leaf without splitting it many times.
+    static const size_t MAX_KEYS = BufferSize;
+
+    static const size_t MIN_KEYS = BufferSize / 2;
+
+    static const size_t MAX_CHILDREN = N;
+
+    static const size_t MIN_CHILDREN = (N + 1) / 2;
+
+    BEpsilonTree(const BEpsilonTree &);
+
+    BEpsilonTree & operator = (const BEpsilonTree &);
+
+    void put(const Message &);
+
+    void repairRoot();
+
+    void flushNode(inner_ptr);
+
+    void flushAllRecursion(node_ptr);
+
+    void pushDown(inner_ptr, size_t, const buffer_type &);
+
+    void applyToLeaf(leaf_ptr, const buffer_type &);
+
+    void applyToLeaf(leaf_ptr, const Message &);
+
+    static void repairNode(inner_ptr, size_t);
+
+    static size_t childIndex(node_ptr, const K &);
+
+    static size_t messageIndex(const buffer_type &, const K &);
+
+    static void addMessage(inner_ptr, size_t, const Message &);
+
+    static void addMessages(inner_ptr, const buffer_type &);
+
+    static void mergeMessages(buffer_type &, const Message *, const Message *);
+
+    static void foldMessage(Message &, const Message &);
+
+    static size_t count(node_ptr);
+
+    static void splitNode(inner_ptr, size_t);
+
+    static void mergeNodes(inner_ptr, size_t);
+
+    static void deleteNode(node_ptr);
+
+    static void preOrderRecursion(node_ptr, void (*) (node_ptr));
+
+    static void inOrderRecursion(node_ptr, void (*) (const K &, V &));
+
+    static void postOrderRecursion(node_ptr, void (*) (node_ptr));
+
+    node_ptr mRoot;
+
+    size_type mTreeSize;
+
+};
+
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+BEpsilonTree<K, V, N, BufferSize, Combine>::BEpsilonTree()
+    : mRoot(new LeafNode()), mTreeSize(0)
+{
+
+}
+
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+BEpsilonTree<K, V, N, BufferSize, Combine>::~BEpsilonTree()
+{
+    postOrderRecursion(mRoot, deleteNode);
+}
+
+// Elements in the leaves; messages still buffered are not counted until
+// they reach a leaf, so call flush() first for an exact count. The same
+// holds for empty().
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+typename BEpsilonTree<K, V, N, BufferSize, Combine>::size_type
+BEpsilonTree<K, V, N, BufferSize, Combine>::size() const
+{
+    return mTreeSize;
+}
+
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+typename BEpsilonTree<K, V, N, BufferSize, Combine>::size_type
+BEpsilonTree<K, V, N, BufferSize, Combine>::height() const
+{
+    size_type h = 1;
+
+    for (node_ptr t = mRoot; !t->leaf; t = inner_ptr(t)->children[0])
+        h++;
+
+    return h;
+}
+
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+bool BEpsilonTree<K, V, N, BufferSize, Combine>::empty() const
+{
+    return mTreeSize == 0;
+}
+
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+bool BEpsilonTree<K, V, N, BufferSize, Combine>::find(const K & key,
+        V & value) const
+{
+    // Upserts met so far, folded into one delta.
+    bool pending = false;
+    V delta = V();
+
+    node_ptr t = mRoot;
+    while (!t->leaf)
+    {
+        inner_ptr inner = inner_ptr(t);
+        size_t child = childIndex(inner, key);
+        const buffer_type & buffer = inner->buffers[child];
+        size_t index = messageIndex(buffer, key);
+
+        if (index < buffer.size() && buffer[index].key == key)
+        {
+            const Message & message = buffer[index];
+
+            if (message.type == MESSAGE_INSERT)
+            {
+                value = pending ? Combine()(message.value, delta) : message.value;
+                return true;
+            }
+
+            if (message.type == MESSAGE_ERASE)
+            {
+                value = delta;
+                return pending;
+            }
+
+            delta = pending ? Combine()(message.value, delta) : message.value;
+            pending = true;
+        }
+
+        t = inner->children[child];
+    }
+
+    leaf_ptr leaf = leaf_ptr(t);
+    size_t index = std::lower_bound(leaf->keys.begin(), leaf->keys.end(), key) -
+            leaf->keys.begin();
+
+    if (index < leaf->keys.size() && leaf->keys[index] == key)
+    {
+        value = pending ? Combine()(leaf->values[index], delta) : leaf->values[index];
+        return true;
+    }
+
+    value = delta;
+    return pending;
+}
+
+// Sets the value of key, replacing an existing one.
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+void BEpsilonTree<K, V, N, BufferSize, Combine>::insert(const K & key,
+        const V & value)
+{
+    put(Message{key, value, MESSAGE_INSERT});
+}
+
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+void BEpsilonTree<K, V, N, BufferSize, Combine>::erase(const K & key)
+{
+    put(Message{key, V(), MESSAGE_ERASE});
+}
+
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+void BEpsilonTree<K, V, N, BufferSize, Combine>::upsert(const K & key,
+        const V & delta)
+{
+    put(Message{key, delta, MESSAGE_UPSERT});
+}
+
+// Pushes every buffered message down to the leaves.
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+void BEpsilonTree<K, V, N, BufferSize, Combine>::flush()
+{
+    flushAllRecursion(mRoot);
+    repairRoot();
+}
+
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+void BEpsilonTree<K, V, N, BufferSize, Combine>::clear()
+{
+    postOrderRecursion(mRoot, deleteNode);
+
+    mRoot = new LeafNode();
+    mTreeSize = 0;
+}
+
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+void BEpsilonTree<K, V, N, BufferSize, Combine>::preOrder(void (* visit) (node_ptr))
+{
+    preOrderRecursion(mRoot, visit);
+}
+
+// Flushes first, so that the leaves hold every element.
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+void BEpsilonTree<K, V, N, BufferSize, Combine>::inOrder(
+        void (* visit) (const K &, V &))
+{
+    flush();
+    inOrderRecursion(mRoot, visit);
+}
+
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+void BEpsilonTree<K, V, N, BufferSize, Combine>::postOrder(void (* visit) (node_ptr))
+{
+    postOrderRecursion(mRoot, visit);
+}
+
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+void BEpsilonTree<K, V, N, BufferSize, Combine>::put(const Message & message)
+{
+    if (mRoot->leaf)
+        applyToLeaf(leaf_ptr(mRoot), message);
+    else
+    {
+        inner_ptr root = inner_ptr(mRoot);
+        addMessage(root, childIndex(root, message.key), message);
+
+        if (root->buffered <= BufferSize)
+            return;
+
+        flushNode(root);
+    }
+
+    repairRoot();
+}
+
+// Grows the tree when the root overflowed and shrinks it when the root is
+// an inner node left with a single child.
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+void BEpsilonTree<K, V, N, BufferSize, Combine>::repairRoot()
+{
+    while (mRoot->leaf ? count(mRoot) > MAX_KEYS : count(mRoot) > MAX_CHILDREN)
+    {
+        inner_ptr root = new InnerNode();
+        root->children.push_back(mRoot);
+        root->buffers.resize(1);
+        mRoot = root;
+        repairNode(root, 0);
+    }
+
+    while (!mRoot->leaf && count(mRoot) == 1)
+    {
+        inner_ptr root = inner_ptr(mRoot);
+
+        if (root->buffered > 0)
+        {
+            buffer_type messages;
+            messages.swap(root->buffers[0]);
+            root->buffered = 0;
+            pushDown(root, 0, messages);
+            repairNode(root, 0);
+
+            if (count(root) > 1)
+                break;
+        }
+
+        mRoot = root->children[0];
+        delete root;
+    }
+}
+
+// Moves the largest child buffer down one level.
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+void BEpsilonTree<K, V, N, BufferSize, Combine>::flushNode(inner_ptr t)
+{
+    size_t best = 0;
+    for (size_t index = 1; index < t->buffers.size(); index++)
+        if (t->buffers[index].size() > t->buffers[best].size())
+            best = index;
+
+    buffer_type messages;
+    messages.swap(t->buffers[best]);
+    t->buffered -= messages.size();
+
+    pushDown(t, best, messages);
+    repairNode(t, best);
+}
+
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+void BEpsilonTree<K, V, N, BufferSize, Combine>::flushAllRecursion(node_ptr t)
+{
+    if (t->leaf)
+        return;
+
+    inner_ptr inner = inner_ptr(t);
+
+    while (inner->buffered > 0)
+        flushNode(inner);
+
+    for (size_t index = 0; index < inner->children.size(); index++)
+        flushAllRecursion(inner->children[index]);
+
+    // Children emptied by the flush are merged; a merge leaves the index
+    // on the merged node, which may still be short.
+    size_t index = 0;
+    while (index < inner->children.size())
+    {
+        size_t before = inner->children.size();
+        repairNode(inner, index);
+
+        if (inner->children.size() >= before)
+            index++;
+    }
+}
+
+// Hands messages, sorted and all routed to children[index], to that
+// child. The child may overflow or underflow afterwards.
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+void BEpsilonTree<K, V, N, BufferSize, Combine>::pushDown(inner_ptr t,
+        size_t index, const buffer_type & messages)
+{
+    node_ptr child = t->children[index];
+
+    if (child->leaf)
+    {
+        applyToLeaf(leaf_ptr(child), messages);
+        return;
+    }
+
+    inner_ptr inner = inner_ptr(child);
+    addMessages(inner, messages);
+
+    while (inner->buffered > BufferSize)
+        flushNode(inner);
+}
+
+// Merges sorted messages into the leaf in one pass.
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+void BEpsilonTree<K, V, N, BufferSize, Combine>::applyToLeaf(leaf_ptr t,
+        const buffer_type & messages)
+{
+    std::vector<K> keys;
+    std::vector<V> values;
+    keys.reserve(t->keys.size() + messages.size());
+    values.reserve(t->keys.size() + messages.size());
+
+    size_t index = 0;
+    for (size_t slot = 0; slot < messages.size(); slot++)
+    {
+        const Message & message = messages[slot];
+
+        while (index < t->keys.size() && t->keys[index] < message.key)
+        {
+            keys.push_back(t->keys[index]);
+            values.push_back(t->values[index]);
+            index++;
+        }
+
+        bool found = index < t->keys.size() && t->keys[index] == message.key;
+
+        if (message.type == MESSAGE_ERASE)
+        {
+            if (found)
+                mTreeSize--;
+        }
+        else
+        {
+            V value = message.value;
+            if (found && message.type == MESSAGE_UPSERT)
+                value = Combine()(t->values[index], message.value);
+            else if (!found)
+                mTreeSize++;
+
+            keys.push_back(message.key);
+            values.push_back(value);
+        }
+
+        if (found)
+            index++;
+    }
+
+    keys.insert(keys.end(), t->keys.begin() + index, t->keys.end());
+    values.insert(values.end(), t->values.begin() + index, t->values.end());
+
+    t->keys.swap(keys);
+    t->values.swap(values);
+}
+
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+void BEpsilonTree<K, V, N, BufferSize, Combine>::applyToLeaf(leaf_ptr t,
+        const Message & message)
+{
+    size_t index = std::lower_bound(t->keys.begin(), t->keys.end(), message.key) -
+            t->keys.begin();
+    bool found = index < t->keys.size() && t->keys[index] == message.key;
+
+    if (message.type == MESSAGE_ERASE)
+    {
+        if (found)
+        {
+            t->keys.erase(t->keys.begin() + index);
+            t->values.erase(t->values.begin() + index);
+            mTreeSize--;
+        }
+    }
+    else if (found)
+    {
+        if (message.type == MESSAGE_UPSERT)
+            t->values[index] = Combine()(t->values[index], message.value);
+        else
+            t->values[index] = message.value;
+    }
+    else
+    {
+        t->keys.insert(t->keys.begin() + index, message.key);
+        t->values.insert(t->values.begin() + index, message.value);
+        mTreeSize++;
+    }
+}
+
+// Splits an overflowing children[index] as often as needed, or merges an
+// underflowing one with a brother (splitting the result again if it is
+// too big).
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+void BEpsilonTree<K, V, N, BufferSize, Combine>::repairNode(inner_ptr t,
+        size_t index)
+{
+    node_ptr x = t->children[index];
+    size_t maximum = x->leaf ? size_t(MAX_KEYS) : size_t(MAX_CHILDREN);
+    size_t minimum = x->leaf ? size_t(MIN_KEYS) : size_t(MIN_CHILDREN);
+
+    if (count(x) < minimum && t->children.size() > 1)
+    {
+        if (index + 1 == t->children.size())
+            index--;
+
+        mergeNodes(t, index);
+    }
+
+    size_t end = index + 1;
+    while (index < end)
+        if (count(t->children[index]) > maximum)
+        {
+            splitNode(t, index);
+            end++;
+        }
+        else
+            index++;
+}
+
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+size_t BEpsilonTree<K, V, N, BufferSize, Combine>::childIndex(node_ptr t,
+        const K & key)
+{
+    return std::upper_bound(t->keys.begin(), t->keys.end(), key) - t->keys.begin();
+}
+
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+size_t BEpsilonTree<K, V, N, BufferSize, Combine>::messageIndex(
+        const buffer_type & buffer, const K & key)
+{
+    size_t low = 0;
+    size_t high = buffer.size();
+
+    while (low < high)
+    {
+        size_t middle = (low + high) / 2;
+
+        if (buffer[middle].key < key)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return low;
+}
+
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+void BEpsilonTree<K, V, N, BufferSize, Combine>::addMessage(inner_ptr t,
+        size_t child, const Message & message)
+{
+    buffer_type & buffer = t->buffers[child];
+    size_t index = messageIndex(buffer, message.key);
+
+    if (index < buffer.size() && buffer[index].key == message.key)
+        foldMessage(buffer[index], message);
+    else
+    {
+        buffer.insert(buffer.begin() + index, message);
+        t->buffered++;
+    }
+}
+
+// Distributes sorted messages over the child buffers of t.
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+void BEpsilonTree<K, V, N, BufferSize, Combine>::addMessages(inner_ptr t,
+        const buffer_type & messages)
+{
+    const Message * first = messages.data();
+    const Message * last = first + messages.size();
+
+    while (first != last)
+    {
+        size_t child = childIndex(t, first->key);
+        const Message * end = last;
+
+        if (child < t->keys.size())
+            while (end != first && !((end - 1)->key < t->keys[child]))
+                end--;
+
+        size_t before = t->buffers[child].size();
+        mergeMessages(t->buffers[child], first, end);
+        t->buffered += t->buffers[child].size() - before;
+
+        first = end;
+    }
+}
+
+// Merges newer sorted messages into a buffer in one pass.
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+void BEpsilonTree<K, V, N, BufferSize, Combine>::mergeMessages(
+        buffer_type & buffer, const Message * first, const Message * last)
+{
+    if (buffer.empty())
+    {
+        buffer.assign(first, last);
+        return;
+    }
+
+    buffer_type merged;
+    merged.reserve(buffer.size() + (last - first));
+
+    size_t index = 0;
+    for (; first != last; ++first)
+    {
+        while (index < buffer.size() && buffer[index].key < first->key)
+            merged.push_back(buffer[index++]);
+
+        if (index < buffer.size() && buffer[index].key == first->key)
+        {
+            merged.push_back(buffer[index++]);
+            foldMessage(merged.back(), *first);
+        }
+        else
+            merged.push_back(*first);
+    }
+
+    merged.insert(merged.end(), buffer.begin() + index, buffer.end());
+    buffer.swap(merged);
+}
+
+// Folds a newer message into an older one for the same key.
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+void BEpsilonTree<K, V, N, BufferSize, Combine>::foldMessage(Message & older,
+        const Message & newer)
+{
+    if (newer.type != MESSAGE_UPSERT)
+        older = newer;
+    else if (older.type == MESSAGE_ERASE)
+    {
+        older.type = MESSAGE_INSERT;
+        older.value = newer.value;
+    }
+    else
+        older.value = Combine()(older.value, newer.value);
+}
+
+// Keys of a leaf, children of an inner node.
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+size_t BEpsilonTree<K, V, N, BufferSize, Combine>::count(node_ptr t)
+{
+    return t->leaf ? t->keys.size() : inner_ptr(t)->children.size();
+}
+
+// Moves the upper half of children[index] into a new right brother; the
+// messages t holds for it are split at the new separator.
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+void BEpsilonTree<K, V, N, BufferSize, Combine>::splitNode(inner_ptr t,
+        size_t index)
+{
+    node_ptr x = t->children[index];
+    size_t half = count(x) / 2;
+    K separator;
+    node_ptr right;
+
+    if (x->leaf)
+    {
+        leaf_ptr left = leaf_ptr(x);
+        leaf_ptr node = new LeafNode();
+
+        node->keys.assign(left->keys.begin() + half, left->keys.end());
+        node->values.assign(left->values.begin() + half, left->values.end());
+        left->keys.resize(half);
+        left->values.resize(half);
+
+        separator = node->keys[0];
+        right = node;
+    }
+    else
+    {
+        inner_ptr left = inner_ptr(x);
+        inner_ptr node = new InnerNode();
+
+        separator = left->keys[half - 1];
+        node->keys.assign(left->keys.begin() + half, left->keys.end());
+        node->children.assign(left->children.begin() + half, left->children.end());
+        left->keys.resize(half - 1);
+        left->children.resize(half);
+
+        for (size_t child = half; child < left->buffers.size(); child++)
+        {
+            node->buffered += left->buffers[child].size();
+            node->buffers.push_back(buffer_type());
+            node->buffers.back().swap(left->buffers[child]);
+        }
+        left->buffers.resize(half);
+        left->buffered -= node->buffered;
+
+        right = node;
+    }
+
+    buffer_type & buffer = t->buffers[index];
+    size_t split = messageIndex(buffer, separator);
+    buffer_type upper(buffer.begin() + split, buffer.end());
+    buffer.resize(split);
+
+    t->keys.insert(t->keys.begin() + index, separator);
+    t->children.insert(t->children.begin() + index + 1, right);
+    t->buffers.insert(t->buffers.begin() + index + 1, buffer_type());
+    t->buffers[index + 1].swap(upper);
+}
+
+// Appends children[index + 1] to children[index] and deletes it.
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+void BEpsilonTree<K, V, N, BufferSize, Combine>::mergeNodes(inner_ptr t,
+        size_t index)
+{
+    node_ptr x = t->children[index];
+    node_ptr y = t->children[index + 1];
+
+    if (x->leaf)
+    {
+        leaf_ptr left = leaf_ptr(x);
+        leaf_ptr right = leaf_ptr(y);
+
+        left->keys.insert(left->keys.end(), right->keys.begin(), right->keys.end());
+        left->values.insert(left->values.end(), right->values.begin(),
+                right->values.end());
+    }
+    else
+    {
+        inner_ptr left = inner_ptr(x);
+        inner_ptr right = inner_ptr(y);
+        size_t seam = left->children.size();
+
+        left->keys.push_back(t->keys[index]);
+        left->keys.insert(left->keys.end(), right->keys.begin(), right->keys.end());
+        left->children.insert(left->children.end(), right->children.begin(),
+                right->children.end());
+        for (size_t child = 0; child < right->buffers.size(); child++)
+        {
+            left->buffers.push_back(buffer_type());
+            left->buffers.back().swap(right->buffers[child]);
+        }
+        left->buffered += right->buffered;
+
+        // The children meeting at the seam may both be short.
+        repairNode(left, seam - 1);
+        if (seam < left->children.size())
+            repairNode(left, seam);
+    }
+
+    buffer_type & buffer = t->buffers[index];
+    buffer.insert(buffer.end(), t->buffers[index + 1].begin(),
+            t->buffers[index + 1].end());
+
+    t->keys.erase(t->keys.begin() + index);
+    t->children.erase(t->children.begin() + index + 1);
+    t->buffers.erase(t->buffers.begin() + index + 1);
+
+    deleteNode(y);
+}
+
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+void BEpsilonTree<K, V, N, BufferSize, Combine>::deleteNode(node_ptr t)
+{
+    if (t->leaf)
+        delete leaf_ptr(t);
+    else
+        delete inner_ptr(t);
+}
+
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+void BEpsilonTree<K, V, N, BufferSize, Combine>::preOrderRecursion(node_ptr t,
+        void (* visit) (node_ptr))
+{
+    visit(t);
+
+    if (!t->leaf)
+        for (size_t index = 0; index < count(t); index++)
+            preOrderRecursion(inner_ptr(t)->children[index], visit);
+}
+
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+void BEpsilonTree<K, V, N, BufferSize, Combine>::inOrderRecursion(node_ptr t,
+        void (* visit) (const K &, V &))
+{
+    if (t->leaf)
+    {
+        leaf_ptr leaf = leaf_ptr(t);
+        for (size_t index = 0; index < leaf->keys.size(); index++)
+            visit(leaf->keys[index], leaf->values[index]);
+    }
+    else
+        for (size_t index = 0; index < count(t); index++)
+            inOrderRecursion(inner_ptr(t)->children[index], visit);
+}
+
+template <class K, class V, size_t N, size_t BufferSize, class Combine>
+void BEpsilonTree<K, V, N, BufferSize, Combine>::postOrderRecursion(node_ptr t,
+        void (* visit) (node_ptr))
+{
+    if (!t->leaf)
+        for (size_t index = 0; index < count(t); index++)
+            postOrderRecursion(inner_ptr(t)->children[index], visit);
+
+    visit(t);
+}
+
+#endif//__B_EPSILON_TREE_H__
@@ -0,0 +1,712 @@
+#ifndef __B_PLUS_TREE_H__
+#define __B_PLUS_TREE_H__
+
+#include <list>
+#include <cstddef>
+#include <utility>
+
+#include "nodeSearch.h"
+
+// B+ tree: internal nodes only hold separator keys, every element lives in a
+// leaf and the leaves are chained in key order, so an ordered scan walks the
+// chain instead of going up and down the tree.
+template <class K, class V, size_t N>
+class BPlusTree
+{
+public:
+
+    struct Node
+    {
+        typedef size_t size_type;
+
+        size_type size;
+        bool leaf;
+        K keys[N];
+
+        Node(bool leaf)
+            : size(0), leaf(leaf) {}
+    };
+
+    struct InnerNode : Node
+    {
+        Node * children[N + 1];
+
+        InnerNode()
+            : Node(false), children{NULL} {}
+    };
+
+    struct LeafNode : Node
+    {
+        V values[N];
+        LeafNode *prev, *next;
+
+        LeafNode()
+            : Node(true), prev(NULL), next(NULL) {}
+    };
+
+    typedef Node node_type;
+    typedef node_type* node_ptr;
+    typedef InnerNode* inner_ptr;
+    typedef LeafNode* leaf_ptr;
+    typedef K key_type;
+    typedef V value_type;
+    typedef value_type* value_ptr;
+    typedef typename node_type::size_type size_type;
+
+    struct KeyChild
+    {
+        K key;
+        node_ptr node;
+    };
+
+    // Forward cursor over the keys in [low, high], streaming through the
+    // leaf chain.
+    class Cursor
+    {
+    public:
+
+        Cursor(leaf_ptr leaf, size_type index, const K & high)
+            : mLeaf(leaf), mIndex(index), mHigh(high)
+        {
+            skipEmpty();
+        }
+
+        bool valid() const
+        {
+            return mLeaf != NULL;
+        }
+
+        const K & key() const
+        {
+            return mLeaf->keys[mIndex];
+        }
+
+        V & value() const
+        {
+            return mLeaf->values[mIndex];
+        }
+
+        void next()
+        {
+            mIndex++;
+            skipEmpty();
+        }
+
+    private:
+
+        void skipEmpty()
+        {
+            while (mLeaf != NULL && mIndex == mLeaf->size)
+            {
+                mLeaf = mLeaf->next;
+                mIndex = 0;
+            }
+
+            if (mLeaf != NULL && mHigh < mLeaf->keys[mIndex])
+                mLeaf = NULL;
+        }
+
+        leaf_ptr mLeaf;
+        size_type mIndex;
+        K mHigh;
+    };
+
+public:
+
+    BPlusTree();
+
+    ~BPlusTree();
+
+    size_type size() const;
+
+    size_type height() const;
+
+    bool empty() const;
+
+    value_ptr find(const K &) const;
+
+    Cursor range(const K &, const K &) const;
+
+    void insert(const K &, const V &);
+
+    void erase(const K &);
+
+    void clear();
+
+    void preOrder(void (*) (node_ptr));
+
+    void inOrder(void (*) (const K &, V &));
+
+    void postOrder(void (*) (node_ptr));
+
+    void levelOrder(void (*) (node_ptr));
+
+private:
+
+    static size_t searchNode(node_ptr, const K &);
+
+    static size_t childIndex(node_ptr, const K &);
+
+    static leaf_ptr findLeaf(node_ptr, const K &);
+
+    static KeyChild insertRecursion(node_ptr, const K &, const V &, bool &);
+
+    static KeyChild insertToLeaf(leaf_ptr, const K &, const V &);
+
+    static KeyChild insertToInner(inner_ptr, const KeyChild &, size_t);
+
+    static bool eraseRecursion(node_ptr, const K &);
+
+    static void repairNode(inner_ptr, size_t);
+
+    static void borrowFromLeftBro(inner_ptr, size_t);
+
+    static void borrowFromRightBro(inner_ptr, size_t);
+
+    static void mergeNodes(inner_ptr, size_t);
+
+    static void deleteNode(node_ptr);
+
+    static void preOrderRecursion(node_ptr, void (*) (node_ptr));
+
+    static void postOrderRecursion(node_ptr, void (*) (node_ptr));
+
+protected:
+
+    node_ptr mRoot;
+
+    leaf_ptr mHead;
+
+    size_type mTreeSize;
+
+};
+
+template <class K, class V, size_t N>
+BPlusTree<K, V, N>::BPlusTree()
+    : mRoot(NULL), mHead(NULL), mTreeSize(0)
+{
+
+}
+
+template <class K, class V, size_t N>
+BPlusTree<K, V, N>::~BPlusTree()
+{
+    clear();
+}
+
+template <class K, class V, size_t N>
+typename BPlusTree<K, V, N>::size_type
+BPlusTree<K, V, N>::size() const
+{
+    return mTreeSize;
+}
+
+template <class K, class V, size_t N>
+typename BPlusTree<K, V, N>::size_type
+BPlusTree<K, V, N>::height() const
+{
+    size_type result = 0;
+    for (node_ptr t = mRoot; t != NULL; result++)
+        t = t->leaf ? NULL : static_cast<inner_ptr>(t)->children[0];
+
+    return result;
+}
+
+template <class K, class V, size_t N>
+bool BPlusTree<K, V, N>::empty() const
+{
+    return mTreeSize == 0;
+}
+
+template <class K, class V, size_t N>
+typename BPlusTree<K, V, N>::value_ptr
+BPlusTree<K, V, N>::find(const K & key) const
+{
+    if (mRoot == NULL)
+        return NULL;
+
+    leaf_ptr leaf = findLeaf(mRoot, key);
+    size_t index = searchNode(leaf, key);
+
+    if (index < leaf->size && leaf->keys[index] == key)
+        return &leaf->values[index];
+
+    return NULL;
+}
+
+template <class K, class V, size_t N>
+typename BPlusTree<K, V, N>::Cursor
+BPlusTree<K, V, N>::range(const K & low, const K & high) const
+{
+    if (mRoot == NULL || high < low)
+        return Cursor(NULL, 0, high);
+
+    leaf_ptr leaf = findLeaf(mRoot, low);
+    return Cursor(leaf, searchNode(leaf, low), high);
+}
+
+template <class K, class V, size_t N>
+void BPlusTree<K, V, N>::insert(const K & key, const V & value)
+{
+    bool inserted = true;
+
+    if (mRoot == NULL)
+        mRoot = mHead = new LeafNode();
+
+    KeyChild result = insertRecursion(mRoot, key, value, inserted);
+
+    if (result.node != NULL)
+    {
+        inner_ptr newRoot = new InnerNode();
+        newRoot->keys[0] = result.key;
+        newRoot->children[0] = mRoot;
+        newRoot->children[1] = result.node;
+        newRoot->size = 1;
+        mRoot = newRoot;
+    }
+
+    if (inserted)
+        mTreeSize++;
+}
+
+template <class K, class V, size_t N>
+void BPlusTree<K, V, N>::erase(const K & key)
+{
+    if (mRoot == NULL)
+        return;
+
+    if (eraseRecursion(mRoot, key))
+        mTreeSize--;
+
+    if (mRoot->size == 0)
+    {
+        node_ptr newRoot = mRoot->leaf ? NULL : static_cast<inner_ptr>(mRoot)->children[0];
+
+        if (newRoot == NULL)
+            mHead = NULL;
+
+        deleteNode(mRoot);
+        mRoot = newRoot;
+    }
+}
+
+template <class K, class V, size_t N>
+void BPlusTree<K, V, N>::clear()
+{
+    postOrder(deleteNode);
+
+    mRoot = NULL;
+    mHead = NULL;
+    mTreeSize = 0;
+}
+
+template <class K, class V, size_t N>
+void BPlusTree<K, V, N>::preOrder(void (* visit) (node_ptr))
+{
+    preOrderRecursion(mRoot, visit);
+}
+
+template <class K, class V, size_t N>
+void BPlusTree<K, V, N>::inOrder(void (* visit) (const K &, V &))
+{
+    for (leaf_ptr leaf = mHead; leaf != NULL; leaf = leaf->next)
+        for (size_t index = 0; index < leaf->size; index++)
+            visit(leaf->keys[index], leaf->values[index]);
+}
+
+template <class K, class V, size_t N>
+void BPlusTree<K, V, N>::postOrder(void (* visit) (node_ptr))
+{
+    postOrderRecursion(mRoot, visit);
+}
+
+template <class K, class V, size_t N>
+void BPlusTree<K, V, N>::levelOrder(void (* visit) (node_ptr))
+{
+    std::list<node_ptr> l;
+    node_ptr t = this->mRoot;
+
+    while (t != NULL)
+    {
+        visit(t);
+
+        if (!t->leaf)
+            for (size_t index = 0; index <= t->size; index++)
+                l.push_back(static_cast<inner_ptr>(t)->children[index]);
+
+        if (l.empty())
+            return;
+
+        t = l.front();
+        l.pop_front();
+    }
+}
+
+template <class K, class V, size_t N>
+size_t BPlusTree<K, V, N>::searchNode(node_ptr t, const K & key)
+{
+    return nodeLowerBound(t->keys, t->size, key);
+}
+
+template <class K, class V, size_t N>
+size_t BPlusTree<K, V, N>::childIndex(node_ptr t, const K & key)
+{
+    size_t index = searchNode(t, key);
+
+    // A separator equal to the key starts the right subtree.
+    if (index < t->size && t->keys[index] == key)
+        index++;
+
+    return index;
+}
+
+template <class K, class V, size_t N>
+typename BPlusTree<K, V, N>::leaf_ptr
+BPlusTree<K, V, N>::findLeaf(node_ptr t, const K & key)
+{
+    while (!t->leaf)
+        t = static_cast<inner_ptr>(t)->children[childIndex(t, key)];
+
+    return static_cast<leaf_ptr>(t);
+}
+
+template <class K, class V, size_t N>
+typename BPlusTree<K, V, N>::KeyChild
+BPlusTree<K, V, N>::insertRecursion(node_ptr t, const K & key, const V & value,
+        bool & inserted)
+{
+    if (t->leaf)
+    {
+        leaf_ptr leaf = static_cast<leaf_ptr>(t);
+        size_t index = searchNode(leaf, key);
+
+        if (index < leaf->size && leaf->keys[index] == key)
+        {
+            leaf->values[index] = value;
+            inserted = false;
+            return KeyChild{K(), NULL};
+        }
+
+        return insertToLeaf(leaf, key, value);
+    }
+
+    inner_ptr inner = static_cast<inner_ptr>(t);
+    size_t index = childIndex(inner, key);
+
+    KeyChild result = insertRecursion(inner->children[index], key, value, inserted);
+
+    if (result.node == NULL)
+        return result;
+
+    return insertToInner(inner, result, index);
+}
+
+template <class K, class V, size_t N>
+typename BPlusTree<K, V, N>::KeyChild
+BPlusTree<K, V, N>::insertToLeaf(leaf_ptr t, const K & key, const V & value)
+{
+    size_t index = t->size;
+    while (index > 0 && key < t->keys[index - 1])
+    {
+        t->keys[index] = t->keys[index - 1];
+        t->values[index] = t->values[index - 1];
+        index--;
+    }
+
+    t->keys[index] = key;
+    t->values[index] = value;
+
+    if (++t->size < N)
+        return KeyChild{K(), NULL};
+
+    leaf_ptr newLeaf = new LeafNode();
+    size_t d = N / 2;
+
+    for (index = d; index < N; index++)
+    {
+        newLeaf->keys[index - d] = t->keys[index];
+        newLeaf->values[index - d] = t->values[index];
+    }
+    newLeaf->size = N - d;
+    t->size = d;
+
+    newLeaf->next = t->next;
+    newLeaf->prev = t;
+    if (t->next != NULL)
+        t->next->prev = newLeaf;
+    t->next = newLeaf;
+
+    return KeyChild{newLeaf->keys[0], newLeaf};
+}
+
+template <class K, class V, size_t N>
+typename BPlusTree<K, V, N>::KeyChild
+BPlusTree<K, V, N>::insertToInner(inner_ptr t, const KeyChild & keyChild,
+        size_t position)
+{
+    size_t index = t->size;
+    while (index > position)
+    {
+        t->keys[index] = t->keys[index - 1];
+        t->children[index + 1] = t->children[index];
+        index--;
+    }
+
+    t->keys[index] = keyChild.key;
+    t->children[index + 1] = keyChild.node;
+
+    if (++t->size < N)
+        return KeyChild{K(), NULL};
+
+    inner_ptr newNode = new InnerNode();
+    size_t d = (N + 1) / 2 - 1;
+    KeyChild result = {t->keys[d], newNode};
+
+    for (index = d + 1; index < N; index++)
+    {
+        newNode->keys[index - d - 1] = t->keys[index];
+        newNode->children[index - d - 1] = t->children[index];
+        t->children[index] = NULL;
+    }
+    newNode->children[N - d - 1] = t->children[N];
+    t->children[N] = NULL;
+
+    newNode->size = N - d - 1;
+    t->size = d;
+
+    return result;
+}
+
+template <class K, class V, size_t N>
+bool BPlusTree<K, V, N>::eraseRecursion(node_ptr t, const K & key)
+{
+    if (t->leaf)
+    {
+        leaf_ptr leaf = static_cast<leaf_ptr>(t);
+        size_t index = searchNode(leaf, key);
+
+        if (index == leaf->size || !(leaf->keys[index] == key))
+            return false;
+
+        while (++index < leaf->size)
+        {
+            leaf->keys[index - 1] = leaf->keys[index];
+            leaf->values[index - 1] = leaf->values[index];
+        }
+        leaf->size--;
+
+        return true;
+    }
+
+    inner_ptr inner = static_cast<inner_ptr>(t);
+    size_t index = childIndex(inner, key);
+
+    if (!eraseRecursion(inner->children[index], key))
+        return false;
+
+    repairNode(inner, index);
+    return true;
+}
+
+template <class K, class V, size_t N>
+void BPlusTree<K, V, N>::repairNode(inner_ptr t, size_t index)
+{
+    const size_t MIN_NUM = (N - 1) / 2;
+    node_ptr x = t->children[index];
+
+    if (x->size >= MIN_NUM)
+        return;
+
+    node_ptr leftBro = index > 0 ? t->children[index - 1] : NULL;
+    node_ptr rightBro = index < t->size ? t->children[index + 1] : NULL;
+
+    if (leftBro != NULL && leftBro->size > MIN_NUM)
+        borrowFromLeftBro(t, index);
+    else if (rightBro != NULL && rightBro->size > MIN_NUM)
+        borrowFromRightBro(t, index);
+    else
+        mergeNodes(t, (leftBro == NULL ? index : index - 1));
+}
+
+template <class K, class V, size_t N>
+void BPlusTree<K, V, N>::borrowFromLeftBro(inner_ptr t, size_t index)
+{
+    node_ptr x = t->children[index];
+    node_ptr left = t->children[index - 1];
+
+    size_t indexL = left->size;
+    size_t indexX = x->size;
+
+    if (x->leaf)
+    {
+        leaf_ptr xl = static_cast<leaf_ptr>(x);
+        leaf_ptr ll = static_cast<leaf_ptr>(left);
+
+        while (indexX > 0)
+        {
+            xl->keys[indexX] = xl->keys[indexX - 1];
+            xl->values[indexX] = xl->values[indexX - 1];
+            indexX--;
+        }
+
+        xl->keys[0] = ll->keys[indexL - 1];
+        xl->values[0] = ll->values[indexL - 1];
+        t->keys[index - 1] = xl->keys[0];
+    }
+    else
+    {
+        inner_ptr xi = static_cast<inner_ptr>(x);
+        inner_ptr li = static_cast<inner_ptr>(left);
+
+        xi->children[indexX + 1] = xi->children[indexX];
+        while (indexX > 0)
+        {
+            xi->keys[indexX] = xi->keys[indexX - 1];
+            xi->children[indexX] = xi->children[indexX - 1];
+            indexX--;
+        }
+
+        xi->keys[0] = t->keys[index - 1];
+        xi->children[0] = li->children[indexL];
+        t->keys[index - 1] = li->keys[indexL - 1];
+        li->children[indexL] = NULL;
+    }
+
+    left->size--;
+    x->size++;
+}
+
+template <class K, class V, size_t N>
+void BPlusTree<K, V, N>::borrowFromRightBro(inner_ptr t, size_t index)
+{
+    node_ptr x = t->children[index];
+    node_ptr right = t->children[index + 1];
+
+    size_t indexR = 1;
+    size_t indexX = x->size;
+
+    if (x->leaf)
+    {
+        leaf_ptr xl = static_cast<leaf_ptr>(x);
+        leaf_ptr rl = static_cast<leaf_ptr>(right);
+
+        xl->keys[indexX] = rl->keys[0];
+        xl->values[indexX] = rl->values[0];
+
+        while (indexR < rl->size)
+        {
+            rl->keys[indexR - 1] = rl->keys[indexR];
+            rl->values[indexR - 1] = rl->values[indexR];
+            indexR++;
+        }
+
+        t->keys[index] = rl->keys[0];
+    }
+    else
+    {
+        inner_ptr xi = static_cast<inner_ptr>(x);
+        inner_ptr ri = static_cast<inner_ptr>(right);
+
+        xi->keys[indexX] = t->keys[index];
+        xi->children[indexX + 1] = ri->children[0];
+        t->keys[index] = ri->keys[0];
+
+        while (indexR < ri->size)
+        {
+            ri->keys[indexR - 1] = ri->keys[indexR];
+            ri->children[indexR - 1] = ri->children[indexR];
+            indexR++;
+        }
+        ri->children[indexR - 1] = ri->children[indexR];
+        ri->children[indexR] = NULL;
+    }
+
+    right->size--;
+    x->size++;
+}
+
+template <class K, class V, size_t N>
+void BPlusTree<K, V, N>::mergeNodes(inner_ptr t, size_t index)
+{
+    node_ptr left = t->children[index];
+    node_ptr right = t->children[index + 1];
+    size_t indexL = left->size;
+    size_t indexR = 0;
+
+    if (left->leaf)
+    {
+        leaf_ptr ll = static_cast<leaf_ptr>(left);
+        leaf_ptr rl = static_cast<leaf_ptr>(right);
+
+        while (indexR < rl->size)
+        {
+            ll->keys[indexL] = rl->keys[indexR];
+            ll->values[indexL++] = rl->values[indexR++];
+        }
+
+        ll->next = rl->next;
+        if (rl->next != NULL)
+            rl->next->prev = ll;
+    }
+    else
+    {
+        inner_ptr li = static_cast<inner_ptr>(left);
+        inner_ptr ri = static_cast<inner_ptr>(right);
+
+        li->keys[indexL++] = t->keys[index];
+        while (indexR < ri->size)
+        {
+            li->keys[indexL] = ri->keys[indexR];
+            li->children[indexL++] = ri->children[indexR++];
+        }
+        li->children[indexL] = ri->children[indexR];
+    }
+    left->size = indexL;
+
+    while (++index < t->size)
+    {
+        t->keys[index - 1] = t->keys[index];
+        t->children[index] = t->children[index + 1];
+    }
+    t->children[index] = NULL;
+    t->size--;
+
+    deleteNode(right);
+}
+
+template <class K, class V, size_t N>
+void BPlusTree<K, V, N>::deleteNode(node_ptr t)
+{
+    if (t->leaf)
+        delete static_cast<leaf_ptr>(t);
+    else
+        delete static_cast<inner_ptr>(t);
+}
+
+template <class K, class V, size_t N>
+void BPlusTree<K, V, N>::preOrderRecursion(node_ptr t, void (* visit) (node_ptr))
+{
+    if (t == NULL)
+        return;
+
+    visit(t);
+
+    if (!t->leaf)
+        for (size_t index = 0; index <= t->size; index++)
+            preOrderRecursion(static_cast<inner_ptr>(t)->children[index], visit);
+}
+
+template <class K, class V, size_t N>
+void BPlusTree<K, V, N>::postOrderRecursion(node_ptr t, void (* visit) (node_ptr))
+{
+    if (t == NULL)
+        return;
+
+    if (!t->leaf)
+        for (size_t index = 0; index <= t->size; index++)
+            postOrderRecursion(static_cast<inner_ptr>(t)->children[index], visit);
+
+    visit(t);
+}
+
+#endif//__B_PLUS_TREE_H__
@@ -2,47 +2,214 @@
 #define __B_TREE_H__
 
 #include <list>
+#include <vector>
 #include <cstddef>
 #include <utility>
+#include <iterator>
+#include <algorithm>
 
+#include "nodeSearch.h"
+#include "prefetch.h"
+#include "eytzinger.h"
+#include "treeIterator.h"
+
+const size_t CACHE_LINE_SIZE = 64;
+
+constexpr size_t roundUp(size_t bytes, size_t alignment)
+{
+    return (bytes + alignment - 1) / alignment * alignment;
+}
+
+// Size of a BTree node as a function of its fan-out, computed from the
+// member layout of BTreeNode<K, V, N>. A node specialisation with its own
+// layout specialises this as well; BTree checks the two against sizeof.
+template <class K, class V>
+struct BTreeNodeSize
+{
+    static constexpr size_t bytes(size_t n)
+    {
+        return roundUp(roundUp(roundUp(roundUp(sizeof(size_t), alignof(K)) +
+                n * sizeof(K), alignof(void *)) + (n + 1) * sizeof(void *),
+                alignof(V)) + n * sizeof(V), CACHE_LINE_SIZE);
+    }
+};
+
+// sizeof(BTreeNode<K, V, n>).
+template <class K, class V>
+constexpr size_t bTreeNodeBytes(size_t n)
+{
+    return BTreeNodeSize<K, V>::bytes(n);
+}
+
+// Binary search for the largest fan-out in [lo, hi) that fits; hi does not.
+template <class K, class V>
+constexpr size_t bTreeFanoutBetween(size_t nodeBytes, size_t lo, size_t hi)
+{
+    return hi <= lo + 1 ? lo :
+            bTreeNodeBytes<K, V>((lo + hi) / 2) <= nodeBytes ?
+            bTreeFanoutBetween<K, V>(nodeBytes, (lo + hi) / 2, hi) :
+            bTreeFanoutBetween<K, V>(nodeBytes, lo, (lo + hi) / 2);
+}
+
+// Largest fan-out N whose BTree node fits in nodeBytes (never below 3).
+// Nodes are cache-line aligned, so sizes that are multiples of
+// CACHE_LINE_SIZE waste nothing; e.g. bTreeFanout<int, int>(256) is 14.
+// Every key brings a child pointer, so nodeBytes / sizeof(void *) keys
+// never fit.
+template <class K, class V>
+constexpr size_t bTreeFanout(size_t nodeBytes)
+{
+    return bTreeFanoutBetween<K, V>(nodeBytes, 3, nodeBytes / sizeof(void *) + 1);
+}
+
+// Shape and activity of a BTree, as reported by stats(). Node fill is the
+// share of the N - 1 key slots in use, counted in tenths: bucket i holds
+// nodes whose fill is in [i/10, (i+1)/10); full nodes go in the last
+// bucket. The counters add up over the life of the tree.
+struct BTreeStats
+{
+    static const size_t FILL_BUCKETS = 10;
+
+    size_t height;
+    size_t elements;
+    size_t nodes;
+
+    // Nodes on each level, the root's first.
+    std::vector<size_t> levelNodes;
+
+    size_t fillHistogram[FILL_BUCKETS];
+
+    // Memory held by the nodes, and the part of it holding elements.
+    size_t nodeBytes;
+    size_t elementBytes;
+
+    size_t splits;
+    size_t merges;
+    size_t borrows;
+};
+
+// Node of BTree. Keys and values are stored inline in parallel arrays so
+// that the key scan of a node touches contiguous memory only; values are
+// read after the slot is known.
+//
+// The tree reads and changes keys through the members below only, so a
+// key type may lay them out differently by specialising the node, as
+// stringBTree.h does for std::string. The key updates see size as the key
+// count before the update; callers adjust size afterwards, as they do for
+// values and children.
 template <class K, class V, size_t N>
-class BTree
+struct alignas(CACHE_LINE_SIZE) BTreeNode
 {
-public:
+    typedef K key_type;
+    typedef V value_type;
+    typedef BTreeNode* node_ptr;
+    typedef size_t size_type;
+
+    // Room for a key that the node has to rebuild; these keys need none.
+    struct key_buffer {};
 
-    struct Node
+    size_type size;
+    K keys[N];
+    node_ptr children[N + 1];
+    V values[N];
+
+    BTreeNode()
+        : size(0), children{NULL} {}
+
+    BTreeNode(const K & key, const V & value)
+        : size(1), children{NULL}
     {
-        typedef std::pair<const K, V> elem_type;
-        typedef elem_type* elem_ptr;
-        typedef Node* node_ptr;
-        typedef size_t size_type;
+        keys[0] = key;
+        values[0] = value;
+    }
 
-        elem_ptr elements[N];
-        node_ptr children[N + 1];
+    BTreeNode(const K & key, const V & value, node_ptr child1, node_ptr child2)
+        : size(1), children{child1, child2}
+    {
+        keys[0] = key;
+        values[0] = value;
+    }
 
-        Node()
-            : elements{NULL}, children{NULL} {}
+    const K & key(size_t index) const { return keys[index]; }
 
-        Node(elem_type element)
-            : elements{new elem_type(element)}, 
-            children{NULL} {}
+    const K & key(size_t index, key_buffer &) const { return keys[index]; }
 
-        Node(elem_type element, node_ptr child1, node_ptr child2)
-            : elements{new elem_type(element)}, children{child1, child2} {}
-    };
+    size_t lowerBound(const K & key) const
+    {
+        return nodeLowerBound(keys, size, key);
+    }
+
+    bool keyEquals(size_t index, const K & key) const { return keys[index] == key; }
+
+    bool keyLess(size_t index, const K & key) const { return keys[index] < key; }
+
+    void insertKey(size_t index, const K & key)
+    {
+        std::copy_backward(keys + index, keys + size, keys + size + 1);
+        keys[index] = key;
+    }
+
+    void eraseKey(size_t index)
+    {
+        std::copy(keys + index + 1, keys + size, keys + index);
+    }
+
+    void setKey(size_t index, const K & key) { keys[index] = key; }
+
+    void assignKeys(const K * source, size_t count)
+    {
+        std::copy(source, source + count, keys);
+    }
+
+    // Appends keys [first, last) of other.
+    void appendKeys(const BTreeNode & other, size_t first, size_t last)
+    {
+        std::copy(other.keys + first, other.keys + last, keys + size);
+    }
+
+    // Drops the keys from count on.
+    void truncateKeys(size_t) {}
+
+    template <class Prefetch>
+    void prefetchKeys() const { Prefetch::range(keys, sizeof(keys)); }
+
+    // Bytes holding keys, and bytes held outside the node.
+    size_t keyBytes() const { return size * sizeof(K); }
+
+    size_t heapBytes() const { return 0; }
+};
+
+template <class K, class V, size_t N, class Prefetch = NoPrefetch>
+class BTree;
+
+// BTree with the fan-out derived from a target node size in bytes.
+template <class K, class V, size_t NodeBytes = 4 * CACHE_LINE_SIZE>
+using TunedBTree = BTree<K, V, bTreeFanout<K, V>(NodeBytes)>;
+
+template <class K, class V, size_t N, class Prefetch>
+class BTree
+{
+public:
+
+    typedef BTreeNode<K, V, N> Node;
 
     typedef Node node_type;
     typedef node_type* node_ptr;
-    typedef typename node_type::elem_type elem_type;
-    typedef elem_type* elem_ptr;
+    typedef K key_type;
+    typedef V value_type;
+    typedef value_type* value_ptr;
     typedef typename node_type::size_type size_type;
+    typedef BTreeIterator<node_type> iterator;
+
+    static_assert(bTreeNodeBytes<K, V>(N) == sizeof(node_type),
+            "bTreeNodeBytes does not match the node layout");
 
     struct ElemChild
     {
-        typedef typename Node::elem_ptr elem_ptr;
         typedef typename Node::node_ptr node_ptr;
 
-        elem_ptr elem;
+        K key;
+        V value;
         node_ptr node;
     };
 
@@ -50,130 +217,333 @@ public:
 
     BTree();
 
+    template <class ForwardIterator>
+    BTree(ForwardIterator, ForwardIterator, double fillFactor = 1.0);
+
     ~BTree();
 
+    size_type size() const;
+
     size_type height() const;
 
     bool empty() const;
 
-    elem_ptr find(const K &) const;
+    value_ptr find(const K &) const;
+
+    iterator begin() const;
+
+    iterator end() const;
+
+    iterator lower_bound(const K &) const;
+
+    iterator upper_bound(const K &) const;
+
+    std::pair<iterator, iterator> equal_range(const K &) const;
 
     void insert(const K &, const V &);
 
     void erase(const K &);
 
+    void eraseRange(const K &, const K &);
+
     void clear();
 
+    template <class ForwardIterator>
+    void bulkLoad(ForwardIterator, ForwardIterator, double fillFactor = 1.0);
+
+    template <class ForwardIterator>
+    void insertBatch(ForwardIterator, ForwardIterator);
+
     void preOrder(void (*) (node_ptr));
 
-    void inOrder(void (*) (elem_ptr));
+    void inOrder(void (*) (const K &, V &));
 
     void postOrder(void (*) (node_ptr));
 
     void levelOrder(void (*) (node_ptr));
 
+    BTreeStats stats() const;
+
+    EytzingerIndex<K, V> freeze() const;
+
 private:
 
-    static size_type heightRecursion(node_ptr);
+    // Bound on the height, for the path stacks of insert and erase: nodes
+    // below the root have at least two children.
+    static const size_t MAX_HEIGHT = 8 * sizeof(size_type);
 
-    static elem_ptr findRecursion(node_ptr, const K &);
+    // How many elements insertBatch looks ahead to prefetch leaves.
+    static const size_t BATCH_PREFETCH_DISTANCE = 8;
 
-    static ElemChild insertRecursion(node_ptr, const K &, const V &);
+    // A node on the search path and the slot of the child taken from it.
+    struct PathEntry
+    {
+        node_ptr node;
+        size_t index;
+    };
 
-    static void eraseRecursion(node_ptr, const K &);
+    // A tree cut out by split or built by join, with its height. The root
+    // may hold fewer than the minimum number of keys but at least one.
+    struct Piece
+    {
+        node_ptr root;
+        size_type height;
+    };
 
-    static size_t countElements(node_ptr);
+    static void prefetchLeaf(node_ptr, const PathEntry *, size_t, const K &);
 
-    static ElemChild insertToNode(node_ptr, const ElemChild &);
+    static bool lowerBoundKey(node_ptr, const K &, K &);
+
+    bool split(Piece, const K &, Piece &, Piece &, V &);
+
+    Piece join(Piece, const K &, const V &, Piece);
+
+    void fixChild(node_ptr, size_t);
+
+    static size_type freeRecursion(node_ptr);
+
+    static size_type heightRecursion(node_ptr);
 
-    static ElemChild splitNode(node_ptr, const ElemChild &);
+    static size_type bulkLoadWidth(size_type, size_type);
 
-    static void insertNotFull(node_ptr, const ElemChild &);
+    template <class ForwardIterator>
+    static node_ptr bulkLoadRecursion(ForwardIterator &, ForwardIterator,
+            const std::vector<size_type> &, const std::vector<size_type> &,
+            size_t, size_type);
 
-    static void eraseLeaf(node_ptr, elem_ptr);
+    static value_ptr findRecursion(node_ptr, const K &);
 
-    static void repairNode(node_ptr, size_t);
+    ElemChild insertToNode(node_ptr, const K &, const V &, node_ptr);
 
-    static void borrowFromLeftBro(node_ptr, size_t);
+    ElemChild splitNode(node_ptr, const K &, const V &, node_ptr);
 
-    static void borrowFromRightBro(node_ptr, size_t);
+    static void insertNotFull(node_ptr, const K &, const V &, node_ptr);
 
-    static void mergeNodes(node_ptr, size_t);
+    void repairNode(node_ptr, size_t);
 
-    static elem_ptr findLargest(node_ptr);
+    void borrowFromLeftBro(node_ptr, size_t);
+
+    void borrowFromRightBro(node_ptr, size_t);
+
+    void mergeNodes(node_ptr, size_t);
 
     static node_ptr findLeftBrother(node_ptr, node_ptr);
 
     static void preOrderRecursion(node_ptr, void (*) (node_ptr));
 
-    static void inOrderRecursion(node_ptr, void (*) (elem_ptr));
+    static void inOrderRecursion(node_ptr, void (*) (const K &, V &));
 
     static void postOrderRecursion(node_ptr, void (*) (node_ptr));
 
+    static void statsRecursion(node_ptr, size_t, BTreeStats &);
+
+    static void freezeRecursion(node_ptr, std::vector<std::pair<K, V> > &);
+
 protected:
 
     node_ptr mRoot;
 
     size_type mTreeSize;
 
+    size_type mSplits;
+
+    size_type mMerges;
+
+    size_type mBorrows;
+
 };
 
-template <class K, class V, size_t N>
-BTree<K, V, N>::BTree()
-    : mRoot(NULL), mTreeSize(0)
+template <class K, class V, size_t N, class Prefetch>
+BTree<K, V, N, Prefetch>::BTree()
+    : mRoot(NULL), mTreeSize(0), mSplits(0), mMerges(0), mBorrows(0)
 {
 
 }
 
-template <class K, class V, size_t N>
-BTree<K, V, N>::~BTree()
+template <class K, class V, size_t N, class Prefetch>
+template <class ForwardIterator>
+BTree<K, V, N, Prefetch>::BTree(ForwardIterator first, ForwardIterator last,
+        double fillFactor)
+    : mRoot(NULL), mTreeSize(0), mSplits(0), mMerges(0), mBorrows(0)
+{
+    bulkLoad(first, last, fillFactor);
+}
+
+template <class K, class V, size_t N, class Prefetch>
+BTree<K, V, N, Prefetch>::~BTree()
 {
     clear();
 }
 
-template <class K, class V, size_t N>
-typename BTree<K, V, N>::size_type 
-BTree<K, V, N>::height() const
+template <class K, class V, size_t N, class Prefetch>
+typename BTree<K, V, N, Prefetch>::size_type
+BTree<K, V, N, Prefetch>::size() const
+{
+    return mTreeSize;
+}
+
+template <class K, class V, size_t N, class Prefetch>
+typename BTree<K, V, N, Prefetch>::size_type
+BTree<K, V, N, Prefetch>::height() const
 {
     return heightRecursion(mRoot);
 }
 
-template <class K, class V, size_t N>
-bool BTree<K, V, N>::empty() const
+template <class K, class V, size_t N, class Prefetch>
+bool BTree<K, V, N, Prefetch>::empty() const
 {
     return mTreeSize == 0;
 }
 
-template <class K, class V, size_t N>
-typename BTree<K, V, N>::elem_ptr 
-BTree<K, V, N>::find(const K & key) const
+template <class K, class V, size_t N, class Prefetch>
+typename BTree<K, V, N, Prefetch>::value_ptr
+BTree<K, V, N, Prefetch>::find(const K & key) const
 {
     return findRecursion(mRoot, key);
 }
 
-template <class K, class V, size_t N>
-void BTree<K, V, N>::insert(const K & key, const V & value)
+template <class K, class V, size_t N, class Prefetch>
+typename BTree<K, V, N, Prefetch>::iterator
+BTree<K, V, N, Prefetch>::begin() const
+{
+    return iterator::first(&mRoot);
+}
+
+template <class K, class V, size_t N, class Prefetch>
+typename BTree<K, V, N, Prefetch>::iterator
+BTree<K, V, N, Prefetch>::end() const
+{
+    return iterator(&mRoot);
+}
+
+template <class K, class V, size_t N, class Prefetch>
+typename BTree<K, V, N, Prefetch>::iterator
+BTree<K, V, N, Prefetch>::lower_bound(const K & key) const
+{
+    return iterator::lowerBound(&mRoot, key);
+}
+
+template <class K, class V, size_t N, class Prefetch>
+typename BTree<K, V, N, Prefetch>::iterator
+BTree<K, V, N, Prefetch>::upper_bound(const K & key) const
+{
+    return iterator::upperBound(&mRoot, key);
+}
+
+template <class K, class V, size_t N, class Prefetch>
+std::pair<typename BTree<K, V, N, Prefetch>::iterator, typename BTree<K, V, N, Prefetch>::iterator>
+BTree<K, V, N, Prefetch>::equal_range(const K & key) const
+{
+    return std::make_pair(lower_bound(key), upper_bound(key));
+}
+
+// Inserting a present key replaces its value, so keys stay unique.
+template <class K, class V, size_t N, class Prefetch>
+void BTree<K, V, N, Prefetch>::insert(const K & key, const V & value)
 {
     if (mRoot == NULL)
-        mRoot = new node_type(elem_type(key, value));
-    else
     {
-        ElemChild result = insertRecursion(mRoot, key, value);
+        mRoot = new node_type(key, value);
+        mTreeSize++;
+        return;
+    }
+
+    node_ptr path[MAX_HEIGHT];
+    size_t depth = 0;
 
-        if (result.elem != NULL)
+    node_ptr t = mRoot;
+    for (;;)
+    {
+        size_t index = t->lowerBound(key);
+        if (index < t->size && t->keyEquals(index, key))
         {
-            node_ptr newRoot = new node_type(*result.elem, mRoot, result.node);
-            mRoot = newRoot;
+            t->values[index] = value;
+            return;
         }
+
+        if (t->children[0] == NULL)
+            break;
+
+        path[depth++] = t;
+        t = t->children[index];
+    }
+
+    mTreeSize++;
+
+    // Splits move up the path until a node has room.
+    ElemChild result = insertToNode(t, key, value, NULL);
+    while (result.node != NULL && depth > 0)
+        result = insertToNode(path[--depth], result.key, result.value, result.node);
+
+    if (result.node != NULL)
+    {
+        node_ptr newRoot = new node_type(result.key, result.value,
+                mRoot, result.node);
+        mRoot = newRoot;
     }
 }
 
-template <class K, class V, size_t N>
-void BTree<K, V, N>::erase(const K & key)
+template <class K, class V, size_t N, class Prefetch>
+void BTree<K, V, N, Prefetch>::erase(const K & key)
 {
-    eraseRecursion(mRoot, key);
+    if (mRoot == NULL)
+        return;
+
+    const size_t MIN_NUM = (N - 1) / 2;
+
+    PathEntry path[MAX_HEIGHT];
+    size_t depth = 0;
+
+    node_ptr t = mRoot;
+    size_t index = t->lowerBound(key);
+    while (!(index < t->size && t->keyEquals(index, key)))
+    {
+        if (t->children[0] == NULL)
+            return;
+
+        path[depth++] = PathEntry{t, index};
+        t = t->children[index];
+        index = t->lowerBound(key);
+    }
 
-    if (mRoot->elements[0] == NULL)
+    if (t->children[0] != NULL)
+    {
+        // Replace the element by its predecessor, the largest element of
+        // the left subtree, and remove that one from its leaf instead.
+        node_ptr x = t;
+        size_t slot = index;
+
+        path[depth++] = PathEntry{t, index};
+        t = t->children[index];
+        while (t->children[0] != NULL)
+        {
+            path[depth++] = PathEntry{t, t->size};
+            t = t->children[t->size];
+        }
+
+        index = t->size - 1;
+        x->setKey(slot, t->key(index));
+        x->values[slot] = t->values[index];
+    }
+
+    t->eraseKey(index);
+    while (++index < t->size)
+        t->values[index - 1] = t->values[index];
+    t->size--;
+    mTreeSize--;
+
+    // Repair bottom-up; a node that keeps enough elements leaves the
+    // rest of the path untouched.
+    while (depth > 0)
+    {
+        PathEntry & entry = path[--depth];
+        if (entry.node->children[entry.index]->size >= MIN_NUM)
+            break;
+
+        repairNode(entry.node, entry.index);
+    }
+
+    if (mRoot->size == 0)
     {
         node_ptr newRoot = mRoot->children[0];
         delete mRoot;
@@ -181,33 +551,216 @@ void BTree<K, V, N>::erase(const K & key)
     }
 }
 
-template <class K, class V, size_t N>
-void BTree<K, V, N>::clear()
+// Erases every element with lo <= key < hi. Rather than erasing the keys
+// one by one, the tree is split at both ends of the range, the middle part
+// is freed subtree by subtree and the outer parts are joined again: only
+// the nodes along the two cut paths are touched and rebalanced.
+template <class K, class V, size_t N, class Prefetch>
+void BTree<K, V, N, Prefetch>::eraseRange(const K & lo, const K & hi)
+{
+    K first;
+    if (!lowerBoundKey(mRoot, lo, first) || !(first < hi))
+        return;
+
+    // The first element past the range joins the outer parts back
+    // together; split drops it from the middle part.
+    K boundKey;
+    bool bounded = lowerBoundKey(mRoot, hi, boundKey);
+
+    Piece tree = {mRoot, height()};
+    Piece below, rest, middle, above;
+    V value;
+
+    size_type erased = split(tree, lo, below, rest, value) ? 1 : 0;
+
+    if (bounded)
+    {
+        split(rest, boundKey, middle, above, value);
+        erased += freeRecursion(middle.root);
+        mRoot = join(below, boundKey, value, above).root;
+    }
+    else
+    {
+        erased += freeRecursion(rest.root);
+        mRoot = below.root;
+    }
+
+    mTreeSize -= erased;
+}
+
+template <class K, class V, size_t N, class Prefetch>
+void BTree<K, V, N, Prefetch>::clear()
 {
     postOrder([](node_ptr t){delete t;});
+
+    mRoot = NULL;
+    mTreeSize = 0;
+}
+
+// Builds the tree bottom-up from elements sorted by key (anything with
+// ->first and ->second, e.g. std::map iterators or a sorted array of
+// pairs) in one pass over the input after a counting pass. Keys stay
+// unique: of a run of equal keys only the last element is kept, as if
+// they had been inserted in order. Nodes are filled to
+// fillFactor * (N - 1) keys, as evenly as the node minimum allows.
+template <class K, class V, size_t N, class Prefetch>
+template <class ForwardIterator>
+void BTree<K, V, N, Prefetch>::bulkLoad(ForwardIterator first, ForwardIterator last,
+        double fillFactor)
+{
+    clear();
+
+    size_type count = 0;
+    for (ForwardIterator it = first; it != last; )
+    {
+        ForwardIterator next = it;
+        if (++next == last || it->first < next->first)
+            count++;
+        it = next;
+    }
+
+    if (count == 0)
+        return;
+
+    const size_type MIN_NUM = (N - 1) / 2;
+    size_type fill = size_type(fillFactor * (N - 1) + 0.5);
+    fill = std::max(MIN_NUM, std::min(size_type(N - 1), fill));
+
+    // A node with k keys takes k + 1 units: gaps between leaf keys at
+    // the bottom level, children at the levels above.
+    std::vector<size_type> units(1, count + 1);
+    std::vector<size_type> widths(1, bulkLoadWidth(count + 1, fill));
+    while (widths.back() > 1)
+    {
+        units.push_back(widths.back());
+        widths.push_back(bulkLoadWidth(units.back(), fill));
+    }
+
+    mRoot = bulkLoadRecursion(first, last, units, widths, widths.size() - 1, 0);
+    mTreeSize = count;
 }
 
+// Inserts elements sorted by key (->first, ->second, as for bulkLoad) in
+// one left-to-right walk. The path to the last leaf stays on a stack; the
+// next key only climbs as far as the first node whose key range still
+// covers it, so keys that land in the same leaf skip the descent. Splits
+// move up the stack as in insert, after which the walk resumes below the
+// highest node they changed. An empty tree is bulk loaded instead. As
+// with insert, a present key gets the new value.
+//
+// Sparse batches touch a new leaf per key, so the keys of the leaf for
+// the element BATCH_PREFETCH_DISTANCE positions ahead are prefetched
+// while the current one is inserted.
+template <class K, class V, size_t N, class Prefetch>
+template <class ForwardIterator>
+void BTree<K, V, N, Prefetch>::insertBatch(ForwardIterator first, ForwardIterator last)
+{
+    if (mRoot == NULL)
+    {
+        bulkLoad(first, last);
+        return;
+    }
 
-template <class K, class V, size_t N>
-void BTree<K, V, N>::preOrder(void (* visit) (node_ptr))
+    PathEntry path[MAX_HEIGHT];
+    size_t depth = 0;
+
+    ForwardIterator ahead = first;
+    for (size_t i = 0; i < BATCH_PREFETCH_DISTANCE && ahead != last; i++)
+        ++ahead;
+
+    for (; first != last; ++first)
+    {
+        const K & key = first->first;
+
+        // Keys only grow, so a subtree is left once the key passes its
+        // upper bound: the separator right of the deepest path entry that
+        // did not take the last child. That separator is the only one on
+        // the path the key can equal.
+        value_ptr present = NULL;
+        while (depth > 0)
+        {
+            size_t level = depth;
+            while (level > 0 && path[level - 1].index == path[level - 1].node->size)
+                level--;
+
+            if (level == 0)
+                break;
+
+            const PathEntry & bound = path[level - 1];
+            if (!bound.node->keyLess(bound.index, key))
+            {
+                if (bound.node->keyEquals(bound.index, key))
+                    present = &bound.node->values[bound.index];
+                break;
+            }
+
+            depth = level - 1;
+        }
+
+        node_ptr t = depth == 0 ? mRoot :
+                path[depth - 1].node->children[path[depth - 1].index];
+        while (present == NULL)
+        {
+            size_t index = t->lowerBound(key);
+            if (index < t->size && t->keyEquals(index, key))
+                present = &t->values[index];
+            else if (t->children[0] == NULL)
+                break;
+            else
+            {
+                path[depth++] = PathEntry{t, index};
+                t = t->children[index];
+            }
+        }
+
+        if (ahead != last)
+        {
+            prefetchLeaf(mRoot, path, depth, ahead->first);
+            ++ahead;
+        }
+
+        if (present != NULL)
+        {
+            *present = first->second;
+            continue;
+        }
+
+        ElemChild result = insertToNode(t, key, first->second, NULL);
+        while (result.node != NULL && depth > 0)
+            result = insertToNode(path[--depth].node, result.key, result.value,
+                    result.node);
+
+        if (result.node != NULL)
+        {
+            node_ptr newRoot = new node_type(result.key, result.value,
+                    mRoot, result.node);
+            mRoot = newRoot;
+        }
+
+        mTreeSize++;
+    }
+}
+
+template <class K, class V, size_t N, class Prefetch>
+void BTree<K, V, N, Prefetch>::preOrder(void (* visit) (node_ptr))
 {
     preOrderRecursion(mRoot, visit);
 }
 
-template <class K, class V, size_t N>
-void BTree<K, V, N>::inOrder(void (* visit) (elem_ptr))
+template <class K, class V, size_t N, class Prefetch>
+void BTree<K, V, N, Prefetch>::inOrder(void (* visit) (const K &, V &))
 {
     inOrderRecursion(mRoot, visit);
 }
 
-template <class K, class V, size_t N>
-void BTree<K, V, N>::postOrder(void (* visit) (node_ptr))
+template <class K, class V, size_t N, class Prefetch>
+void BTree<K, V, N, Prefetch>::postOrder(void (* visit) (node_ptr))
 {
     postOrderRecursion(mRoot, visit);
 }
 
-template <class K, class V, size_t N>
-void BTree<K, V, N>::levelOrder(void (* visit) (node_ptr))
+template <class K, class V, size_t N, class Prefetch>
+void BTree<K, V, N, Prefetch>::levelOrder(void (* visit) (node_ptr))
 {
     std::list<node_ptr> l;
     node_ptr t = this->mRoot;
@@ -216,9 +769,9 @@ void BTree<K, V, N>::levelOrder(void (* visit) (node_ptr))
     {
         visit(t);
 
-        size_t index = 0;
-        while (t->children[index] != NULL)
-            l.push_back(t->children[index]);
+        if (t->children[0] != NULL)
+            for (size_t index = 0; index <= t->size; index++)
+                l.push_back(t->children[index]);
 
         if (l.empty())
             return;
@@ -228,191 +781,436 @@ void BTree<K, V, N>::levelOrder(void (* visit) (node_ptr))
     }
 }
 
-template <class K, class V, size_t N>
-typename BTree<K, V, N>::size_type 
-BTree<K, V, N>::heightRecursion(node_ptr t)
+// Copies the elements into a read-only index that searches faster than the
+// tree; later changes to the tree do not reach it.
+template <class K, class V, size_t N, class Prefetch>
+EytzingerIndex<K, V> BTree<K, V, N, Prefetch>::freeze() const
 {
-    if (t == NULL)
-        return 0;
+    std::vector<std::pair<K, V> > elements;
+    elements.reserve(mTreeSize);
+    freezeRecursion(mRoot, elements);
 
-    return 1 + heightRecursion(t->children[0]);
+    return EytzingerIndex<K, V>(elements.begin(), elements.end());
 }
 
-template <class K, class V, size_t N>
-typename BTree<K, V, N>::elem_ptr 
-BTree<K, V, N>::findRecursion(node_ptr t, const K & key)
+// Walks every node, so the cost grows with the tree; the counters alone
+// are kept up to date for free.
+template <class K, class V, size_t N, class Prefetch>
+BTreeStats BTree<K, V, N, Prefetch>::stats() const
 {
-    if (t == NULL)
-        return NULL;
+    BTreeStats result = BTreeStats();
 
-    size_t index = 0;
-    while (t->elements[index] != NULL && t->elements[index]->first < key)
-        index++;
+    result.height = height();
+    result.elements = mTreeSize;
+    result.levelNodes.resize(result.height);
+    statsRecursion(mRoot, 0, result);
 
-    if (t->elements[index] != NULL && t->elements[index]->first == key)
-        return t->elements[index];
+    result.nodeBytes += result.nodes * sizeof(node_type);
+    result.elementBytes += result.elements * sizeof(V);
+    result.splits = mSplits;
+    result.merges = mMerges;
+    result.borrows = mBorrows;
 
-    return findRecursion(t->children[index], key);
+    return result;
 }
 
-template <class K, class V, size_t N>
-typename BTree<K, V, N>::ElemChild
-BTree<K, V, N>::insertRecursion(node_ptr t, const K & key, const V & value)
+// Prefetches the keys of the leaf that key goes to. Keys still under the
+// parent of the current leaf are skipped: the few leaves there are
+// usually cached already, and the descent would cost more than it saves.
+template <class K, class V, size_t N, class Prefetch>
+void BTree<K, V, N, Prefetch>::prefetchLeaf(node_ptr root, const PathEntry * path,
+        size_t depth, const K & key)
 {
-    if (t->children[0] == NULL)
-        return insertToNode(t, ElemChild{new elem_type(key, value), NULL});
+    size_t level = 0;
+    while (level < depth && !(path[level].index < path[level].node->size &&
+                path[level].node->keyLess(path[level].index, key)))
+        level++;
 
-    size_t index = 0;
-    while (t->elements[index] != NULL && t->elements[index]->first < key)
-        index++;
+    if (level + 1 >= depth)
+        return;
+
+    node_ptr t = root;
+    while (t->children[0] != NULL)
+        t = t->children[t->lowerBound(key)];
 
-    ElemChild result = insertRecursion(t->children[index], key, value);
-    return insertToNode(t, result);
+    t->template prefetchKeys<PrefetchNodes>();
 }
 
-template <class K, class V, size_t N>
-void BTree<K, V, N>::eraseRecursion(node_ptr t, const K & key)
+// Stores the smallest key not less than key in result; false if there is
+// none.
+template <class K, class V, size_t N, class Prefetch>
+bool BTree<K, V, N, Prefetch>::lowerBoundKey(node_ptr t, const K & key, K & result)
 {
-    if (t == NULL)
-        return;
+    bool found = false;
 
-    size_t index = 0;
-    while (t->elements[index] != NULL && t->elements[index]->first < key)
-        index++;
+    while (t != NULL)
+    {
+        size_t index = t->lowerBound(key);
+        if (index < t->size)
+        {
+            result = t->key(index);
+            found = true;
+        }
+
+        t = t->children[index];
+    }
+
+    return found;
+}
+
+// Cuts tree into the elements with smaller keys and those with larger ones.
+// Keys are unique, so at most one element has key itself; it is dropped
+// and its value stored in value.
+// Each node on the search path is divided in two; the parts of it on
+// either side are joined with what the level below left on that side.
+template <class K, class V, size_t N, class Prefetch>
+bool BTree<K, V, N, Prefetch>::split(Piece tree, const K & key,
+        Piece & left, Piece & right, V & value)
+{
+    if (tree.root == NULL)
+    {
+        left = right = Piece{NULL, 0};
+        return false;
+    }
+
+    node_ptr t = tree.root;
+    size_t index = t->lowerBound(key);
+    Piece below = {t->children[index], tree.height - 1};
+    Piece above = {NULL, 0};
+    bool here = index < t->size && t->keyEquals(index, key);
+    bool found = here;
 
-    if (t->elements[index] != NULL && t->elements[index]->first == key)
+    if (here)
     {
-        if (t->children[index] == NULL)
+        value = t->values[index];
+        above = Piece{t->children[index + 1], tree.height - 1};
+    }
+    else
+        found = split(below, key, below, above, value);
+
+    // Keys [0, index) and [first, size) of t go left and right.
+    size_t first = here ? index + 1 : index;
+    size_t count = t->size;
+
+    if (first == count)
+        right = above;
+    else
+    {
+        Piece rest = {t->children[count], tree.height - 1};
+        if (count - first > 1)
         {
-            eraseLeaf(t, t->elements[index]);
-            return;
+            rest = Piece{new node_type(), tree.height};
+
+            rest.root->appendKeys(*t, first + 1, count);
+
+            size_t moved = 0;
+            for (size_t i = first + 1; i < count; i++, moved++)
+            {
+                rest.root->values[moved] = t->values[i];
+                rest.root->children[moved] = t->children[i];
+            }
+            rest.root->children[moved] = t->children[count];
+            rest.root->size = moved;
+        }
+
+        right = join(above, t->key(first), t->values[first], rest);
+    }
+
+    if (index == 0)
+    {
+        left = below;
+        delete t;
+    }
+    else
+    {
+        K separator = t->key(index - 1);
+        V separatorValue = t->values[index - 1];
+
+        Piece rest = {t->children[0], tree.height - 1};
+        if (index > 1)
+        {
+            // t itself keeps the leading keys.
+            for (size_t i = index; i <= count; i++)
+                t->children[i] = NULL;
+            t->truncateKeys(index - 1);
+            t->size = index - 1;
+            rest = Piece{t, tree.height};
         }
         else
+            delete t;
+
+        left = join(rest, separator, separatorValue, below);
+    }
+
+    return found;
+}
+
+// Joins two trees around an element whose key lies between theirs. The
+// lower tree is hung beside the spine of the higher one, at the node one
+// level above its own height, and splits go up that spine as in insert.
+template <class K, class V, size_t N, class Prefetch>
+typename BTree<K, V, N, Prefetch>::Piece
+BTree<K, V, N, Prefetch>::join(Piece left, const K & key, const V & value,
+        Piece right)
+{
+    if (left.height == right.height)
+    {
+        node_ptr root = new node_type(key, value, left.root, right.root);
+
+        if (left.root != NULL)
         {
-            elem_ptr leaf = findLargest(t->children[index]);
-            t->elements[index] = leaf;
-            eraseLeaf(t->children[index], leaf);
+            fixChild(root, 0);
+            if (root->size > 0)
+                fixChild(root, 1);
         }
+
+        if (root->size == 0)
+        {
+            delete root;
+            return left;
+        }
+
+        return Piece{root, left.height + 1};
     }
-    else
-        eraseRecursion(t->children[index], key);
 
-    repairNode(t, index);
-    return;
+    bool hangRight = left.height > right.height;
+    Piece high = hangRight ? left : right;
+    Piece low = hangRight ? right : left;
+
+    node_ptr path[MAX_HEIGHT];
+    size_t depth = 0;
+
+    node_ptr t = high.root;
+    for (size_type h = high.height; h > low.height + 1; h--)
+    {
+        path[depth++] = t;
+        t = t->children[hangRight ? t->size : 0];
+    }
+
+    // t may hold N keys until it is split below.
+    insertNotFull(t, key, value, low.root);
+    if (!hangRight)
+        std::swap(t->children[0], t->children[1]);
+
+    if (low.root != NULL)
+        fixChild(t, hangRight ? t->size : 0);
+
+    ElemChild result = {K(), V(), NULL};
+    if (t->size == N)
+    {
+        K lastKey = t->key(N - 1);
+        V lastValue = t->values[N - 1];
+        t->truncateKeys(N - 1);
+        t->size--;
+        result = splitNode(t, lastKey, lastValue, t->children[N]);
+    }
+
+    while (result.node != NULL && depth > 0)
+        result = insertToNode(path[--depth], result.key, result.value, result.node);
+
+    if (result.node != NULL)
+    {
+        high.root = new node_type(result.key, result.value, high.root, result.node);
+        high.height++;
+    }
+
+    return high;
 }
 
-template <class K, class V, size_t N>
-size_t BTree<K, V, N>::countElements(node_ptr t)
+// Brings a child that may be far below the minimum up to it, one borrowed
+// element at a time, or merges it with a brother.
+template <class K, class V, size_t N, class Prefetch>
+void BTree<K, V, N, Prefetch>::fixChild(node_ptr t, size_t index)
 {
-    size_t count = 0;
-    while (t->elements[count] != NULL)
-        count++;
+    const size_t MIN_NUM = (N - 1) / 2;
+    size_t size = t->size;
 
+    while (t->size == size && t->children[index]->size < MIN_NUM)
+        repairNode(t, index);
+}
+
+// Frees the subtree and returns how many elements it held.
+template <class K, class V, size_t N, class Prefetch>
+typename BTree<K, V, N, Prefetch>::size_type
+BTree<K, V, N, Prefetch>::freeRecursion(node_ptr t)
+{
+    if (t == NULL)
+        return 0;
+
+    size_type count = t->size;
+    if (t->children[0] != NULL)
+        for (size_t index = 0; index <= t->size; index++)
+            count += freeRecursion(t->children[index]);
+
+    delete t;
     return count;
 }
 
-template <class K, class V, size_t N>
-typename BTree<K, V, N>::ElemChild
-BTree<K, V, N>::insertToNode(node_ptr t, const ElemChild & elemChild)
+template <class K, class V, size_t N, class Prefetch>
+typename BTree<K, V, N, Prefetch>::size_type
+BTree<K, V, N, Prefetch>::heightRecursion(node_ptr t)
 {
-    if (elemChild.elem == NULL)
-        return elemChild;
+    if (t == NULL)
+        return 0;
 
-    size_t index = countElements(t);
+    return 1 + heightRecursion(t->children[0]);
+}
 
-    if (index < N - 1)
-    {
-        insertNotFull(t, elemChild);
-        return ElemChild{NULL, NULL};
-    }
+template <class K, class V, size_t N, class Prefetch>
+typename BTree<K, V, N, Prefetch>::size_type
+BTree<K, V, N, Prefetch>::bulkLoadWidth(size_type units, size_type fill)
+{
+    const size_type MIN_NUM = (N - 1) / 2;
+
+    size_type width = (units + fill) / (fill + 1);
+    while (width > 1 && units < (MIN_NUM + 1) * width)
+        width--;
 
-    return splitNode(t, elemChild);
+    return width;
 }
 
-template <class K, class V, size_t N>
-typename BTree<K, V, N>::ElemChild
-BTree<K, V, N>::splitNode(node_ptr t, const ElemChild & elemChild)
+template <class K, class V, size_t N, class Prefetch>
+template <class ForwardIterator>
+typename BTree<K, V, N, Prefetch>::node_ptr
+BTree<K, V, N, Prefetch>::bulkLoadRecursion(ForwardIterator & first,
+        ForwardIterator last, const std::vector<size_type> & units,
+        const std::vector<size_type> & widths,
+        size_t level, size_type position)
 {
-    insertNotFull(t, elemChild);
+    size_type share = units[level] / widths[level];
+    size_type start = position * share + std::min(position, units[level] % widths[level]);
+    if (position < units[level] % widths[level])
+        share++;
 
-    node_ptr newNode = new node_type(); 
-    size_t d = (N + 1) / 2 - 1;
-    ElemChild result = {t->elements[d], newNode};
-    t->elements[d++] = NULL;
+    node_ptr t = new node_type();
+    K keys[N];
 
-    size_t index = 0;
-    while (index + d < N)
+    for (size_t index = 0; index < share; index++)
     {
-        newNode->elements[index] = t->elements[index + d];
-        newNode->children[index] = t->children[index + d];
-        t->elements[index + d] = NULL;
-        t->children[index + d] = NULL;
-        index++;
+        if (level > 0)
+            t->children[index] = bulkLoadRecursion(first, last, units, widths,
+                    level - 1, start + index);
+
+        if (index + 1 < share)
+        {
+            // Skip to the last element of a run of equal keys.
+            for (ForwardIterator next = first;
+                    ++next != last && !(first->first < next->first); )
+                first = next;
+
+            keys[index] = first->first;
+            t->values[index] = first->second;
+            ++first;
+        }
     }
-    newNode->children[index] = t->children[index + d];
-    t->children[index + d] = NULL;
 
-    return result;
+    t->assignKeys(keys, share - 1);
+    t->size = share - 1;
+
+    return t;
 }
 
-template <class K, class V, size_t N>
-void BTree<K, V, N>::insertNotFull(node_ptr t, const ElemChild & elemChild)
+template <class K, class V, size_t N, class Prefetch>
+typename BTree<K, V, N, Prefetch>::value_ptr
+BTree<K, V, N, Prefetch>::findRecursion(node_ptr t, const K & key)
 {
-    size_t index = 0;
-    while (t->elements[index] != NULL) index++;
+    if (t == NULL)
+        return NULL;
+
+    size_t index = t->lowerBound(key);
+
+    if (index < t->size && t->keyEquals(index, key))
+        return &t->values[index];
+
+    // Start loading every key line of the child at once, before its search
+    // touches them one after another.
+    node_ptr child = t->children[index];
+    if (child != NULL)
+        child->template prefetchKeys<Prefetch>();
+
+    return findRecursion(child, key);
+}
 
-    if (index > 0)
+template <class K, class V, size_t N, class Prefetch>
+typename BTree<K, V, N, Prefetch>::ElemChild
+BTree<K, V, N, Prefetch>::insertToNode(node_ptr t, const K & key, const V & value,
+        node_ptr child)
+{
+    if (t->size < N - 1)
     {
-        index--;
-        while (index < N && t->elements[index]->first > elemChild.elem->first)
-        {
-            t->elements[index + 1] = t->elements[index];
-            t->children[index + 2] = t->children[index + 1];
-            index--;
-        }
-        index++;
+        insertNotFull(t, key, value, child);
+        return ElemChild{K(), V(), NULL};
     }
 
-    t->elements[index] = elemChild.elem;
-    t->children[index + 1] = elemChild.node;
+    return splitNode(t, key, value, child);
 }
 
-template <class K, class V, size_t N>
-void BTree<K, V, N>::eraseLeaf(node_ptr t, elem_ptr elem)
+template <class K, class V, size_t N, class Prefetch>
+typename BTree<K, V, N, Prefetch>::ElemChild
+BTree<K, V, N, Prefetch>::splitNode(node_ptr t, const K & key, const V & value,
+        node_ptr child)
 {
-    if (t == NULL)
-        return;
+    mSplits++;
+
+    insertNotFull(t, key, value, child);
+
+    node_ptr newNode = new node_type();
+    size_t d = (N + 1) / 2 - 1;
+    ElemChild result = {t->key(d), t->values[d], newNode};
+
+    newNode->appendKeys(*t, d + 1, N);
+    t->truncateKeys(d);
 
     size_t index = 0;
-    while (t->elements[index] != NULL && t->elements[index]->first < elem->first)
+    while (index + d + 1 < N)
+    {
+        newNode->values[index] = t->values[index + d + 1];
+        newNode->children[index] = t->children[index + d + 1];
+        t->children[index + d + 1] = NULL;
         index++;
+    }
+    newNode->children[index] = t->children[index + d + 1];
+    t->children[index + d + 1] = NULL;
+
+    newNode->size = index;
+    t->size = d;
+
+    return result;
+}
 
-    if (t->elements[index] == NULL || t->elements[index]->first > elem->first)
+template <class K, class V, size_t N, class Prefetch>
+void BTree<K, V, N, Prefetch>::insertNotFull(node_ptr t, const K & key, const V & value,
+        node_ptr child)
+{
+    size_t index = t->lowerBound(key);
+
+    t->insertKey(index, key);
+    for (size_t slot = t->size; slot > index; slot--)
     {
-        eraseLeaf(t->children[index], elem);
-        repairNode(t, index);
+        t->values[slot] = t->values[slot - 1];
+        t->children[slot + 1] = t->children[slot];
     }
-    else
-        while (t->elements[index++] != NULL)
-            t->elements[index - 1] = t->elements[index];
 
+    t->values[index] = value;
+    t->children[index + 1] = child;
+    t->size++;
 }
 
-template <class K, class V, size_t N>
-void BTree<K, V, N>::repairNode(node_ptr t, size_t index)
+template <class K, class V, size_t N, class Prefetch>
+void BTree<K, V, N, Prefetch>::repairNode(node_ptr t, size_t index)
 {
     const size_t MIN_NUM = (N - 1) / 2;
     node_ptr x = t->children[index];
 
-    if (countElements(x) >= MIN_NUM)
+    if (x->size >= MIN_NUM)
         return;
 
     node_ptr leftBro = index > 0 ? t->children[index - 1] : NULL;
-    node_ptr rightBro = t->children[index + 1];
+    node_ptr rightBro = index < t->size ? t->children[index + 1] : NULL;
 
-    if (leftBro != NULL && countElements(leftBro) > MIN_NUM)
+    if (leftBro != NULL && leftBro->size > MIN_NUM)
         borrowFromLeftBro(t, index);
-    else if (rightBro != NULL && countElements(rightBro) > MIN_NUM)
+    else if (rightBro != NULL && rightBro->size > MIN_NUM)
         borrowFromRightBro(t, index);
     else
     {
@@ -420,150 +1218,199 @@ void BTree<K, V, N>::repairNode(node_ptr t, size_t index)
     }
 }
 
-template <class K, class V, size_t N>
-void BTree<K, V, N>::borrowFromLeftBro(node_ptr t, size_t index)
+template <class K, class V, size_t N, class Prefetch>
+void BTree<K, V, N, Prefetch>::borrowFromLeftBro(node_ptr t, size_t index)
 {
+    mBorrows++;
+
     node_ptr x = t->children[index];
     node_ptr left = t->children[index - 1];
 
-    size_t indexL = countElements(left);
-    size_t indexX = countElements(x);
+    size_t indexL = left->size;
+    size_t indexX = x->size;
+
+    x->insertKey(0, t->key(index - 1));
+    t->setKey(index - 1, left->key(indexL - 1));
+    left->eraseKey(indexL - 1);
 
     x->children[indexX + 1] = x->children[indexX];
     while (indexX > 0)
     {
-        t->elements[indexX] = t->elements[indexX - 1];
-        t->children[indexX] = t->children[indexX - 1];
+        x->values[indexX] = x->values[indexX - 1];
+        x->children[indexX] = x->children[indexX - 1];
         indexX--;
     }
 
-    x->elements[0] = t->elements[index - 1];
+    x->values[0] = t->values[index - 1];
     x->children[0] = left->children[indexL];
-    t->elements[index - 1] = left->elements[indexL - 1];
-    left->elements[indexL - 1] = NULL;
+    t->values[index - 1] = left->values[indexL - 1];
     left->children[indexL] = NULL;
+
+    left->size--;
+    x->size++;
 }
 
-template <class K, class V, size_t N>
-void BTree<K, V, N>::borrowFromRightBro(node_ptr t, size_t index)
+template <class K, class V, size_t N, class Prefetch>
+void BTree<K, V, N, Prefetch>::borrowFromRightBro(node_ptr t, size_t index)
 {
+    mBorrows++;
+
     node_ptr x = t->children[index];
     node_ptr right = t->children[index + 1];
 
     size_t indexR = 1;
-    size_t indexX = countElements(x);
+    size_t indexX = x->size;
 
-    x->elements[indexX] = t->elements[index];
-    x->children[x->children[0] != NULL ? indexX + 1 : indexX] = right->children[0];
-    t->elements[index] = right->elements[0];
+    x->insertKey(indexX, t->key(index));
+    t->setKey(index, right->key(0));
+    right->eraseKey(0);
 
-    while (right->elements[indexR] != NULL)
+    x->values[indexX] = t->values[index];
+    x->children[indexX + 1] = right->children[0];
+    t->values[index] = right->values[0];
+
+    while (indexR < right->size)
     {
-        right->elements[indexR - 1] = right->elements[indexR];
+        right->values[indexR - 1] = right->values[indexR];
         right->children[indexR - 1] = right->children[indexR];
         indexR++;
     }
     right->children[indexR - 1] = right->children[indexR];
-
-    right->elements[indexR - 1] = NULL;
     right->children[indexR] = NULL;
+
+    right->size--;
+    x->size++;
 }
 
-template <class K, class V, size_t N>
-void BTree<K, V, N>::mergeNodes(node_ptr t, size_t index)
+template <class K, class V, size_t N, class Prefetch>
+void BTree<K, V, N, Prefetch>::mergeNodes(node_ptr t, size_t index)
 {
+    mMerges++;
+
     node_ptr left = t->children[index];
     node_ptr right = t->children[index + 1];
-    size_t indexL = countElements(left);
-    
-    left->elements[indexL++] = t->elements[index];
-    while (t->elements[++index] != NULL)
+    size_t indexL = left->size;
+
+    left->insertKey(indexL, t->key(index));
+    left->values[indexL++] = t->values[index];
+    left->size = indexL;
+    left->appendKeys(*right, 0, right->size);
+
+    t->eraseKey(index);
+    while (++index < t->size)
     {
-        t->elements[index - 1] = t->elements[index];
+        t->values[index - 1] = t->values[index];
         t->children[index] = t->children[index + 1];
     }
-    t->elements[index - 1] = NULL;
     t->children[index] = NULL;
-    
+    t->size--;
+
     size_t indexR = 0;
-    while (right->elements[indexR] != NULL)
+    while (indexR < right->size)
     {
-        left->elements[index] = right->elements[indexR];
-        left->children[index++] = right->children[indexR++];
+        left->values[indexL] = right->values[indexR];
+        left->children[indexL++] = right->children[indexR++];
     }
     left->children[indexL] = right->children[indexR];
+    left->size = indexL;
 
     delete right;
 }
 
-template <class K, class V, size_t N>
-typename BTree<K, V, N>::elem_ptr 
-BTree<K, V, N>::findLargest(node_ptr t)
-{
-    size_t index = countElements(t);
-
-    if (index == 0)
-        return NULL;
-
-    if (t->children[index] != NULL)
-        return findLargest(t->children[index]);
-    else
-        return t->elements[index - 1];
-}
-
-template <class K, class V, size_t N>
-typename BTree<K, V, N>::node_ptr 
-BTree<K, V, N>::findLeftBrother(node_ptr t, node_ptr parent)
+template <class K, class V, size_t N, class Prefetch>
+typename BTree<K, V, N, Prefetch>::node_ptr
+BTree<K, V, N, Prefetch>::findLeftBrother(node_ptr t, node_ptr parent)
 {
     size_t index = 0;
-    while (parent->children[index] != NULL && parent->children[index] != t)
+    while (index <= parent->size && parent->children[index] != t)
         index++;
 
-    if (index == 0 || parent->children[index] == NULL)
+    if (index == 0 || index > parent->size)
         return NULL;
 
     return parent->children[index - 1];
 }
 
-template <class K, class V, size_t N>
-void BTree<K, V, N>::preOrderRecursion(node_ptr t, void (* visit) (node_ptr))
+template <class K, class V, size_t N, class Prefetch>
+void BTree<K, V, N, Prefetch>::preOrderRecursion(node_ptr t, void (* visit) (node_ptr))
 {
     if (t == NULL)
         return;
 
     visit(t);
 
-    size_t index = 0;
-    while (t->children[index] != NULL)
-        preOrderRecursion(t->children[index++], visit);
+    if (t->children[0] != NULL)
+        for (size_t index = 0; index <= t->size; index++)
+            preOrderRecursion(t->children[index], visit);
 }
 
-template <class K, class V, size_t N>
-void BTree<K, V, N>::inOrderRecursion(node_ptr t, void (* visit) (elem_ptr))
+template <class K, class V, size_t N, class Prefetch>
+void BTree<K, V, N, Prefetch>::inOrderRecursion(node_ptr t,
+        void (* visit) (const K &, V &))
 {
     if (t == NULL)
         return;
 
     size_t index = 0;
-    while (t->elements[index] != NULL)
+    while (index < t->size)
     {
         inOrderRecursion(t->children[index], visit);
-        visit(t->elements[index++]);
+        visit(t->key(index), t->values[index]);
+        index++;
     }
     inOrderRecursion(t->children[index], visit);
 }
 
-template <class K, class V, size_t N>
-void BTree<K, V, N>::postOrderRecursion(node_ptr t, void (* visit) (node_ptr))
+template <class K, class V, size_t N, class Prefetch>
+void BTree<K, V, N, Prefetch>::freezeRecursion(node_ptr t,
+        std::vector<std::pair<K, V> > & elements)
 {
     if (t == NULL)
         return;
 
     size_t index = 0;
-    while (t->children[index] != NULL)
-        postOrderRecursion(t->children[index++], visit);
+    while (index < t->size)
+    {
+        freezeRecursion(t->children[index], elements);
+        elements.push_back(std::make_pair(t->key(index), t->values[index]));
+        index++;
+    }
+    freezeRecursion(t->children[index], elements);
+}
+
+template <class K, class V, size_t N, class Prefetch>
+void BTree<K, V, N, Prefetch>::postOrderRecursion(node_ptr t, void (* visit) (node_ptr))
+{
+    if (t == NULL)
+        return;
+
+    if (t->children[0] != NULL)
+        for (size_t index = 0; index <= t->size; index++)
+            postOrderRecursion(t->children[index], visit);
 
     visit(t);
 }
 
+template <class K, class V, size_t N, class Prefetch>
+void BTree<K, V, N, Prefetch>::statsRecursion(node_ptr t, size_t level,
+        BTreeStats & result)
+{
+    if (t == NULL)
+        return;
+
+    size_t bucket = t->size * BTreeStats::FILL_BUCKETS / (N - 1);
+    result.fillHistogram[std::min(bucket, BTreeStats::FILL_BUCKETS - 1)]++;
+    result.levelNodes[level]++;
+    result.nodes++;
+    result.nodeBytes += t->heapBytes();
+    result.elementBytes += t->keyBytes();
+
+    if (t->children[0] != NULL)
+        for (size_t index = 0; index <= t->size; index++)
+            statsRecursion(t->children[index], level + 1, result);
+}
+
+// BTreeNode<std::string, V, N> is specialised to prefix-compress its keys.
+#include "stringBTree.h"
+
 #endif//__B_TREE_H__
@@ -0,0 +1,88 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+#include <malloc.h>
+
+#include "avlTree.h"
+
+using namespace std;
+
+typedef int Key;
+typedef int Value;
+typedef chrono::steady_clock Clock;
+
+static double nsPerOp(Clock::time_point begin, Clock::time_point end, size_t n)
+{
+    return chrono::duration<double, nano>(end - begin).count() / n;
+}
+
+// Heap bytes in use, counting the allocator's own overhead per block.
+static size_t heapBytes()
+{
+    return mallinfo2().uordblks;
+}
+
+// Inserts the keys in the given order, times random finds, then erases
+// the keys in the same order.
+template <class Tree>
+void bench(const char * name, const vector<Key> & keys, const vector<Key> & findKeys)
+{
+    Tree t;
+
+    size_t before = heapBytes();
+    Clock::time_point begin = Clock::now();
+    for (size_t i = 0; i < keys.size(); i++)
+        t.insert(keys[i], keys[i]);
+    Clock::time_point inserted = Clock::now();
+    size_t after = heapBytes();
+
+    long long sum = 0;
+    for (size_t i = 0; i < findKeys.size(); i++)
+        sum += t.find(findKeys[i])->second;
+    Clock::time_point found = Clock::now();
+
+    size_t height = t.height();
+
+    for (size_t i = 0; i < keys.size(); i++)
+        t.erase(keys[i]);
+    Clock::time_point erased = Clock::now();
+
+    cout << name
+        << "  insert: " << nsPerOp(begin, inserted, keys.size()) << " ns/op"
+        << "  find: " << nsPerOp(inserted, found, findKeys.size()) << " ns/op"
+        << "  erase: " << nsPerOp(found, erased, keys.size()) << " ns/op" << endl
+        << "            node: " << sizeof(typename Tree::node_type) << " bytes"
+        << "  heap: " << double(after - before) / keys.size() << " bytes/key"
+        << "  height: " << height
+        << (t.empty() && sum != 0 ? "" : "  (tree not emptied)") << endl;
+}
+
+int main(int argc, char ** argv)
+{
+    size_t size = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    size_t finds = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000000;
+
+    vector<Key> keys(size);
+    for (size_t i = 0; i < size; i++)
+        keys[i] = Key(i + 1);
+
+    vector<Key> findKeys(finds);
+    mt19937 random(7);
+    for (size_t i = 0; i < finds; i++)
+        findKeys[i] = Key(random() % size + 1);
+
+    cout << size << " integer keys, " << finds << " random finds" << endl;
+
+    bench<AVLTree<Key, Value> >("sequential", keys, findKeys);
+    bench<AVLTree<Key, Value, NoPrefetch, true> >("compact   ", keys, findKeys);
+
+    shuffle(keys.begin(), keys.end(), mt19937(42));
+    bench<AVLTree<Key, Value> >("random    ", keys, findKeys);
+    bench<AVLTree<Key, Value, NoPrefetch, true> >("compact   ", keys, findKeys);
+
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+#include "bTree.h"
+#include "bEpsilonTree.h"
+
+using namespace std;
+
+typedef int Key;
+typedef int Value;
+typedef chrono::steady_clock Clock;
+
+static double nsPerOp(Clock::time_point begin, Clock::time_point end, size_t n)
+{
+    return chrono::duration<double, nano>(end - begin).count() / n;
+}
+
+template <class Tree>
+void report(const char * name, Tree & t, const vector<Key> & insertKeys,
+        const vector<Key> & findKeys)
+{
+    Clock::time_point begin = Clock::now();
+    for (size_t i = 0; i < insertKeys.size(); i++)
+        t.insert(insertKeys[i], insertKeys[i]);
+    Clock::time_point inserted = Clock::now();
+
+    long long sum = 0;
+    for (size_t i = 0; i < findKeys.size(); i++)
+    {
+        Value value;
+        if (t.find(findKeys[i], value))
+            sum += value;
+    }
+    Clock::time_point found = Clock::now();
+
+    cout << name
+        << "  insert: " << nsPerOp(begin, inserted, insertKeys.size()) << " ns/op"
+        << "  find: " << nsPerOp(inserted, found, findKeys.size()) << " ns/op"
+        << "  (checksum " << sum << ")" << endl;
+}
+
+// Gives BTree the find(key, value) interface of the buffered tree.
+template <size_t N>
+struct PlainBTree : BTree<Key, Value, N>
+{
+    bool find(const Key & key, Value & value) const
+    {
+        Value * v = BTree<Key, Value, N>::find(key);
+        if (v != NULL)
+            value = *v;
+        return v != NULL;
+    }
+};
+
+int main(int argc, char ** argv)
+{
+    size_t size = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000000;
+
+    vector<Key> insertKeys(size);
+    for (size_t i = 0; i < size; i++)
+        insertKeys[i] = Key(i);
+
+    vector<Key> findKeys(insertKeys);
+    shuffle(insertKeys.begin(), insertKeys.end(), mt19937(42));
+    shuffle(findKeys.begin(), findKeys.end(), mt19937(7));
+
+    cout << size << " random integer keys" << endl;
+
+    {
+        PlainBTree<64> t;
+        report("BTree N = 64                 ", t, insertKeys, findKeys);
+    }
+    {
+        BEpsilonTree<Key, Value, 16> t;
+        report("BEpsilonTree N = 16, B = 512 ", t, insertKeys, findKeys);
+    }
+    {
+        BEpsilonTree<Key, Value, 32> t;
+        report("BEpsilonTree N = 32, B = 1024", t, insertKeys, findKeys);
+    }
+    {
+        BEpsilonTree<Key, Value, 64> t;
+        report("BEpsilonTree N = 64, B = 2048", t, insertKeys, findKeys);
+    }
+
+    return 0;
+}
@@ -0,0 +1,309 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+#include "bTree.h"
+
+using namespace std;
+
+typedef int Key;
+typedef int Value;
+typedef chrono::steady_clock Clock;
+
+static double nsPerOp(Clock::time_point begin, Clock::time_point end, size_t n)
+{
+    return chrono::duration<double, nano>(end - begin).count() / n;
+}
+
+template <size_t N>
+void benchLookup(const vector<Key> & insertKeys, const vector<Key> & findKeys)
+{
+    BTree<Key, Value, N> t;
+
+    Clock::time_point begin = Clock::now();
+    for (size_t i = 0; i < insertKeys.size(); i++)
+        t.insert(insertKeys[i], insertKeys[i]);
+    Clock::time_point inserted = Clock::now();
+
+    long long sum = 0;
+    for (size_t i = 0; i < findKeys.size(); i++)
+        sum += *t.find(findKeys[i]);
+    Clock::time_point found = Clock::now();
+
+    cout << "N = " << N
+        << "  insert: " << nsPerOp(begin, inserted, insertKeys.size()) << " ns/op"
+        << "  find: " << nsPerOp(inserted, found, findKeys.size()) << " ns/op"
+        << "  (checksum " << sum << ")" << endl;
+}
+
+template <size_t N>
+void benchUpdate(const vector<Key> & insertKeys, const vector<Key> & eraseKeys)
+{
+    BTree<Key, Value, N> t;
+
+    Clock::time_point begin = Clock::now();
+    for (size_t i = 0; i < insertKeys.size(); i++)
+        t.insert(insertKeys[i], insertKeys[i]);
+    Clock::time_point inserted = Clock::now();
+
+    for (size_t i = 0; i < eraseKeys.size(); i++)
+        t.erase(eraseKeys[i]);
+    Clock::time_point erased = Clock::now();
+
+    cout << "N = " << N
+        << "  insert: " << nsPerOp(begin, inserted, insertKeys.size()) << " ns/op"
+        << "  erase: " << nsPerOp(inserted, erased, eraseKeys.size()) << " ns/op"
+        << endl;
+}
+
+// Per-operation latency on a tree small enough to stay in cache: erase a
+// batch of present keys, insert them back, and repeat.
+template <size_t N>
+void benchChurn(const vector<Key> & keys, size_t rounds)
+{
+    const size_t BATCH = 1000;
+
+    if (keys.size() <= BATCH)
+        return;
+
+    BTree<Key, Value, N> t;
+    for (size_t i = 0; i < keys.size(); i++)
+        t.insert(keys[i], keys[i]);
+
+    double eraseNs = 0;
+    double insertNs = 0;
+    for (size_t round = 0; round < rounds; round++)
+    {
+        size_t first = round * BATCH % (keys.size() - BATCH);
+
+        Clock::time_point begin = Clock::now();
+        for (size_t i = first; i < first + BATCH; i++)
+            t.erase(keys[i]);
+        Clock::time_point erased = Clock::now();
+        for (size_t i = first; i < first + BATCH; i++)
+            t.insert(keys[i], keys[i]);
+        Clock::time_point inserted = Clock::now();
+
+        eraseNs += nsPerOp(begin, erased, BATCH);
+        insertNs += nsPerOp(erased, inserted, BATCH);
+    }
+
+    cout << "N = " << N
+        << "  insert: " << insertNs / rounds << " ns/op"
+        << "  erase: " << eraseNs / rounds << " ns/op"
+        << "  (" << t.size() << " keys)" << endl;
+}
+
+// Sorted batches of new keys merged into a tree loaded to the typical
+// B tree fill of 70%, one insert per key against one insertBatch per batch.
+template <size_t N>
+void benchBatch(const vector<pair<Key, Value> > & elements,
+        const vector<vector<pair<Key, Value> > > & batches)
+{
+    BTree<Key, Value, N> single(elements.begin(), elements.end(), 0.7);
+    BTree<Key, Value, N> batched(elements.begin(), elements.end(), 0.7);
+
+    size_t count = 0;
+    Clock::time_point begin = Clock::now();
+    for (size_t b = 0; b < batches.size(); b++)
+        for (size_t i = 0; i < batches[b].size(); i++)
+            single.insert(batches[b][i].first, batches[b][i].second);
+    Clock::time_point inserted = Clock::now();
+    for (size_t b = 0; b < batches.size(); b++)
+    {
+        batched.insertBatch(batches[b].begin(), batches[b].end());
+        count += batches[b].size();
+    }
+    Clock::time_point merged = Clock::now();
+
+    cout << "N = " << N
+        << "  insert: " << nsPerOp(begin, inserted, count) << " ns/key"
+        << "  insertBatch: " << nsPerOp(inserted, merged, count) << " ns/key"
+        << endl;
+}
+
+// Ranges of rangeSize keys, each stride keys after the previous one,
+// until half the tree is gone: erase key by key against one eraseRange per
+// range. A stride of rangeSize expires the oldest keys first, as a TTL
+// sweep does.
+template <size_t N>
+void benchEraseRange(const vector<pair<Key, Value> > & elements,
+        size_t rangeSize, size_t stride)
+{
+    BTree<Key, Value, N> single(elements.begin(), elements.end(), 0.7);
+    BTree<Key, Value, N> ranged(elements.begin(), elements.end(), 0.7);
+
+    size_t ranges = elements.size() / 2 / rangeSize;
+    size_t count = ranges * rangeSize;
+
+    Clock::time_point begin = Clock::now();
+    for (size_t r = 0; r < ranges; r++)
+        for (size_t i = r * stride; i < r * stride + rangeSize; i++)
+            single.erase(Key(i));
+    Clock::time_point erased = Clock::now();
+    for (size_t r = 0; r < ranges; r++)
+        ranged.eraseRange(Key(r * stride), Key(r * stride + rangeSize));
+    Clock::time_point rangeErased = Clock::now();
+
+    cout << "N = " << N
+        << "  erase: " << nsPerOp(begin, erased, count) << " ns/key"
+        << "  eraseRange: " << nsPerOp(erased, rangeErased, count) << " ns/key"
+        << (single.size() == ranged.size() ? "" : "  (sizes differ)") << endl;
+}
+
+template <size_t N>
+void benchBulkLoad(const vector<pair<Key, Value> > & elements)
+{
+    Clock::time_point begin = Clock::now();
+    {
+        BTree<Key, Value, N> t;
+        for (size_t i = 0; i < elements.size(); i++)
+            t.insert(elements[i].first, elements[i].second);
+    }
+    Clock::time_point inserted = Clock::now();
+    {
+        BTree<Key, Value, N> t(elements.begin(), elements.end());
+    }
+    Clock::time_point loaded = Clock::now();
+
+    cout << "N = " << N
+        << "  sorted insert: " << nsPerOp(begin, inserted, elements.size()) << " ns/key"
+        << "  bulk load: " << nsPerOp(inserted, loaded, elements.size()) << " ns/key"
+        << endl;
+}
+
+template <size_t N>
+void benchStringLookup(const vector<string> & insertKeys,
+        const vector<string> & findKeys)
+{
+    BTree<string, Value, N> t;
+
+    Clock::time_point begin = Clock::now();
+    for (size_t i = 0; i < insertKeys.size(); i++)
+        t.insert(insertKeys[i], Value(i));
+    Clock::time_point inserted = Clock::now();
+
+    long long sum = 0;
+    for (size_t i = 0; i < findKeys.size(); i++)
+        sum += *t.find(findKeys[i]);
+    Clock::time_point found = Clock::now();
+
+    cout << "N = " << N
+        << "  insert: " << nsPerOp(begin, inserted, insertKeys.size()) << " ns/op"
+        << "  find: " << nsPerOp(inserted, found, findKeys.size()) << " ns/op"
+        << "  (checksum " << sum << ")" << endl;
+}
+
+int main(int argc, char ** argv)
+{
+    size_t size = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000000;
+
+    vector<Key> insertKeys(size);
+    for (size_t i = 0; i < size; i++)
+        insertKeys[i] = Key(i);
+
+    vector<Key> findKeys(insertKeys);
+    shuffle(insertKeys.begin(), insertKeys.end(), mt19937(42));
+    shuffle(findKeys.begin(), findKeys.end(), mt19937(7));
+
+    cout << size << " random integer keys" << endl;
+
+    benchLookup<8>(insertKeys, findKeys);
+    benchLookup<16>(insertKeys, findKeys);
+    benchLookup<32>(insertKeys, findKeys);
+    benchLookup<64>(insertKeys, findKeys);
+    benchLookup<128>(insertKeys, findKeys);
+
+    cout << size << " random integer keys (insert all, erase all)" << endl;
+
+    benchUpdate<8>(insertKeys, findKeys);
+    benchUpdate<16>(insertKeys, findKeys);
+    benchUpdate<64>(insertKeys, findKeys);
+
+    vector<Key> churnKeys(insertKeys.begin(),
+            insertKeys.begin() + min(size, size_t(10000)));
+
+    cout << churnKeys.size() << " random integer keys (erase and reinsert in batches)" << endl;
+
+    benchChurn<8>(churnKeys, 2000);
+    benchChurn<16>(churnKeys, 2000);
+    benchChurn<64>(churnKeys, 2000);
+
+    vector<pair<Key, Value> > elements(size);
+    for (size_t i = 0; i < size; i++)
+        elements[i] = make_pair(Key(i), Value(i));
+
+    // Odd keys in random sorted batches into a tree of the even ones.
+    vector<pair<Key, Value> > evens(size);
+    vector<pair<Key, Value> > odds(size);
+    for (size_t i = 0; i < size; i++)
+    {
+        evens[i] = make_pair(Key(2 * i), Value(i));
+        odds[i] = make_pair(Key(2 * i + 1), Value(i));
+    }
+    shuffle(odds.begin(), odds.end(), mt19937(42));
+
+    for (size_t batchSize = 10000; batchSize <= 100000; batchSize *= 10)
+    {
+        vector<vector<pair<Key, Value> > > batches;
+        for (size_t first = 0; first + batchSize <= size / 10; first += batchSize)
+        {
+            batches.push_back(vector<pair<Key, Value> >(odds.begin() + first,
+                        odds.begin() + first + batchSize));
+            sort(batches.back().begin(), batches.back().end());
+        }
+
+        cout << batches.size() << " sorted batches of " << batchSize
+            << " keys into " << size << " keys" << endl;
+
+        benchBatch<16>(evens, batches);
+        benchBatch<64>(evens, batches);
+    }
+
+    for (size_t rangeSize = 1000; rangeSize <= 100000; rangeSize *= 100)
+    {
+        cout << "ranges of " << rangeSize << " keys expired from " << size
+            << " keys, oldest first" << endl;
+
+        benchEraseRange<16>(elements, rangeSize, rangeSize);
+        benchEraseRange<64>(elements, rangeSize, rangeSize);
+
+        cout << "ranges of " << rangeSize << " keys erased from " << size
+            << " keys, every other range" << endl;
+
+        benchEraseRange<16>(elements, rangeSize, 2 * rangeSize);
+        benchEraseRange<64>(elements, rangeSize, 2 * rangeSize);
+    }
+
+    cout << size << " sorted integer keys (build + destroy)" << endl;
+
+    benchBulkLoad<16>(elements);
+    benchBulkLoad<64>(elements);
+
+    // URL-like keys with long shared prefixes, a tenth of the integer count.
+    size_t stringSize = size / 10;
+    vector<string> urls(stringSize);
+    for (size_t i = 0; i < stringSize; i++)
+    {
+        char buffer[96];
+        snprintf(buffer, sizeof buffer,
+                "https://example.com/static/images/%03zu/%08zu.png", i % 997, i);
+        urls[i] = buffer;
+    }
+
+    vector<string> findUrls(urls);
+    shuffle(urls.begin(), urls.end(), mt19937(42));
+    shuffle(findUrls.begin(), findUrls.end(), mt19937(7));
+
+    cout << stringSize << " random URL keys" << endl;
+
+    benchStringLookup<16>(urls, findUrls);
+    benchStringLookup<64>(urls, findUrls);
+
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+#include "bTree.h"
+
+using namespace std;
+
+typedef int Key;
+typedef int Value;
+typedef chrono::steady_clock Clock;
+
+// Builds a tree for the node size, then reports lookup rate, memory and
+// how full random inserts leave the nodes.
+template <class K, size_t NodeBytes>
+void benchFanout(const vector<K> & insertKeys, const vector<K> & findKeys)
+{
+    typedef TunedBTree<K, Value, NodeBytes> Tree;
+    static_assert(sizeof(typename Tree::node_type) <= NodeBytes ||
+            bTreeFanout<K, Value>(NodeBytes) == 3,
+            "tuned node exceeds its target size");
+
+    Tree t;
+    for (size_t i = 0; i < insertKeys.size(); i++)
+        t.insert(insertKeys[i], Value(i));
+
+    Clock::time_point begin = Clock::now();
+    long long sum = 0;
+    for (size_t i = 0; i < findKeys.size(); i++)
+        sum += *t.find(findKeys[i]);
+    Clock::time_point end = Clock::now();
+
+    BTreeStats stats = t.stats();
+    size_t n = bTreeFanout<K, Value>(NodeBytes);
+
+    double seconds = chrono::duration<double>(end - begin).count();
+
+    cout << "node " << NodeBytes << " B"
+        << "  N = " << n
+        << "  height " << stats.height
+        << "  lookups: " << findKeys.size() / seconds / 1e6 << " M/s"
+        << "  bytes/key: " << double(stats.nodeBytes) / stats.elements
+        << "  fill: " << double(stats.elements) / (stats.nodes * (n - 1))
+        << "  splits/key: " << double(stats.splits) / stats.elements
+        << "  (checksum " << sum << ")" << endl;
+}
+
+// URL-like keys: a long shared host and path, then a distinct tail.
+string urlKey(size_t i)
+{
+    char tail[32];
+    snprintf(tail, sizeof tail, "%zu/%zu", i % 1000, i);
+    return string("https://example.com/catalog/item/") + tail;
+}
+
+int main(int argc, char ** argv)
+{
+    size_t size = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000000;
+
+    vector<Key> insertKeys(size);
+    for (size_t i = 0; i < size; i++)
+        insertKeys[i] = Key(i);
+
+    vector<Key> findKeys(insertKeys);
+    shuffle(insertKeys.begin(), insertKeys.end(), mt19937(42));
+    shuffle(findKeys.begin(), findKeys.end(), mt19937(7));
+
+    cout << size << " random integer keys, fan-out from node size" << endl;
+
+    benchFanout<Key, CACHE_LINE_SIZE>(insertKeys, findKeys);
+    benchFanout<Key, 2 * CACHE_LINE_SIZE>(insertKeys, findKeys);
+    benchFanout<Key, 4 * CACHE_LINE_SIZE>(insertKeys, findKeys);
+    benchFanout<Key, 8 * CACHE_LINE_SIZE>(insertKeys, findKeys);
+    benchFanout<Key, 16 * CACHE_LINE_SIZE>(insertKeys, findKeys);
+    benchFanout<Key, 32 * CACHE_LINE_SIZE>(insertKeys, findKeys);
+    benchFanout<Key, 64 * CACHE_LINE_SIZE>(insertKeys, findKeys);
+
+    // String keys are prefix-compressed, so their nodes have a layout of
+    // their own; a tenth as many keys keeps the run short.
+    size_t stringSize = size / 10;
+
+    vector<string> insertUrls(stringSize);
+    for (size_t i = 0; i < stringSize; i++)
+        insertUrls[i] = urlKey(i);
+
+    vector<string> findUrls(insertUrls);
+    shuffle(insertUrls.begin(), insertUrls.end(), mt19937(42));
+    shuffle(findUrls.begin(), findUrls.end(), mt19937(7));
+
+    cout << endl << stringSize << " random URL keys, fan-out from node size" << endl;
+
+    benchFanout<string, 4 * CACHE_LINE_SIZE>(insertUrls, findUrls);
+    benchFanout<string, 8 * CACHE_LINE_SIZE>(insertUrls, findUrls);
+    benchFanout<string, 16 * CACHE_LINE_SIZE>(insertUrls, findUrls);
+    benchFanout<string, 64 * CACHE_LINE_SIZE>(insertUrls, findUrls);
+
+    return 0;
+}
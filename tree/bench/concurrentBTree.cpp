@@ -0,0 +1,113 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <chrono>
+
+#include "bTree.h"
+#include "concurrentBTree.h"
+
+using namespace std;
+
+const size_t N = 64;
+
+typedef int Key;
+typedef int Value;
+typedef chrono::steady_clock Clock;
+
+const size_t OPS_PER_THREAD = 1000000;
+
+// Global mutex around the plain tree, the setup this replaces.
+struct LockedBTree
+{
+    BTree<Key, Value, N> tree;
+    mutex lock;
+
+    bool find(const Key & key, Value & value)
+    {
+        lock_guard<mutex> guard(lock);
+        Value * v = tree.find(key);
+        if (v != NULL)
+            value = *v;
+        return v != NULL;
+    }
+
+    void insert(const Key & key, const Value & value)
+    {
+        lock_guard<mutex> guard(lock);
+        if (tree.find(key) == NULL)
+            tree.insert(key, value);
+    }
+
+    void erase(const Key & key)
+    {
+        lock_guard<mutex> guard(lock);
+        tree.erase(key);
+    }
+};
+
+// Every thread runs OPS_PER_THREAD operations on random keys in
+// [0, 2 * size); writePercent of them are split evenly between insert
+// and erase, the rest are lookups.
+template <class Tree>
+void worker(Tree & t, size_t size, unsigned seed, int writePercent, long long & hits)
+{
+    for (size_t i = 0; i < OPS_PER_THREAD; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        Key k = Key((seed >> 4) % (2 * size));
+        int op = (seed >> 24) % 100;
+
+        Value v;
+        if (op >= writePercent)
+            hits += t.find(k, v);
+        else if (op % 2 == 0)
+            t.insert(k, k);
+        else
+            t.erase(k);
+    }
+}
+
+template <class Tree>
+void bench(const char * name, size_t size, int writePercent, size_t threads)
+{
+    Tree t;
+    for (size_t i = 0; i < 2 * size; i += 2)
+        t.insert(Key(i), Value(i));
+
+    vector<thread> workers;
+    vector<long long> hits(threads, 0);
+
+    Clock::time_point begin = Clock::now();
+    for (size_t i = 0; i < threads; i++)
+        workers.push_back(thread(worker<Tree>, ref(t), size, unsigned(i + 1),
+                    writePercent, ref(hits[i])));
+    for (size_t i = 0; i < threads; i++)
+        workers[i].join();
+    Clock::time_point end = Clock::now();
+
+    double seconds = chrono::duration<double>(end - begin).count();
+
+    cout << name << "  threads = " << threads
+        << "  writes = " << writePercent << "%"
+        << "  " << threads * OPS_PER_THREAD / seconds / 1e6 << " Mops/s" << endl;
+}
+
+int main(int argc, char ** argv)
+{
+    size_t size = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    size_t maxThreads = argc > 2 ? strtoul(argv[2], NULL, 10) : 32;
+
+    cout << size << " keys, " << thread::hardware_concurrency()
+        << " hardware threads" << endl;
+
+    for (int writePercent = 0; writePercent <= 20; writePercent += 10)
+        for (size_t threads = 1; threads <= maxThreads; threads *= 2)
+        {
+            bench<ConcurrentBTree<Key, Value, N> >("olc   ", size, writePercent, threads);
+            bench<LockedBTree>("mutex ", size, writePercent, threads);
+        }
+
+    return 0;
+}
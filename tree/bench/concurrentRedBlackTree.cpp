@@ -0,0 +1,126 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <shared_mutex>
+#include <chrono>
+
+#include "redBlackTree.h"
+#include "concurrentRedBlackTree.h"
+
+using namespace std;
+
+typedef int Key;
+typedef int Value;
+typedef chrono::steady_clock Clock;
+
+const size_t LOOKUPS_PER_READER = 2000000;
+
+// The plain tree behind a reader-writer lock, the setup this replaces.
+struct LockedRedBlackTree
+{
+    RedBlackTree<Key, Value> tree;
+    mutable shared_mutex lock;
+
+    bool find(const Key & key, Value & value) const
+    {
+        shared_lock<shared_mutex> guard(lock);
+        RedBlackTree<Key, Value>::elem_ptr e = tree.find(key);
+        if (e != NULL)
+            value = e->second;
+        return e != NULL;
+    }
+
+    void insert(const Key & key, const Value & value)
+    {
+        unique_lock<shared_mutex> guard(lock);
+        tree.insert(key, value);
+    }
+
+    void erase(const Key & key)
+    {
+        unique_lock<shared_mutex> guard(lock);
+        tree.erase(key);
+    }
+};
+
+template <class Tree>
+void reader(const Tree & t, size_t size, unsigned seed, long long & hits)
+{
+    for (size_t i = 0; i < LOOKUPS_PER_READER; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        Value v;
+        hits += t.find(Key((seed >> 4) % (2 * size)), v);
+    }
+}
+
+// Inserts and erases random keys for as long as the readers run.
+template <class Tree>
+void writer(Tree & t, size_t size, atomic<bool> & running, long long & writes)
+{
+    unsigned seed = 12345;
+
+    while (running.load(memory_order_relaxed))
+    {
+        seed = seed * 1103515245 + 12345;
+        Key k = Key((seed >> 4) % (2 * size));
+
+        if ((seed >> 24) % 2 == 0)
+            t.insert(k, k);
+        else
+            t.erase(k);
+
+        writes++;
+    }
+}
+
+template <class Tree>
+void bench(const char * name, size_t size, size_t readers)
+{
+    Tree t;
+    for (size_t i = 0; i < 2 * size; i += 2)
+        t.insert(Key(i), Value(i));
+
+    atomic<bool> running(true);
+    long long writes = 0;
+    vector<long long> hits(readers, 0);
+
+    thread writerThread(writer<Tree>, ref(t), size, ref(running), ref(writes));
+
+    vector<thread> readerThreads;
+    Clock::time_point begin = Clock::now();
+    for (size_t i = 0; i < readers; i++)
+        readerThreads.push_back(thread(reader<Tree>, cref(t), size,
+                    unsigned(i + 1), ref(hits[i])));
+    for (size_t i = 0; i < readers; i++)
+        readerThreads[i].join();
+    Clock::time_point end = Clock::now();
+
+    running.store(false);
+    writerThread.join();
+
+    double seconds = chrono::duration<double>(end - begin).count();
+
+    cout << name << "  readers = " << readers
+        << "  lookups " << readers * LOOKUPS_PER_READER / seconds / 1e6 << " Mops/s"
+        << "  writes " << writes / seconds / 1e3 << " Kops/s" << endl;
+}
+
+int main(int argc, char ** argv)
+{
+    size_t size = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    size_t maxReaders = argc > 2 ? strtoul(argv[2], NULL, 10) : 32;
+
+    cout << size << " keys, one writer, " << thread::hardware_concurrency()
+        << " hardware threads" << endl;
+
+    for (size_t readers = 1; readers <= maxReaders; readers *= 2)
+    {
+        bench<ConcurrentRedBlackTree<Key, Value> >("rcu    ", size, readers);
+        bench<LockedRedBlackTree>("rwlock ", size, readers);
+    }
+
+    return 0;
+}
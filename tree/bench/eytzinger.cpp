@@ -0,0 +1,87 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+#include "avlTree.h"
+#include "redBlackTree.h"
+#include "bTree.h"
+#include "eytzinger.h"
+
+using namespace std;
+
+typedef int Key;
+typedef int Value;
+typedef chrono::steady_clock Clock;
+
+static double nsPerOp(Clock::time_point begin, Clock::time_point end, size_t n)
+{
+    return chrono::duration<double, nano>(end - begin).count() / n;
+}
+
+// The B trees return the value, the binary trees and the index the element.
+static Value valueOf(const Value * v) { return *v; }
+static Value valueOf(const pair<const Key, Value> * e) { return e->second; }
+
+template <class Searchable>
+double timeFind(const Searchable & s, const vector<Key> & findKeys, long long & sum)
+{
+    Clock::time_point begin = Clock::now();
+    for (size_t i = 0; i < findKeys.size(); i++)
+        sum += valueOf(s.find(findKeys[i]));
+    Clock::time_point end = Clock::now();
+
+    return nsPerOp(begin, end, findKeys.size());
+}
+
+// Random lookups in a tree built from random keys, then in its frozen index.
+template <class Tree>
+void bench(const char * name, const vector<Key> & insertKeys,
+        const vector<Key> & findKeys)
+{
+    Tree t;
+    for (size_t i = 0; i < insertKeys.size(); i++)
+        t.insert(insertKeys[i], insertKeys[i]);
+
+    Clock::time_point begin = Clock::now();
+    EytzingerIndex<Key, Value> frozen = t.freeze();
+    Clock::time_point end = Clock::now();
+
+    long long treeSum = 0;
+    long long frozenSum = 0;
+    double tree = timeFind(t, findKeys, treeSum);
+    double index = timeFind(frozen, findKeys, frozenSum);
+
+    cout << name
+        << "  find: " << tree << " ns/op"
+        << "  frozen: " << index << " ns/op"
+        << "  (" << tree / index << "x, freeze "
+        << nsPerOp(begin, end, insertKeys.size()) << " ns/key)"
+        << (treeSum == frozenSum ? "" : "  (checksums differ)") << endl;
+}
+
+int main(int argc, char ** argv)
+{
+    size_t size = argc > 1 ? strtoul(argv[1], NULL, 10) : 4000000;
+    size_t finds = argc > 2 ? strtoul(argv[2], NULL, 10) : 2000000;
+
+    vector<Key> insertKeys(size);
+    for (size_t i = 0; i < size; i++)
+        insertKeys[i] = Key(i);
+    shuffle(insertKeys.begin(), insertKeys.end(), mt19937(42));
+
+    vector<Key> findKeys(finds);
+    mt19937 random(7);
+    for (size_t i = 0; i < finds; i++)
+        findKeys[i] = Key(random() % size);
+
+    cout << size << " random integer keys, " << finds << " random finds" << endl;
+
+    bench<RedBlackTree<Key, Value> >("RedBlackTree", insertKeys, findKeys);
+    bench<AVLTree<Key, Value> >("AVLTree     ", insertKeys, findKeys);
+    bench<BTree<Key, Value, 64> >("BTree<64>   ", insertKeys, findKeys);
+
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+#include "bTree.h"
+#include "loggedBTree.h"
+
+using namespace std;
+
+const size_t N = 64;
+
+typedef int Key;
+typedef int Value;
+typedef chrono::steady_clock Clock;
+typedef LoggedBTree<Key, Value, N> Tree;
+
+// Each group size is timed over at most this many commits, so that the
+// sync per write of small groups stays affordable.
+const size_t MAX_COMMITS = 2000;
+
+const char * PATH = "loggedBTree_bench";
+
+static double nsPerOp(Clock::time_point begin, Clock::time_point end, size_t n)
+{
+    return chrono::duration<double, nano>(end - begin).count() / n;
+}
+
+static void removeFiles()
+{
+    remove("loggedBTree_bench.log");
+    remove("loggedBTree_bench.checkpoint");
+}
+
+void benchPlain(const vector<Key> & keys)
+{
+    BTree<Key, Value, N> t;
+
+    Clock::time_point begin = Clock::now();
+    for (size_t i = 0; i < keys.size(); i++)
+        t.insert(keys[i], keys[i]);
+    Clock::time_point end = Clock::now();
+
+    cout << "no log        insert: " << nsPerOp(begin, end, keys.size())
+        << " ns/op" << endl;
+}
+
+void benchGroup(const vector<Key> & keys, size_t groupSize)
+{
+    size_t writes = min(keys.size(), groupSize * MAX_COMMITS);
+
+    removeFiles();
+    Tree t(PATH, groupSize, 0);
+
+    Clock::time_point begin = Clock::now();
+    for (size_t i = 0; i < writes; i++)
+        t.insert(keys[i], keys[i]);
+    t.commit();
+    Clock::time_point end = Clock::now();
+
+    cout << "group " << groupSize;
+    for (size_t width = to_string(groupSize).size(); width < 8; width++)
+        cout << " ";
+    cout << "insert: " << nsPerOp(begin, end, writes) << " ns/op"
+        << "  (" << writes << " writes)" << endl;
+}
+
+// Recovery from a log alone against recovery from a checkpoint alone.
+void benchRecovery(const vector<Key> & keys)
+{
+    removeFiles();
+    {
+        Tree t(PATH, 4096, 0);
+        for (size_t i = 0; i < keys.size(); i++)
+            t.insert(keys[i], keys[i]);
+    }
+
+    Clock::time_point begin = Clock::now();
+    {
+        Tree t(PATH, 4096, 0);
+        Clock::time_point replayed = Clock::now();
+
+        t.checkpoint();
+        Clock::time_point written = Clock::now();
+
+        cout << "replay:     " << nsPerOp(begin, replayed, keys.size()) << " ns/key"
+            << "  checkpoint: " << nsPerOp(replayed, written, keys.size()) << " ns/key"
+            << endl;
+    }
+
+    begin = Clock::now();
+    {
+        Tree t(PATH, 4096, 0);
+        Clock::time_point loaded = Clock::now();
+
+        cout << "load:       " << nsPerOp(begin, loaded, keys.size()) << " ns/key"
+            << "  (" << t.size() << " keys)" << endl;
+    }
+
+    removeFiles();
+}
+
+int main(int argc, char ** argv)
+{
+    size_t size = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+
+    vector<Key> keys(size);
+    for (size_t i = 0; i < size; i++)
+        keys[i] = Key(i);
+    shuffle(keys.begin(), keys.end(), mt19937(42));
+
+    cout << size << " random integer keys" << endl;
+
+    benchPlain(keys);
+    for (size_t groupSize = 1; groupSize <= 16384; groupSize *= 8)
+        benchGroup(keys, groupSize);
+
+    cout << size << " keys reopened" << endl;
+
+    benchRecovery(keys);
+
+    return 0;
+}
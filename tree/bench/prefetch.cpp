@@ -0,0 +1,90 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+#include "bTree.h"
+#include "binarySearchTree.h"
+#include "avlTree.h"
+#include "redBlackTree.h"
+
+using namespace std;
+
+typedef int Key;
+typedef int Value;
+typedef chrono::steady_clock Clock;
+
+static double nsPerOp(Clock::time_point begin, Clock::time_point end, size_t n)
+{
+    return chrono::duration<double, nano>(end - begin).count() / n;
+}
+
+// The B trees return the value, the binary trees the whole element.
+static Value valueOf(const Value * v) { return *v; }
+static Value valueOf(const pair<const Key, Value> * e) { return e->second; }
+
+template <class Tree>
+double timeFind(const vector<Key> & insertKeys, const vector<Key> & findKeys,
+        long long & sum)
+{
+    Tree t;
+    for (size_t i = 0; i < insertKeys.size(); i++)
+        t.insert(insertKeys[i], insertKeys[i]);
+
+    Clock::time_point begin = Clock::now();
+    for (size_t i = 0; i < findKeys.size(); i++)
+        sum += valueOf(t.find(findKeys[i]));
+    Clock::time_point found = Clock::now();
+
+    return nsPerOp(begin, found, findKeys.size());
+}
+
+// Random lookups in a tree built from random keys, with the same tree type
+// searched once without and once with prefetching.
+template <class Plain, class Prefetched>
+void bench(const char * name, const vector<Key> & insertKeys,
+        const vector<Key> & findKeys)
+{
+    long long plainSum = 0;
+    long long prefetchedSum = 0;
+    double plain = timeFind<Plain>(insertKeys, findKeys, plainSum);
+    double prefetched = timeFind<Prefetched>(insertKeys, findKeys, prefetchedSum);
+
+    cout << name
+        << "  find: " << plain << " ns/op"
+        << "  prefetched: " << prefetched << " ns/op"
+        << (plainSum == prefetchedSum ? "" : "  (checksums differ)") << endl;
+}
+
+int main(int argc, char ** argv)
+{
+    size_t size = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000000;
+    size_t finds = argc > 2 ? strtoul(argv[2], NULL, 10) : 2000000;
+
+    vector<Key> insertKeys(size);
+    for (size_t i = 0; i < size; i++)
+        insertKeys[i] = Key(i);
+    shuffle(insertKeys.begin(), insertKeys.end(), mt19937(42));
+
+    vector<Key> findKeys(finds);
+    mt19937 random(7);
+    for (size_t i = 0; i < finds; i++)
+        findKeys[i] = Key(random() % size);
+
+    cout << size << " random integer keys, " << finds << " random finds" << endl;
+
+    bench<BTree<Key, Value, 16>, BTree<Key, Value, 16, PrefetchNodes> >(
+            "BTree<16> ", insertKeys, findKeys);
+    bench<BTree<Key, Value, 64>, BTree<Key, Value, 64, PrefetchNodes> >(
+            "BTree<64> ", insertKeys, findKeys);
+    bench<BinarySearchTree<Key, Value>, BinarySearchTree<Key, Value, PrefetchNodes> >(
+            "BST       ", insertKeys, findKeys);
+    bench<AVLTree<Key, Value>, AVLTree<Key, Value, PrefetchNodes> >(
+            "AVL       ", insertKeys, findKeys);
+    bench<RedBlackTree<Key, Value>, RedBlackTree<Key, Value, PrefetchNodes> >(
+            "red-black ", insertKeys, findKeys);
+
+    return 0;
+}
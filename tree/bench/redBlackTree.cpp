@@ -0,0 +1,104 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+#include <malloc.h>
+
+#include "redBlackTree.h"
+
+using namespace std;
+
+typedef int Key;
+typedef int Value;
+typedef chrono::steady_clock Clock;
+
+static double nsPerOp(Clock::time_point begin, Clock::time_point end, size_t n)
+{
+    return chrono::duration<double, nano>(end - begin).count() / n;
+}
+
+// Heap bytes in use, counting the allocator's own overhead per block.
+static size_t heapBytes()
+{
+    return mallinfo2().uordblks;
+}
+
+static size_t scanned;
+
+// Inserts the keys in the given order, times random finds, selects and
+// ranks, then erases the keys in the same order.
+template <class Tree>
+void bench(const char * name, const vector<Key> & keys, const vector<Key> & findKeys)
+{
+    Tree t;
+
+    size_t before = heapBytes();
+    Clock::time_point begin = Clock::now();
+    for (size_t i = 0; i < keys.size(); i++)
+        t.insert(keys[i], keys[i]);
+    Clock::time_point inserted = Clock::now();
+    size_t after = heapBytes();
+
+    long long sum = 0;
+    for (size_t i = 0; i < findKeys.size(); i++)
+        sum += t.find(findKeys[i])->second;
+    Clock::time_point found = Clock::now();
+
+    // findKeys run from 1 to the size, so each is also a valid rank.
+    for (size_t i = 0; i < findKeys.size(); i++)
+        sum += t.select(findKeys[i] - 1)->first;
+    Clock::time_point selected = Clock::now();
+
+    for (size_t i = 0; i < findKeys.size(); i++)
+        sum += t.rank(findKeys[i]);
+    Clock::time_point ranked = Clock::now();
+
+    // The walk a percentile took before select().
+    scanned = 0;
+    t.inOrder([](typename Tree::node_ptr) { scanned++; });
+    Clock::time_point walked = Clock::now();
+
+    for (size_t i = 0; i < keys.size(); i++)
+        t.erase(keys[i]);
+    Clock::time_point erased = Clock::now();
+
+    cout << name
+        << "  insert: " << nsPerOp(begin, inserted, keys.size()) << " ns/op"
+        << "  find: " << nsPerOp(inserted, found, findKeys.size()) << " ns/op"
+        << "  erase: " << nsPerOp(walked, erased, keys.size()) << " ns/op" << endl
+        << "            select: " << nsPerOp(found, selected, findKeys.size()) << " ns/op"
+        << "  rank: " << nsPerOp(selected, ranked, findKeys.size()) << " ns/op"
+        << "  inOrder walk: " << nsPerOp(ranked, walked, 1) / 1000 << " us" << endl
+        << "            node: " << sizeof(typename Tree::node_type) << " bytes"
+        << "  heap: " << double(after - before) / keys.size() << " bytes/key"
+        << (t.empty() && sum != 0 ? "" : "  (tree not emptied)") << endl;
+}
+
+int main(int argc, char ** argv)
+{
+    size_t size = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    size_t finds = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000000;
+
+    vector<Key> keys(size);
+    for (size_t i = 0; i < size; i++)
+        keys[i] = Key(i + 1);
+
+    vector<Key> findKeys(finds);
+    mt19937 random(7);
+    for (size_t i = 0; i < finds; i++)
+        findKeys[i] = Key(random() % size + 1);
+
+    cout << size << " integer keys, " << finds << " random finds" << endl;
+
+    bench<RedBlackTree<Key, Value> >("sequential", keys, findKeys);
+    bench<RedBlackTree<Key, Value, NoPrefetch, true> >("compact   ", keys, findKeys);
+
+    shuffle(keys.begin(), keys.end(), mt19937(42));
+    bench<RedBlackTree<Key, Value> >("random    ", keys, findKeys);
+    bench<RedBlackTree<Key, Value, NoPrefetch, true> >("compact   ", keys, findKeys);
+
+    return 0;
+}
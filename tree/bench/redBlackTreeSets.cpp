@@ -0,0 +1,119 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+#include "redBlackTree.h"
+#include "forkJoin.h"
+
+using namespace std;
+
+typedef int Key;
+typedef int Value;
+typedef chrono::steady_clock Clock;
+typedef RedBlackTree<Key, Value> Tree;
+
+static double msBetween(Clock::time_point begin, Clock::time_point end)
+{
+    return chrono::duration<double, milli>(end - begin).count();
+}
+
+static void fill(Tree & t, const vector<Key> & keys, size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; i++)
+        t.insert(keys[i], keys[i]);
+}
+
+// Merges a delta of random keys into a big tree: one insert per key, then
+// unionWith alone and on a pool of the given workers. Half of the delta
+// is already in the tree.
+void benchUnion(const vector<Key> & keys, size_t size, size_t delta, size_t workers)
+{
+    double ms[3];
+    size_t sizes[3];
+    ForkJoinPool pool(workers);
+
+    for (int way = 0; way < 3; way++)
+    {
+        Tree t, d;
+        fill(t, keys, 0, size);
+        fill(d, keys, size - delta / 2, size + delta / 2);
+
+        Clock::time_point begin = Clock::now();
+        if (way == 0)
+            fill(t, keys, size - delta / 2, size + delta / 2);
+        else if (way == 1)
+            t.unionWith(d);
+        else
+            t.unionWith(d, pool);
+        ms[way] = msBetween(begin, Clock::now());
+        sizes[way] = t.size();
+    }
+
+    cout << "union " << delta << " into " << size
+        << "  insert: " << ms[0] << " ms"
+        << "  unionWith: " << ms[1] << " ms"
+        << "  with " << workers << " workers: " << ms[2] << " ms"
+        << (sizes[0] == sizes[1] && sizes[1] == sizes[2] ? "" : "  (sizes differ)")
+        << endl;
+}
+
+// Intersection and difference of two trees of the same size that share
+// half of their keys.
+void benchOthers(const vector<Key> & keys, size_t size, size_t workers)
+{
+    ForkJoinPool pool(workers);
+
+    for (int parallel = 0; parallel < 2; parallel++)
+    {
+        Tree a, b;
+        fill(a, keys, 0, size);
+        fill(b, keys, size / 2, size + size / 2);
+
+        Clock::time_point begin = Clock::now();
+        if (parallel)
+            a.intersectWith(b, pool);
+        else
+            a.intersectWith(b);
+        double intersect = msBetween(begin, Clock::now());
+
+        Tree c, d;
+        fill(c, keys, 0, size);
+        fill(d, keys, size / 2, size + size / 2);
+
+        begin = Clock::now();
+        if (parallel)
+            c.differenceWith(d, pool);
+        else
+            c.differenceWith(d);
+        double difference = msBetween(begin, Clock::now());
+
+        cout << (parallel ? "with workers " : "alone        ") << size << " and " << size
+            << "  intersectWith: " << intersect << " ms (" << a.size() << " left)"
+            << "  differenceWith: " << difference << " ms (" << c.size() << " left)"
+            << endl;
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    size_t size = argc > 1 ? strtoul(argv[1], NULL, 10) : 4000000;
+    size_t delta = argc > 2 ? strtoul(argv[2], NULL, 10) : 400000;
+    size_t workers = argc > 3 ? strtoul(argv[3], NULL, 10) : thread::hardware_concurrency();
+
+    vector<Key> keys(size + max(size, delta));
+    for (size_t i = 0; i < keys.size(); i++)
+        keys[i] = Key(i);
+    shuffle(keys.begin(), keys.end(), mt19937(42));
+
+    cout << size << " random integer keys, " << workers << " workers" << endl;
+
+    benchUnion(keys, size, delta, workers);
+    benchUnion(keys, size, delta / 100, workers);
+    benchOthers(keys, size / 4, workers);
+
+    return 0;
+}
@@ -0,0 +1,142 @@
+#include <iostream>
+#include <cstdlib>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+#include "bTree.h"
+#include "snapshotBTree.h"
+
+using namespace std;
+
+const size_t N = 64;
+
+typedef int Key;
+typedef int Value;
+typedef chrono::steady_clock Clock;
+
+const size_t WRITES = 2000000;
+
+// A new snapshot is handed to the reader after this many writes.
+const size_t PUBLISH_EVERY = 10000;
+
+static thread_local long long scanSum;
+
+// The plain tree: a scan holds the lock, so the writer waits for it.
+struct LockedBTree
+{
+    BTree<Key, Value, N> tree;
+    mutex lock;
+
+    void write(const Key & key)
+    {
+        lock_guard<mutex> guard(lock);
+        if (tree.find(key) == NULL)
+            tree.insert(key, key);
+        else
+            tree.erase(key);
+    }
+
+    void publish()
+    {
+
+    }
+
+    void scan()
+    {
+        lock_guard<mutex> guard(lock);
+        tree.inOrder([](const Key & key, Value & value){scanSum += value;});
+    }
+};
+
+// The reader scans the latest published snapshot without any lock held.
+struct SnapshotTree
+{
+    typedef SnapshotBTree<Key, Value, N> tree_type;
+
+    tree_type tree;
+    tree_type::Snapshot latest;
+    mutex lock;
+
+    void write(const Key & key)
+    {
+        if (tree.find(key) == NULL)
+            tree.insert(key, key);
+        else
+            tree.erase(key);
+    }
+
+    void publish()
+    {
+        tree_type::Snapshot s = tree.snapshot();
+        lock_guard<mutex> guard(lock);
+        latest = s;
+    }
+
+    void scan()
+    {
+        tree_type::Snapshot s;
+        {
+            lock_guard<mutex> guard(lock);
+            s = latest;
+        }
+        s.inOrder([](const Key & key, const Value & value){scanSum += value;});
+    }
+};
+
+// One writer toggles random keys in [0, 2 * size) while, if scanning, a
+// reader thread keeps running full in-order scans.
+template <class Tree>
+void bench(const char * name, size_t size, bool scanning)
+{
+    Tree t;
+    for (size_t i = 0; i < 2 * size; i += 2)
+        t.write(Key(i));
+    t.publish();
+
+    atomic<bool> done(false);
+    size_t scans = 0;
+    thread reader([&]() {
+        while (scanning && !done.load())
+        {
+            t.scan();
+            scans++;
+        }
+    });
+
+    unsigned seed = 1;
+    Clock::time_point begin = Clock::now();
+    for (size_t i = 0; i < WRITES; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        t.write(Key((seed >> 4) % (2 * size)));
+
+        if (i % PUBLISH_EVERY == 0)
+            t.publish();
+    }
+    Clock::time_point end = Clock::now();
+
+    done = true;
+    reader.join();
+
+    double seconds = chrono::duration<double>(end - begin).count();
+
+    cout << name << (scanning ? "  scanning" : "  alone   ")
+        << "  writes: " << WRITES / seconds / 1e6 << " Mops/s"
+        << "  scans: " << scans << endl;
+}
+
+int main(int argc, char ** argv)
+{
+    size_t size = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+
+    cout << size << " keys, one writer, one scanning reader" << endl;
+
+    bench<LockedBTree>("mutex   ", size, false);
+    bench<LockedBTree>("mutex   ", size, true);
+    bench<SnapshotTree>("snapshot", size, false);
+    bench<SnapshotTree>("snapshot", size, true);
+
+    return 0;
+}
@@ -4,8 +4,13 @@
 #include <cstddef>
 #include <utility>
 #include <list>
+#include <vector>
 
-template <class K, class V>
+#include "prefetch.h"
+#include "eytzinger.h"
+#include "treeIterator.h"
+
+template <class K, class V, class Prefetch = NoPrefetch>
 class BinarySearchTree
 {
 public:
@@ -24,6 +29,9 @@ public:
 
         Node(const elem_type & element, Node * leftChild, Node * rightChild)
             : element(element), leftChild(leftChild), rightChild(rightChild) {}
+
+        Node * left() const { return leftChild; }
+        Node * right() const { return rightChild; }
     };
 
 public:
@@ -38,6 +46,8 @@ public:
 
     typedef typename node_type::size_type size_type;
 
+    typedef BinaryTreeIterator<node_type> iterator;
+
 public:
 
     BinarySearchTree();
@@ -52,6 +62,16 @@ public:
 
     elem_ptr find(const K &) const;
 
+    iterator begin() const;
+
+    iterator end() const;
+
+    iterator lower_bound(const K &) const;
+
+    iterator upper_bound(const K &) const;
+
+    std::pair<iterator, iterator> equal_range(const K &) const;
+
     void insert(const K &, const V &);
 
     void erase(const K &);
@@ -64,6 +84,8 @@ public:
 
     void levelOrder(void (*) (node_ptr));
 
+    EytzingerIndex<K, V> freeze() const;
+
 protected:
 
     void findParent(const K &, node_ptr &, node_ptr &);
@@ -84,6 +106,8 @@ protected:
 
     static void postOrderRecursion(node_ptr, void (*) (node_ptr));
 
+    static void freezeRecursion(node_ptr, std::vector<std::pair<K, V> > &);
+
 protected:
 
     node_ptr mRoot;
@@ -92,46 +116,51 @@ protected:
 };
 
 
-template <class K, class V>
-BinarySearchTree<K, V>::BinarySearchTree()
+template <class K, class V, class Prefetch>
+BinarySearchTree<K, V, Prefetch>::BinarySearchTree()
     : mRoot(NULL), mTreeSize(0)
 {
 
 }
 
-template <class K, class V>
-BinarySearchTree<K, V>::~BinarySearchTree()
+template <class K, class V, class Prefetch>
+BinarySearchTree<K, V, Prefetch>::~BinarySearchTree()
 {
     clear();
 }
 
-template <class K, class V>
-typename BinarySearchTree<K, V>::size_type
-BinarySearchTree<K, V>::height() const
+template <class K, class V, class Prefetch>
+typename BinarySearchTree<K, V, Prefetch>::size_type
+BinarySearchTree<K, V, Prefetch>::height() const
 {
     return heightRecursion(this->mRoot);
 }
 
-template <class K, class V>
-bool BinarySearchTree<K, V>::empty() const
+template <class K, class V, class Prefetch>
+bool BinarySearchTree<K, V, Prefetch>::empty() const
 {
     return mTreeSize == 0;
 }
 
-template <class K, class V>
-void BinarySearchTree<K, V>::clear()
+template <class K, class V, class Prefetch>
+void BinarySearchTree<K, V, Prefetch>::clear()
 {
     postOrder([](node_ptr t){delete t;});
 }
 
-template <class K, class V>
-typename BinarySearchTree<K, V>::elem_ptr
-BinarySearchTree<K, V>::find(const K & key) const
+template <class K, class V, class Prefetch>
+typename BinarySearchTree<K, V, Prefetch>::elem_ptr
+BinarySearchTree<K, V, Prefetch>::find(const K & key) const
 {
     node_ptr p = this->mRoot;
 
     while (p != NULL)
     {
+        // Both children are known as soon as p arrives; request them
+        // before the comparison picks one.
+        Prefetch::range(p->leftChild, sizeof(node_type));
+        Prefetch::range(p->rightChild, sizeof(node_type));
+
         if (key < p->element.first)
             p = p->leftChild;
         else if (key > p->element.first)
@@ -143,8 +172,48 @@ BinarySearchTree<K, V>::find(const K & key) const
     return NULL;
 }
 
-template <class K, class V>
-void BinarySearchTree<K, V>::insert(const K & key, const V & value)
+template <class K, class V, class Prefetch>
+typename BinarySearchTree<K, V, Prefetch>::iterator
+BinarySearchTree<K, V, Prefetch>::begin() const
+{
+    return iterator::first(&mRoot);
+}
+
+template <class K, class V, class Prefetch>
+typename BinarySearchTree<K, V, Prefetch>::iterator
+BinarySearchTree<K, V, Prefetch>::end() const
+{
+    return iterator(&mRoot);
+}
+
+template <class K, class V, class Prefetch>
+typename BinarySearchTree<K, V, Prefetch>::iterator
+BinarySearchTree<K, V, Prefetch>::lower_bound(const K & key) const
+{
+    return iterator::lowerBound(&mRoot, key);
+}
+
+template <class K, class V, class Prefetch>
+typename BinarySearchTree<K, V, Prefetch>::iterator
+BinarySearchTree<K, V, Prefetch>::upper_bound(const K & key) const
+{
+    return iterator::upperBound(&mRoot, key);
+}
+
+template <class K, class V, class Prefetch>
+std::pair<typename BinarySearchTree<K, V, Prefetch>::iterator, typename BinarySearchTree<K, V, Prefetch>::iterator>
+BinarySearchTree<K, V, Prefetch>::equal_range(const K & key) const
+{
+    iterator first = lower_bound(key);
+    iterator last = first;
+    if (first != end() && !(key < first->first))
+        ++last;
+
+    return std::make_pair(first, last);
+}
+
+template <class K, class V, class Prefetch>
+void BinarySearchTree<K, V, Prefetch>::insert(const K & key, const V & value)
 {
     node_ptr p = this->mRoot, q = NULL;
 
@@ -167,8 +236,8 @@ void BinarySearchTree<K, V>::insert(const K & key, const V & value)
     }
 }
 
-template <class K, class V>
-void BinarySearchTree<K, V>::erase(const K & key)
+template <class K, class V, class Prefetch>
+void BinarySearchTree<K, V, Prefetch>::erase(const K & key)
 {
     node_ptr t = this->mRoot, parent_t = NULL;
 
@@ -196,26 +265,26 @@ void BinarySearchTree<K, V>::erase(const K & key)
     eraseWithOneChild(t, parent_t);
 }
 
-template <class K, class V>
-void BinarySearchTree<K, V>::preOrder(void (* visit) (node_ptr))
+template <class K, class V, class Prefetch>
+void BinarySearchTree<K, V, Prefetch>::preOrder(void (* visit) (node_ptr))
 {
     preOrderRecursion(this->mRoot, visit);
 }
 
-template <class K, class V>
-void BinarySearchTree<K, V>::inOrder(void (* visit) (node_ptr))
+template <class K, class V, class Prefetch>
+void BinarySearchTree<K, V, Prefetch>::inOrder(void (* visit) (node_ptr))
 {
     inOrderRecursion(this->mRoot, visit);
 }
 
-template <class K, class V>
-void BinarySearchTree<K, V>::postOrder(void (* visit) (node_ptr))
+template <class K, class V, class Prefetch>
+void BinarySearchTree<K, V, Prefetch>::postOrder(void (* visit) (node_ptr))
 {
     postOrderRecursion(this->mRoot, visit);
 }
 
-template <class K, class V>
-void BinarySearchTree<K, V>::levelOrder(void (* visit) (node_ptr))
+template <class K, class V, class Prefetch>
+void BinarySearchTree<K, V, Prefetch>::levelOrder(void (* visit) (node_ptr))
 {    
     std::list<node_ptr> l;
     node_ptr t = this->mRoot;
@@ -237,8 +306,20 @@ void BinarySearchTree<K, V>::levelOrder(void (* visit) (node_ptr))
     }
 }
 
-template <class K, class V>
-void BinarySearchTree<K, V>::findParent(
+// Copies the elements into a read-only index for faster searches; later
+// changes to the tree do not reach it.
+template <class K, class V, class Prefetch>
+EytzingerIndex<K, V> BinarySearchTree<K, V, Prefetch>::freeze() const
+{
+    std::vector<std::pair<K, V> > elements;
+    elements.reserve(this->mTreeSize);
+    freezeRecursion(this->mRoot, elements);
+
+    return EytzingerIndex<K, V>(elements.begin(), elements.end());
+}
+
+template <class K, class V, class Prefetch>
+void BinarySearchTree<K, V, Prefetch>::findParent(
     const K & key,
     node_ptr & result,
     node_ptr & parent)
@@ -256,9 +337,9 @@ void BinarySearchTree<K, V>::findParent(
     }
 }
 
-template <class K, class V>
-typename BinarySearchTree<K, V>::node_ptr
-BinarySearchTree<K, V>::replaceElement(
+template <class K, class V, class Prefetch>
+typename BinarySearchTree<K, V, Prefetch>::node_ptr
+BinarySearchTree<K, V, Prefetch>::replaceElement(
     node_ptr t,
     node_ptr parent,
     const elem_type & element)
@@ -275,10 +356,10 @@ BinarySearchTree<K, V>::replaceElement(
     return p;
 }
 
-template <class K, class V>
-void BinarySearchTree<K, V>::eraseWithOneChild(
-    BinarySearchTree<K, V>::node_ptr t,
-    BinarySearchTree<K, V>::node_ptr parent)
+template <class K, class V, class Prefetch>
+void BinarySearchTree<K, V, Prefetch>::eraseWithOneChild(
+    BinarySearchTree<K, V, Prefetch>::node_ptr t,
+    BinarySearchTree<K, V, Prefetch>::node_ptr parent)
 {
     node_ptr p = t->leftChild != NULL ? t->leftChild : t->rightChild;
 
@@ -296,9 +377,9 @@ void BinarySearchTree<K, V>::eraseWithOneChild(
     delete t;
 }
 
-template <class K, class V>
-typename BinarySearchTree<K, V>::size_type
-BinarySearchTree<K, V>::heightRecursion(node_ptr t)
+template <class K, class V, class Prefetch>
+typename BinarySearchTree<K, V, Prefetch>::size_type
+BinarySearchTree<K, V, Prefetch>::heightRecursion(node_ptr t)
 {    
     if (t == NULL)
         return 0;
@@ -309,11 +390,11 @@ BinarySearchTree<K, V>::heightRecursion(node_ptr t)
 
 }
 
-template <class K, class V>
-typename BinarySearchTree<K, V>::node_ptr
-BinarySearchTree<K, V>::findLargest(
-    BinarySearchTree<K, V>::node_ptr t,
-    BinarySearchTree<K, V>::node_ptr & parent)
+template <class K, class V, class Prefetch>
+typename BinarySearchTree<K, V, Prefetch>::node_ptr
+BinarySearchTree<K, V, Prefetch>::findLargest(
+    BinarySearchTree<K, V, Prefetch>::node_ptr t,
+    BinarySearchTree<K, V, Prefetch>::node_ptr & parent)
 {
     while (t->rightChild != NULL)
     {
@@ -324,11 +405,11 @@ BinarySearchTree<K, V>::findLargest(
     return t;
 }
 
-template <class K, class V>
-typename BinarySearchTree<K, V>::node_ptr
-BinarySearchTree<K, V>::findSmallest(
-    BinarySearchTree<K, V>::node_ptr t,
-    BinarySearchTree<K, V>::node_ptr & parent)
+template <class K, class V, class Prefetch>
+typename BinarySearchTree<K, V, Prefetch>::node_ptr
+BinarySearchTree<K, V, Prefetch>::findSmallest(
+    BinarySearchTree<K, V, Prefetch>::node_ptr t,
+    BinarySearchTree<K, V, Prefetch>::node_ptr & parent)
 {
     while (t->leftChild != NULL)
     {
@@ -339,8 +420,8 @@ BinarySearchTree<K, V>::findSmallest(
     return t;
 }
 
-template <class K, class V>
-void BinarySearchTree<K, V>::preOrderRecursion(
+template <class K, class V, class Prefetch>
+void BinarySearchTree<K, V, Prefetch>::preOrderRecursion(
         node_ptr t,
         void (* visit) (node_ptr))
 {
@@ -352,8 +433,8 @@ void BinarySearchTree<K, V>::preOrderRecursion(
     }
 }
 
-template <class K, class V>
-void BinarySearchTree<K, V>::inOrderRecursion(
+template <class K, class V, class Prefetch>
+void BinarySearchTree<K, V, Prefetch>::inOrderRecursion(
         node_ptr t,
         void (* visit) (node_ptr))
 {
@@ -365,8 +446,8 @@ void BinarySearchTree<K, V>::inOrderRecursion(
     }
 }
 
-template <class K, class V>
-void BinarySearchTree<K, V>::postOrderRecursion(
+template <class K, class V, class Prefetch>
+void BinarySearchTree<K, V, Prefetch>::postOrderRecursion(
         node_ptr t,
         void (* visit) (node_ptr))
 {
@@ -378,5 +459,17 @@ void BinarySearchTree<K, V>::postOrderRecursion(
     }
 }
 
+template <class K, class V, class Prefetch>
+void BinarySearchTree<K, V, Prefetch>::freezeRecursion(node_ptr t,
+        std::vector<std::pair<K, V> > & elements)
+{
+    if (t != NULL)
+    {
+        freezeRecursion(t->leftChild, elements);
+        elements.push_back(t->element);
+        freezeRecursion(t->rightChild, elements);
+    }
+}
+
 
 #endif//__BINARY_SEARCH_TREE_H__
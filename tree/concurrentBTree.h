@@ -0,0 +1,831 @@
+#ifndef __CONCURRENT_B_TREE_H__
+#define __CONCURRENT_B_TREE_H__
+
+#include <atomic>
+#include <thread>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <type_traits>
+
+#include "epoch.h"
+
+// Concurrent B+ tree with optimistic lock coupling.
+//
+// Every node carries a version word: bit 0 marks a node that has been
+// unlinked, bit 1 is the write lock and the remaining bits count the writes.
+// Readers never write shared memory: they remember the version of a node,
+// read it, and restart if the version changed meanwhile. Writers descend the
+// same way and only lock the nodes they modify, by upgrading the version
+// they read with a compare-and-swap. Full nodes are split and minimal nodes
+// refilled on the way down, so a writer never has to go back up the tree.
+//
+// Readers may see a node while it is written, so every node field a reader
+// touches is an atomic (see Shared below), and keys and values must be
+// trivially copyable. Unlinked nodes are reclaimed through an EpochManager.
+template <class K, class V, size_t N>
+class ConcurrentBTree
+{
+    static_assert(N >= 4, "ConcurrentBTree needs N >= 4");
+    static_assert(std::is_trivially_copyable<K>::value &&
+            std::is_trivially_copyable<V>::value,
+            "ConcurrentBTree keys and values must be trivially copyable");
+
+public:
+
+    // A node field that optimistic readers load while writers may store
+    // it. Sizes, keys and values use relaxed accesses, which compile to
+    // plain moves; the version check afterwards tells the reader whether
+    // what it loaded was consistent. Child pointers are stored with release
+    // and loaded with acquire, so a reader following a new pointer also
+    // sees the initialisation of the node behind it.
+    template <class T, std::memory_order Load = std::memory_order_relaxed,
+             std::memory_order Store = std::memory_order_relaxed>
+    struct Shared
+    {
+        std::atomic<T> value;
+
+        Shared()
+            : value() {}
+
+        Shared(T initial)
+            : value(initial) {}
+
+        T load() const
+        {
+            return value.load(Load);
+        }
+
+        operator T () const
+        {
+            return load();
+        }
+
+        Shared & operator = (T other)
+        {
+            value.store(other, Store);
+            return *this;
+        }
+
+        Shared & operator = (const Shared & other)
+        {
+            return *this = other.load();
+        }
+
+        // Only writers holding the node's lock change sizes, so these need
+        // no read-modify-write.
+        Shared & operator ++ ()
+        {
+            return *this = load() + 1;
+        }
+
+        Shared & operator -- ()
+        {
+            return *this = load() - 1;
+        }
+    };
+
+    struct Node
+    {
+        typedef size_t size_type;
+
+        std::atomic<uint64_t> version;
+        bool leaf;
+        Shared<size_type> size;
+        Shared<K> keys[N - 1];
+
+        Node(bool leaf)
+            : version(0), leaf(leaf), size(0) {}
+    };
+
+    struct InnerNode : Node
+    {
+        Shared<Node *, std::memory_order_acquire, std::memory_order_release>
+            children[N];
+
+        InnerNode()
+            : Node(false) {}
+    };
+
+    struct LeafNode : Node
+    {
+        Shared<V> values[N - 1];
+
+        LeafNode()
+            : Node(true) {}
+    };
+
+    typedef Node node_type;
+    typedef node_type* node_ptr;
+    typedef InnerNode* inner_ptr;
+    typedef LeafNode* leaf_ptr;
+    typedef K key_type;
+    typedef V value_type;
+    typedef typename node_type::size_type size_type;
+
+    struct KeyChild
+    {
+        K key;
+        node_ptr node;
+    };
+
+public:
+
+    ConcurrentBTree();
+
+    ~ConcurrentBTree();
+
+    size_type size() const;
+
+    size_type height() const;
+
+    bool empty() const;
+
+    bool find(const K &, V &) const;
+
+    void insert(const K &, const V &);
+
+    void erase(const K &);
+
+private:
+
+    static const size_t MIN_NUM = (N - 2) / 2;
+
+    bool tryFind(const K &, V &, bool &) const;
+
+    bool tryInsert(const K &, const V &, bool &);
+
+    bool tryErase(const K &, bool &);
+
+    bool lockRoot(node_ptr &, uint64_t &) const;
+
+    static bool readLock(node_ptr, uint64_t &);
+
+    static bool validate(node_ptr, uint64_t);
+
+    static bool upgradeLock(node_ptr, uint64_t);
+
+    static bool tryWriteLock(node_ptr);
+
+    static void writeUnlock(node_ptr);
+
+    static void writeUnlockObsolete(node_ptr);
+
+    static size_t searchNode(node_ptr, const K &);
+
+    static size_t childIndex(node_ptr, const K &);
+
+    static KeyChild splitNode(node_ptr);
+
+    static void insertToInner(inner_ptr, node_ptr, const KeyChild &);
+
+    static node_ptr repairNode(inner_ptr, size_t, node_ptr);
+
+    static void borrowFromLeftBro(inner_ptr, size_t);
+
+    static void borrowFromRightBro(inner_ptr, size_t);
+
+    static void mergeNodes(inner_ptr, size_t);
+
+    void retireNode(node_ptr);
+
+    static void deleteNode(void *);
+
+    static void clearRecursion(node_ptr);
+
+protected:
+
+    std::atomic<node_ptr> mRoot;
+
+    std::atomic<size_type> mTreeSize;
+
+    mutable EpochManager mEpoch;
+
+};
+
+template <class K, class V, size_t N>
+ConcurrentBTree<K, V, N>::ConcurrentBTree()
+    : mRoot(new LeafNode()), mTreeSize(0)
+{
+
+}
+
+template <class K, class V, size_t N>
+ConcurrentBTree<K, V, N>::~ConcurrentBTree()
+{
+    clearRecursion(mRoot.load());
+}
+
+template <class K, class V, size_t N>
+typename ConcurrentBTree<K, V, N>::size_type
+ConcurrentBTree<K, V, N>::size() const
+{
+    return mTreeSize.load(std::memory_order_relaxed);
+}
+
+// Only exact while no writer is active.
+template <class K, class V, size_t N>
+typename ConcurrentBTree<K, V, N>::size_type
+ConcurrentBTree<K, V, N>::height() const
+{
+    EpochManager::Guard guard(mEpoch);
+
+    size_type result = 1;
+    for (node_ptr t = mRoot.load(); !t->leaf; result++)
+        t = static_cast<inner_ptr>(t)->children[0];
+
+    return result;
+}
+
+template <class K, class V, size_t N>
+bool ConcurrentBTree<K, V, N>::empty() const
+{
+    return size() == 0;
+}
+
+template <class K, class V, size_t N>
+bool ConcurrentBTree<K, V, N>::find(const K & key, V & value) const
+{
+    EpochManager::Guard guard(mEpoch);
+
+    bool found = false;
+    while (!tryFind(key, value, found))
+        ;
+
+    return found;
+}
+
+template <class K, class V, size_t N>
+void ConcurrentBTree<K, V, N>::insert(const K & key, const V & value)
+{
+    EpochManager::Guard guard(mEpoch);
+
+    bool inserted = false;
+    while (!tryInsert(key, value, inserted))
+        ;
+
+    if (inserted)
+        mTreeSize.fetch_add(1, std::memory_order_relaxed);
+}
+
+template <class K, class V, size_t N>
+void ConcurrentBTree<K, V, N>::erase(const K & key)
+{
+    EpochManager::Guard guard(mEpoch);
+
+    bool erased = false;
+    while (!tryErase(key, erased))
+        ;
+
+    if (erased)
+        mTreeSize.fetch_sub(1, std::memory_order_relaxed);
+}
+
+// Each try* walks down once and returns false if it has to restart.
+
+template <class K, class V, size_t N>
+bool ConcurrentBTree<K, V, N>::tryFind(const K & key, V & value, bool & found) const
+{
+    node_ptr t;
+    uint64_t version;
+
+    if (!lockRoot(t, version))
+        return false;
+
+    while (!t->leaf)
+    {
+        node_ptr child = static_cast<inner_ptr>(t)->children[childIndex(t, key)];
+        uint64_t childVersion;
+
+        if (!validate(t, version) || !readLock(child, childVersion) ||
+                !validate(t, version))
+            return false;
+
+        t = child;
+        version = childVersion;
+    }
+
+    leaf_ptr leaf = static_cast<leaf_ptr>(t);
+    size_t index = searchNode(leaf, key);
+
+    found = index < std::min<size_t>(leaf->size, N - 1) &&
+            leaf->keys[index].load() == key;
+    if (found)
+        value = leaf->values[index];
+
+    return validate(leaf, version);
+}
+
+template <class K, class V, size_t N>
+bool ConcurrentBTree<K, V, N>::tryInsert(const K & key, const V & value,
+        bool & inserted)
+{
+    node_ptr parent = NULL, t;
+    uint64_t parentVersion = 0, version;
+
+    if (!lockRoot(t, version))
+        return false;
+
+    for (;;)
+    {
+        if (t->size == N - 1)
+        {
+            if (parent != NULL && !upgradeLock(parent, parentVersion))
+                return false;
+
+            if (!upgradeLock(t, version))
+            {
+                if (parent != NULL)
+                    writeUnlock(parent);
+                return false;
+            }
+
+            KeyChild result = splitNode(t);
+
+            if (parent != NULL)
+                insertToInner(static_cast<inner_ptr>(parent), t, result);
+            else
+            {
+                inner_ptr newRoot = new InnerNode();
+                newRoot->keys[0] = result.key;
+                newRoot->children[0] = t;
+                newRoot->children[1] = result.node;
+                newRoot->size = 1;
+                mRoot.store(newRoot);
+            }
+
+            writeUnlock(t);
+            if (parent != NULL)
+                writeUnlock(parent);
+
+            return false;
+        }
+
+        if (t->leaf)
+        {
+            if (!upgradeLock(t, version))
+                return false;
+
+            leaf_ptr leaf = static_cast<leaf_ptr>(t);
+            size_t index = searchNode(leaf, key);
+
+            if (index < leaf->size && leaf->keys[index].load() == key)
+                leaf->values[index] = value;
+            else
+            {
+                for (size_t i = leaf->size; i > index; i--)
+                {
+                    leaf->keys[i] = leaf->keys[i - 1];
+                    leaf->values[i] = leaf->values[i - 1];
+                }
+
+                leaf->keys[index] = key;
+                leaf->values[index] = value;
+                ++leaf->size;
+                inserted = true;
+            }
+
+            writeUnlock(leaf);
+            return true;
+        }
+
+        node_ptr child = static_cast<inner_ptr>(t)->children[childIndex(t, key)];
+        uint64_t childVersion;
+
+        if (!validate(t, version) || !readLock(child, childVersion) ||
+                !validate(t, version))
+            return false;
+
+        parent = t;
+        parentVersion = version;
+        t = child;
+        version = childVersion;
+    }
+}
+
+template <class K, class V, size_t N>
+bool ConcurrentBTree<K, V, N>::tryErase(const K & key, bool & erased)
+{
+    node_ptr t;
+    uint64_t version;
+
+    if (!lockRoot(t, version))
+        return false;
+
+    while (!t->leaf)
+    {
+        inner_ptr inner = static_cast<inner_ptr>(t);
+        size_t index = childIndex(inner, key);
+        node_ptr child = inner->children[index];
+        uint64_t childVersion;
+
+        if (!validate(t, version) || !readLock(child, childVersion) ||
+                !validate(t, version))
+            return false;
+
+        if (child->size > MIN_NUM)
+        {
+            t = child;
+            version = childVersion;
+            continue;
+        }
+
+        // The child could underflow: refill it from a brother first.
+        if (!upgradeLock(t, version))
+            return false;
+
+        if (!upgradeLock(child, childVersion))
+        {
+            writeUnlock(t);
+            return false;
+        }
+
+        node_ptr brother = index > 0 ? inner->children[index - 1] :
+            inner->children[index + 1];
+
+        if (!tryWriteLock(brother))
+        {
+            writeUnlock(child);
+            writeUnlock(t);
+            return false;
+        }
+
+        node_ptr dropped = repairNode(inner, index, brother);
+
+        if (dropped != NULL)
+        {
+            node_ptr kept = dropped == child ? brother : child;
+
+            writeUnlock(kept);
+            writeUnlockObsolete(dropped);
+            retireNode(dropped);
+
+            if (inner->size == 0)
+            {
+                mRoot.store(kept);
+                writeUnlockObsolete(inner);
+                retireNode(inner);
+                return false;
+            }
+        }
+        else
+        {
+            writeUnlock(child);
+            writeUnlock(brother);
+        }
+
+        writeUnlock(t);
+        return false;
+    }
+
+    if (!upgradeLock(t, version))
+        return false;
+
+    leaf_ptr leaf = static_cast<leaf_ptr>(t);
+    size_t index = searchNode(leaf, key);
+
+    if (index < leaf->size && leaf->keys[index].load() == key)
+    {
+        while (++index < leaf->size)
+        {
+            leaf->keys[index - 1] = leaf->keys[index];
+            leaf->values[index - 1] = leaf->values[index];
+        }
+        --leaf->size;
+        erased = true;
+    }
+
+    writeUnlock(leaf);
+    return true;
+}
+
+template <class K, class V, size_t N>
+bool ConcurrentBTree<K, V, N>::lockRoot(node_ptr & t, uint64_t & version) const
+{
+    t = mRoot.load();
+
+    // The root may be replaced between loading and locking it.
+    return readLock(t, version) && t == mRoot.load();
+}
+
+template <class K, class V, size_t N>
+bool ConcurrentBTree<K, V, N>::readLock(node_ptr t, uint64_t & version)
+{
+    version = t->version.load(std::memory_order_acquire);
+    while (version & 2)
+    {
+        std::this_thread::yield();
+        version = t->version.load(std::memory_order_acquire);
+    }
+
+    return (version & 1) == 0;
+}
+
+template <class K, class V, size_t N>
+bool ConcurrentBTree<K, V, N>::validate(node_ptr t, uint64_t version)
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return t->version.load(std::memory_order_relaxed) == version;
+}
+
+template <class K, class V, size_t N>
+bool ConcurrentBTree<K, V, N>::upgradeLock(node_ptr t, uint64_t version)
+{
+    return t->version.compare_exchange_strong(version, version + 2);
+}
+
+template <class K, class V, size_t N>
+bool ConcurrentBTree<K, V, N>::tryWriteLock(node_ptr t)
+{
+    uint64_t version = t->version.load();
+
+    return (version & 3) == 0 && upgradeLock(t, version);
+}
+
+template <class K, class V, size_t N>
+void ConcurrentBTree<K, V, N>::writeUnlock(node_ptr t)
+{
+    t->version.fetch_add(2, std::memory_order_release);
+}
+
+template <class K, class V, size_t N>
+void ConcurrentBTree<K, V, N>::writeUnlockObsolete(node_ptr t)
+{
+    t->version.fetch_add(3, std::memory_order_release);
+}
+
+template <class K, class V, size_t N>
+size_t ConcurrentBTree<K, V, N>::searchNode(node_ptr t, const K & key)
+{
+    // An optimistic reader may see any size; keep the search inside the
+    // node. The keys are atomics, which rules out the vector search, so
+    // this is a branchless binary search: a handful of relaxed loads and
+    // no mispredicted branches.
+    size_t size = std::min<size_t>(t->size, N - 1);
+    size_t first = 0;
+    while (size > 1)
+    {
+        size_t half = size / 2;
+        first = t->keys[first + half - 1].load() < key ? first + half : first;
+        size -= half;
+    }
+
+    return first + (size == 1 && t->keys[first].load() < key);
+}
+
+template <class K, class V, size_t N>
+size_t ConcurrentBTree<K, V, N>::childIndex(node_ptr t, const K & key)
+{
+    size_t index = searchNode(t, key);
+
+    if (index < std::min<size_t>(t->size, N - 1) && t->keys[index].load() == key)
+        index++;
+
+    return index;
+}
+
+template <class K, class V, size_t N>
+typename ConcurrentBTree<K, V, N>::KeyChild
+ConcurrentBTree<K, V, N>::splitNode(node_ptr t)
+{
+    size_t d = (N - 1) / 2;
+    KeyChild result;
+
+    if (t->leaf)
+    {
+        leaf_ptr leaf = static_cast<leaf_ptr>(t);
+        leaf_ptr newLeaf = new LeafNode();
+
+        for (size_t index = d; index < N - 1; index++)
+        {
+            newLeaf->keys[index - d] = leaf->keys[index];
+            newLeaf->values[index - d] = leaf->values[index];
+        }
+        newLeaf->size = N - 1 - d;
+
+        result.key = newLeaf->keys[0];
+        result.node = newLeaf;
+    }
+    else
+    {
+        inner_ptr inner = static_cast<inner_ptr>(t);
+        inner_ptr newNode = new InnerNode();
+
+        for (size_t index = d + 1; index < N - 1; index++)
+        {
+            newNode->keys[index - d - 1] = inner->keys[index];
+            newNode->children[index - d - 1] = inner->children[index];
+        }
+        newNode->children[N - 2 - d] = inner->children[N - 1];
+        newNode->size = N - 2 - d;
+
+        result.key = inner->keys[d];
+        result.node = newNode;
+    }
+
+    t->size = d;
+    return result;
+}
+
+template <class K, class V, size_t N>
+void ConcurrentBTree<K, V, N>::insertToInner(inner_ptr t, node_ptr left,
+        const KeyChild & keyChild)
+{
+    size_t position = 0;
+    while (t->children[position] != left)
+        position++;
+
+    for (size_t index = t->size; index > position; index--)
+    {
+        t->keys[index] = t->keys[index - 1];
+        t->children[index + 1] = t->children[index];
+    }
+
+    t->keys[position] = keyChild.key;
+    t->children[position + 1] = keyChild.node;
+    ++t->size;
+}
+
+// Refills t->children[index] from the write locked brother. Returns the
+// node merged away, or NULL if a key was borrowed.
+template <class K, class V, size_t N>
+typename ConcurrentBTree<K, V, N>::node_ptr
+ConcurrentBTree<K, V, N>::repairNode(inner_ptr t, size_t index, node_ptr brother)
+{
+    if (brother->size > MIN_NUM)
+    {
+        if (index > 0)
+            borrowFromLeftBro(t, index);
+        else
+            borrowFromRightBro(t, index);
+
+        return NULL;
+    }
+
+    node_ptr dropped = index > 0 ? t->children[index] : t->children[index + 1];
+    mergeNodes(t, index > 0 ? index - 1 : index);
+
+    return dropped;
+}
+
+template <class K, class V, size_t N>
+void ConcurrentBTree<K, V, N>::borrowFromLeftBro(inner_ptr t, size_t index)
+{
+    node_ptr x = t->children[index];
+    node_ptr left = t->children[index - 1];
+
+    size_t indexL = left->size;
+    size_t indexX = x->size;
+
+    if (x->leaf)
+    {
+        leaf_ptr xl = static_cast<leaf_ptr>(x);
+        leaf_ptr ll = static_cast<leaf_ptr>(left);
+
+        for (; indexX > 0; indexX--)
+        {
+            xl->keys[indexX] = xl->keys[indexX - 1];
+            xl->values[indexX] = xl->values[indexX - 1];
+        }
+
+        xl->keys[0] = ll->keys[indexL - 1];
+        xl->values[0] = ll->values[indexL - 1];
+        t->keys[index - 1] = xl->keys[0];
+    }
+    else
+    {
+        inner_ptr xi = static_cast<inner_ptr>(x);
+        inner_ptr li = static_cast<inner_ptr>(left);
+
+        xi->children[indexX + 1] = xi->children[indexX];
+        for (; indexX > 0; indexX--)
+        {
+            xi->keys[indexX] = xi->keys[indexX - 1];
+            xi->children[indexX] = xi->children[indexX - 1];
+        }
+
+        xi->keys[0] = t->keys[index - 1];
+        xi->children[0] = li->children[indexL];
+        t->keys[index - 1] = li->keys[indexL - 1];
+    }
+
+    --left->size;
+    ++x->size;
+}
+
+template <class K, class V, size_t N>
+void ConcurrentBTree<K, V, N>::borrowFromRightBro(inner_ptr t, size_t index)
+{
+    node_ptr x = t->children[index];
+    node_ptr right = t->children[index + 1];
+
+    size_t indexR = 1;
+    size_t indexX = x->size;
+
+    if (x->leaf)
+    {
+        leaf_ptr xl = static_cast<leaf_ptr>(x);
+        leaf_ptr rl = static_cast<leaf_ptr>(right);
+
+        xl->keys[indexX] = rl->keys[0];
+        xl->values[indexX] = rl->values[0];
+
+        for (; indexR < rl->size; indexR++)
+        {
+            rl->keys[indexR - 1] = rl->keys[indexR];
+            rl->values[indexR - 1] = rl->values[indexR];
+        }
+
+        t->keys[index] = rl->keys[0];
+    }
+    else
+    {
+        inner_ptr xi = static_cast<inner_ptr>(x);
+        inner_ptr ri = static_cast<inner_ptr>(right);
+
+        xi->keys[indexX] = t->keys[index];
+        xi->children[indexX + 1] = ri->children[0];
+        t->keys[index] = ri->keys[0];
+
+        for (; indexR < ri->size; indexR++)
+        {
+            ri->keys[indexR - 1] = ri->keys[indexR];
+            ri->children[indexR - 1] = ri->children[indexR];
+        }
+        ri->children[indexR - 1] = ri->children[indexR];
+    }
+
+    --right->size;
+    ++x->size;
+}
+
+template <class K, class V, size_t N>
+void ConcurrentBTree<K, V, N>::mergeNodes(inner_ptr t, size_t index)
+{
+    node_ptr left = t->children[index];
+    node_ptr right = t->children[index + 1];
+    size_t indexL = left->size;
+    size_t indexR = 0;
+
+    if (left->leaf)
+    {
+        leaf_ptr ll = static_cast<leaf_ptr>(left);
+        leaf_ptr rl = static_cast<leaf_ptr>(right);
+
+        for (; indexR < rl->size; indexR++, indexL++)
+        {
+            ll->keys[indexL] = rl->keys[indexR];
+            ll->values[indexL] = rl->values[indexR];
+        }
+    }
+    else
+    {
+        inner_ptr li = static_cast<inner_ptr>(left);
+        inner_ptr ri = static_cast<inner_ptr>(right);
+
+        li->keys[indexL++] = t->keys[index];
+        for (; indexR < ri->size; indexR++, indexL++)
+        {
+            li->keys[indexL] = ri->keys[indexR];
+            li->children[indexL] = ri->children[indexR];
+        }
+        li->children[indexL] = ri->children[indexR];
+    }
+    left->size = indexL;
+
+    while (++index < t->size)
+    {
+        t->keys[index - 1] = t->keys[index];
+        t->children[index] = t->children[index + 1];
+    }
+    --t->size;
+}
+
+template <class K, class V, size_t N>
+void ConcurrentBTree<K, V, N>::retireNode(node_ptr t)
+{
+    mEpoch.retire(t, deleteNode);
+}
+
+template <class K, class V, size_t N>
+void ConcurrentBTree<K, V, N>::deleteNode(void * pointer)
+{
+    node_ptr t = static_cast<node_ptr>(pointer);
+
+    if (t->leaf)
+        delete static_cast<leaf_ptr>(t);
+    else
+        delete static_cast<inner_ptr>(t);
+}
+
+template <class K, class V, size_t N>
+void ConcurrentBTree<K, V, N>::clearRecursion(node_ptr t)
+{
+    if (!t->leaf)
+        for (size_t index = 0; index <= t->size; index++)
+            clearRecursion(static_cast<inner_ptr>(t)->children[index]);
+
+    deleteNode(t);
+}
+
+#endif//__CONCURRENT_B_TREE_H__
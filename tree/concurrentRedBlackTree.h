@@ -0,0 +1,527 @@
+#ifndef __CONCURRENT_RED_BLACK_TREE_H__
+#define __CONCURRENT_RED_BLACK_TREE_H__
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "epoch.h"
+
+// Red-black tree for read-mostly workloads: lookups take no lock and never
+// write shared memory, in the manner of read-copy-update.
+//
+// A published node is never written again. A writer works on a private
+// version of the tree: it copies the nodes on the path to the change, plus
+// the siblings rebalancing recolors or rotates, and leaves the rest of the
+// tree shared with the published version. Its last step stores the new
+// root, which makes the whole new version visible at once; a reader sees
+// either the old tree or the new one, never a rotation half done. The
+// nodes the new version replaced are then retired to an EpochManager and
+// freed once no reader can still be walking the old version.
+//
+// Writers serialise on a mutex, so any number of threads may call insert
+// and erase, but only one of them works at a time.
+template <class K, class V>
+class ConcurrentRedBlackTree
+{
+public:
+
+    enum NodeColor
+    {
+        RED,
+        BLACK
+    };
+
+    struct Node
+    {
+        typedef std::pair<const K, V> elem_type;
+        typedef size_t size_type;
+
+        elem_type element;
+        NodeColor color;
+        Node *leftChild, *rightChild;
+        // Write that created the node; it may be changed in place only by
+        // that write, before the node is published.
+        uint64_t stamp;
+
+        Node(const elem_type & element, NodeColor color, uint64_t stamp)
+            : element(element), color(color), leftChild(NULL), rightChild(NULL),
+            stamp(stamp) {}
+    };
+
+    typedef Node node_type;
+    typedef node_type* node_ptr;
+    typedef typename node_type::elem_type elem_type;
+    typedef K key_type;
+    typedef V value_type;
+    typedef typename node_type::size_type size_type;
+    typedef NodeColor color_type;
+
+public:
+
+    ConcurrentRedBlackTree();
+
+    ~ConcurrentRedBlackTree();
+
+    size_type size() const;
+
+    size_type height() const;
+
+    bool empty() const;
+
+    bool find(const K &, V &) const;
+
+    void insert(const K &, const V &);
+
+    void erase(const K &);
+
+private:
+
+    static const size_t MAX_HEIGHT = 2 * 8 * sizeof(size_type);
+
+    ConcurrentRedBlackTree(const ConcurrentRedBlackTree &);
+
+    ConcurrentRedBlackTree & operator = (const ConcurrentRedBlackTree &);
+
+    node_ptr copyPath(node_ptr *, size_t);
+
+    node_ptr own(node_ptr, node_ptr, node_ptr &);
+
+    void publish(node_ptr);
+
+    static void replaceChild(node_ptr, node_ptr, node_ptr, node_ptr &);
+
+    static color_type getColor(node_ptr);
+
+    static node_ptr rotateLeft(node_ptr);
+
+    static node_ptr rotateRight(node_ptr);
+
+    static size_type heightRecursion(node_ptr);
+
+    static void deleteNode(void *);
+
+    static void clearRecursion(node_ptr);
+
+private:
+
+    std::atomic<node_ptr> mRoot;
+
+    std::atomic<size_type> mTreeSize;
+
+    mutable EpochManager mEpoch;
+
+    // Everything below belongs to the writer holding mWriteLock.
+    std::mutex mWriteLock;
+
+    uint64_t mStamp;
+
+    std::vector<node_ptr> mReplaced;
+};
+
+template <class K, class V>
+ConcurrentRedBlackTree<K, V>::ConcurrentRedBlackTree()
+    : mRoot(NULL), mTreeSize(0), mStamp(0)
+{
+
+}
+
+template <class K, class V>
+ConcurrentRedBlackTree<K, V>::~ConcurrentRedBlackTree()
+{
+    clearRecursion(mRoot.load());
+}
+
+template <class K, class V>
+typename ConcurrentRedBlackTree<K, V>::size_type
+ConcurrentRedBlackTree<K, V>::size() const
+{
+    return mTreeSize.load(std::memory_order_relaxed);
+}
+
+template <class K, class V>
+typename ConcurrentRedBlackTree<K, V>::size_type
+ConcurrentRedBlackTree<K, V>::height() const
+{
+    EpochManager::Guard guard(mEpoch);
+
+    return heightRecursion(mRoot.load(std::memory_order_acquire));
+}
+
+template <class K, class V>
+bool ConcurrentRedBlackTree<K, V>::empty() const
+{
+    return size() == 0;
+}
+
+// Runs against whichever version was published when it loaded the root.
+template <class K, class V>
+bool ConcurrentRedBlackTree<K, V>::find(const K & key, V & value) const
+{
+    EpochManager::Guard guard(mEpoch);
+
+    node_ptr t = mRoot.load(std::memory_order_acquire);
+    while (t != NULL)
+    {
+        if (key < t->element.first)
+            t = t->leftChild;
+        else if (key > t->element.first)
+            t = t->rightChild;
+        else
+        {
+            value = t->element.second;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Inserting a present key replaces its value, in a copy of its node. A new
+// key gets a red node; while its parent is red, a red uncle is recolored
+// black and the problem moves to the grandparent, and otherwise one or two
+// rotations at the grandparent end it.
+template <class K, class V>
+void ConcurrentRedBlackTree<K, V>::insert(const K & key, const V & value)
+{
+    std::lock_guard<std::mutex> lock(mWriteLock);
+    mStamp++;
+
+    node_ptr path[MAX_HEIGHT];
+    size_t depth = 0;
+
+    node_ptr t = mRoot.load(std::memory_order_relaxed);
+    while (t != NULL)
+    {
+        path[depth++] = t;
+
+        if (key < t->element.first)
+            t = t->leftChild;
+        else if (key > t->element.first)
+            t = t->rightChild;
+        else
+        {
+            node_ptr root = copyPath(path, depth);
+            path[depth - 1]->element.second = value;
+            publish(root);
+            return;
+        }
+    }
+
+    node_ptr root = copyPath(path, depth);
+
+    t = new node_type(elem_type(key, value), color_type::RED, mStamp);
+    if (depth == 0)
+        root = t;
+    else if (key < path[depth - 1]->element.first)
+        path[depth - 1]->leftChild = t;
+    else
+        path[depth - 1]->rightChild = t;
+
+    while (depth >= 2 && getColor(path[depth - 1]) == color_type::RED)
+    {
+        node_ptr parent = path[depth - 1];
+        node_ptr grandParent = path[depth - 2];
+        bool parentLeft = grandParent->leftChild == parent;
+        node_ptr uncle = parentLeft ? grandParent->rightChild : grandParent->leftChild;
+
+        if (getColor(uncle) == color_type::RED)
+        {
+            uncle = own(grandParent, uncle, root);
+            parent->color = color_type::BLACK;
+            uncle->color = color_type::BLACK;
+            grandParent->color = color_type::RED;
+
+            t = grandParent;
+            depth -= 2;
+            continue;
+        }
+
+        if (parentLeft && parent->rightChild == t)
+        {
+            grandParent->leftChild = rotateLeft(parent);
+            parent = t;
+        }
+        else if (!parentLeft && parent->leftChild == t)
+        {
+            grandParent->rightChild = rotateRight(parent);
+            parent = t;
+        }
+
+        parent->color = color_type::BLACK;
+        grandParent->color = color_type::RED;
+        replaceChild(depth > 2 ? path[depth - 3] : NULL, grandParent,
+                parentLeft ? rotateRight(grandParent) : rotateLeft(grandParent),
+                root);
+        break;
+    }
+
+    // A red root is always one this write made or recolored.
+    if (getColor(root) == color_type::RED)
+        root->color = color_type::BLACK;
+
+    mTreeSize.fetch_add(1, std::memory_order_relaxed);
+    publish(root);
+}
+
+// A node with two children gives way to a fresh node holding its
+// predecessor's element, so the node taken out of the tree has at most one
+// child. Taking out a black node leaves its side one black short: a red
+// child repays that at once, otherwise the sibling side is rotated or
+// recolored until a rotation or a red parent absorbs the shortage.
+template <class K, class V>
+void ConcurrentRedBlackTree<K, V>::erase(const K & key)
+{
+    std::lock_guard<std::mutex> lock(mWriteLock);
+    mStamp++;
+
+    node_ptr path[MAX_HEIGHT];
+    size_t depth = 0;
+
+    node_ptr t = mRoot.load(std::memory_order_relaxed);
+    while (t != NULL && key != t->element.first)
+    {
+        path[depth++] = t;
+        t = key < t->element.first ? t->leftChild : t->rightChild;
+    }
+
+    if (t == NULL)
+        return;
+
+    size_t targetDepth = depth;
+    path[depth++] = t;
+
+    if (t->leftChild != NULL && t->rightChild != NULL)
+        for (t = t->leftChild; t != NULL; t = t->rightChild)
+            path[depth++] = t;
+
+    node_ptr root = copyPath(path, depth);
+    node_ptr target = path[targetDepth];
+
+    t = path[--depth];
+    node_ptr child = t->leftChild != NULL ? t->leftChild : t->rightChild;
+    node_ptr parent = depth > 0 ? path[depth - 1] : NULL;
+    bool leftShort = parent != NULL && parent->leftChild == t;
+    color_type removed = t->color;
+
+    replaceChild(parent, t, child, root);
+
+    if (t != target)
+    {
+        node_ptr successor = new node_type(t->element, target->color, mStamp);
+        successor->leftChild = target->leftChild;
+        successor->rightChild = target->rightChild;
+
+        replaceChild(targetDepth > 0 ? path[targetDepth - 1] : NULL, target,
+                successor, root);
+        path[targetDepth] = successor;
+        if (parent == target)
+            parent = successor;
+
+        delete target;
+    }
+
+    delete t;
+    mTreeSize.fetch_sub(1, std::memory_order_relaxed);
+
+    if (removed == color_type::BLACK && getColor(child) == color_type::RED)
+    {
+        own(parent, child, root)->color = color_type::BLACK;
+        removed = color_type::RED;
+    }
+
+    while (removed == color_type::BLACK && depth > 0)
+    {
+        parent = path[depth - 1];
+        node_ptr grandParent = depth > 1 ? path[depth - 2] : NULL;
+        node_ptr sibling = own(parent,
+                leftShort ? parent->rightChild : parent->leftChild, root);
+
+        // A red sibling is rotated above the parent, which turns red and
+        // gets one of the sibling's black children as its new sibling.
+        if (sibling->color == color_type::RED)
+        {
+            sibling->color = color_type::BLACK;
+            parent->color = color_type::RED;
+            replaceChild(grandParent, parent,
+                    leftShort ? rotateLeft(parent) : rotateRight(parent), root);
+
+            grandParent = sibling;
+            path[depth - 1] = sibling;
+            path[depth++] = parent;
+            sibling = own(parent,
+                    leftShort ? parent->rightChild : parent->leftChild, root);
+        }
+
+        node_ptr near = leftShort ? sibling->leftChild : sibling->rightChild;
+        node_ptr far = leftShort ? sibling->rightChild : sibling->leftChild;
+
+        if (getColor(near) == color_type::BLACK && getColor(far) == color_type::BLACK)
+        {
+            sibling->color = color_type::RED;
+            if (parent->color == color_type::RED)
+            {
+                parent->color = color_type::BLACK;
+                break;
+            }
+
+            depth--;
+            leftShort = grandParent != NULL && grandParent->leftChild == parent;
+            continue;
+        }
+
+        if (getColor(far) == color_type::BLACK)
+        {
+            near = own(sibling, near, root);
+            near->color = color_type::BLACK;
+            sibling->color = color_type::RED;
+            if (leftShort)
+                parent->rightChild = rotateRight(sibling);
+            else
+                parent->leftChild = rotateLeft(sibling);
+
+            far = sibling;
+            sibling = near;
+        }
+        else
+            far = own(sibling, far, root);
+
+        sibling->color = parent->color;
+        parent->color = color_type::BLACK;
+        far->color = color_type::BLACK;
+        replaceChild(grandParent, parent,
+                leftShort ? rotateLeft(parent) : rotateRight(parent), root);
+        break;
+    }
+
+    if (getColor(root) == color_type::RED)
+        root->color = color_type::BLACK;
+
+    publish(root);
+}
+
+// Replaces the published nodes on the path, root first, by private copies
+// linked to each other, and returns the new root.
+template <class K, class V>
+typename ConcurrentRedBlackTree<K, V>::node_ptr
+ConcurrentRedBlackTree<K, V>::copyPath(node_ptr * path, size_t depth)
+{
+    node_ptr root = mRoot.load(std::memory_order_relaxed);
+
+    for (size_t level = 0; level < depth; level++)
+        path[level] = own(level > 0 ? path[level - 1] : NULL, path[level], root);
+
+    return root;
+}
+
+// Returns a node this write may change in place: t itself if this write
+// made it, otherwise a copy that takes its place under parent, which must
+// already be private.
+template <class K, class V>
+typename ConcurrentRedBlackTree<K, V>::node_ptr
+ConcurrentRedBlackTree<K, V>::own(node_ptr parent, node_ptr t, node_ptr & root)
+{
+    if (t->stamp == mStamp)
+        return t;
+
+    node_ptr copy = new node_type(t->element, t->color, mStamp);
+    copy->leftChild = t->leftChild;
+    copy->rightChild = t->rightChild;
+
+    replaceChild(parent, t, copy, root);
+    mReplaced.push_back(t);
+
+    return copy;
+}
+
+// The store releases every write to the new version. Readers may still be
+// on the replaced nodes, so they are retired only now, after the last
+// pointer to them has left the tree.
+template <class K, class V>
+void ConcurrentRedBlackTree<K, V>::publish(node_ptr root)
+{
+    mRoot.store(root, std::memory_order_release);
+
+    for (size_t index = 0; index < mReplaced.size(); index++)
+        mEpoch.retire(mReplaced[index], deleteNode);
+
+    mReplaced.clear();
+}
+
+template <class K, class V>
+void ConcurrentRedBlackTree<K, V>::replaceChild(node_ptr parent, node_ptr child,
+        node_ptr replacement, node_ptr & root)
+{
+    if (parent == NULL)
+        root = replacement;
+    else if (parent->leftChild == child)
+        parent->leftChild = replacement;
+    else
+        parent->rightChild = replacement;
+}
+
+template <class K, class V>
+typename ConcurrentRedBlackTree<K, V>::color_type
+ConcurrentRedBlackTree<K, V>::getColor(node_ptr t)
+{
+    if (t == NULL)
+        return color_type::BLACK;
+
+    return t->color;
+}
+
+// Rotations only relink t and its child, so both must be private.
+template <class K, class V>
+typename ConcurrentRedBlackTree<K, V>::node_ptr
+ConcurrentRedBlackTree<K, V>::rotateLeft(node_ptr t)
+{
+    node_ptr newRoot = t->rightChild;
+    t->rightChild = newRoot->leftChild;
+    newRoot->leftChild = t;
+
+    return newRoot;
+}
+
+template <class K, class V>
+typename ConcurrentRedBlackTree<K, V>::node_ptr
+ConcurrentRedBlackTree<K, V>::rotateRight(node_ptr t)
+{
+    node_ptr newRoot = t->leftChild;
+    t->leftChild = newRoot->rightChild;
+    newRoot->rightChild = t;
+
+    return newRoot;
+}
+
+template <class K, class V>
+typename ConcurrentRedBlackTree<K, V>::size_type
+ConcurrentRedBlackTree<K, V>::heightRecursion(node_ptr t)
+{
+    if (t == NULL)
+        return 0;
+
+    return 1 + std::max(heightRecursion(t->leftChild), heightRecursion(t->rightChild));
+}
+
+template <class K, class V>
+void ConcurrentRedBlackTree<K, V>::deleteNode(void * pointer)
+{
+    delete static_cast<node_ptr>(pointer);
+}
+
+template <class K, class V>
+void ConcurrentRedBlackTree<K, V>::clearRecursion(node_ptr t)
+{
+    if (t == NULL)
+        return;
+
+    clearRecursion(t->leftChild);
+    clearRecursion(t->rightChild);
+    deleteNode(t);
+}
+
+#endif//__CONCURRENT_RED_BLACK_TREE_H__
@@ -0,0 +1,186 @@
+#ifndef __EPOCH_H__
+#define __EPOCH_H__
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <cstddef>
+#include <cstdint>
+
+// Epoch based reclamation for the lock-free readers of the concurrent trees.
+//
+// A thread that may touch shared nodes holds an EpochManager::Guard, which
+// announces the global epoch in the thread's slot. Unlinked nodes are
+// retired with the epoch current at unlink time and freed once every active
+// thread has announced a later epoch, i.e. entered after the unlink.
+//
+// Every thread that touches a tree using epochs takes one of MAX_THREADS
+// process-wide slots until it exits. A thread that finds them all taken
+// gets std::runtime_error from its first Guard (or enter()).
+class EpochManager
+{
+public:
+
+    static const size_t MAX_THREADS = 256;
+
+    typedef void (* deleter_type) (void *);
+
+    class Guard
+    {
+    public:
+
+        explicit Guard(EpochManager & manager)
+            : mManager(manager)
+        {
+            mManager.enter();
+        }
+
+        ~Guard()
+        {
+            mManager.leave();
+        }
+
+    private:
+
+        Guard(const Guard &);
+
+        Guard & operator = (const Guard &);
+
+        EpochManager & mManager;
+    };
+
+public:
+
+    EpochManager();
+
+    ~EpochManager();
+
+    void enter();
+
+    void leave();
+
+    void retire(void *, deleter_type);
+
+    void reclaimAll();
+
+private:
+
+    struct Retired
+    {
+        void * pointer;
+        deleter_type deleter;
+        uint64_t epoch;
+    };
+
+    struct alignas(64) Slot
+    {
+        std::atomic<uint64_t> epoch;
+    };
+
+    static const uint64_t IDLE = UINT64_MAX;
+
+    static const size_t COLLECT_THRESHOLD = 1024;
+
+    static size_t threadSlot();
+
+    std::atomic<uint64_t> mEpoch;
+
+    Slot mSlots[MAX_THREADS];
+
+    std::mutex mRetiredLock;
+
+    std::vector<Retired> mRetired;
+};
+
+inline EpochManager::EpochManager()
+    : mEpoch(1)
+{
+    for (size_t index = 0; index < MAX_THREADS; index++)
+        mSlots[index].epoch.store(IDLE, std::memory_order_relaxed);
+}
+
+inline EpochManager::~EpochManager()
+{
+    for (size_t index = 0; index < mRetired.size(); index++)
+        mRetired[index].deleter(mRetired[index].pointer);
+}
+
+inline void EpochManager::enter()
+{
+    mSlots[threadSlot()].epoch.store(mEpoch.load());
+}
+
+inline void EpochManager::leave()
+{
+    mSlots[threadSlot()].epoch.store(IDLE, std::memory_order_release);
+}
+
+inline void EpochManager::retire(void * pointer, deleter_type deleter)
+{
+    std::lock_guard<std::mutex> lock(mRetiredLock);
+
+    mRetired.push_back(Retired{pointer, deleter, mEpoch.load()});
+
+    if (mRetired.size() < COLLECT_THRESHOLD)
+        return;
+
+    uint64_t safe = mEpoch.fetch_add(1) + 1;
+    for (size_t index = 0; index < MAX_THREADS; index++)
+        safe = std::min(safe, mSlots[index].epoch.load());
+
+    size_t kept = 0;
+    for (size_t index = 0; index < mRetired.size(); index++)
+        if (mRetired[index].epoch < safe)
+            mRetired[index].deleter(mRetired[index].pointer);
+        else
+            mRetired[kept++] = mRetired[index];
+
+    mRetired.resize(kept);
+}
+
+// Frees everything retired so far; only legal while no reader is active.
+inline void EpochManager::reclaimAll()
+{
+    std::lock_guard<std::mutex> lock(mRetiredLock);
+
+    for (size_t index = 0; index < mRetired.size(); index++)
+        mRetired[index].deleter(mRetired[index].pointer);
+
+    mRetired.clear();
+}
+
+// Each thread claims one slot index for its lifetime, shared by all
+// managers, and gives it back when it exits. Throws if all MAX_THREADS
+// slots are held by live threads; a later call tries again.
+inline size_t EpochManager::threadSlot()
+{
+    static std::atomic<bool> claimed[MAX_THREADS];
+
+    struct Claim
+    {
+        size_t slot;
+
+        Claim()
+            : slot(0)
+        {
+            for (; slot < MAX_THREADS; slot++)
+                if (!claimed[slot].exchange(true))
+                    return;
+
+            throw std::runtime_error(
+                    "EpochManager: more than MAX_THREADS live threads");
+        }
+
+        ~Claim()
+        {
+            claimed[slot].store(false);
+        }
+    };
+
+    static thread_local Claim claim;
+    return claim.slot;
+}
+
+#endif//__EPOCH_H__
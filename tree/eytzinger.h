@@ -0,0 +1,172 @@
+#ifndef __EYTZINGER_H__
+#define __EYTZINGER_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <iterator>
+
+#include "prefetch.h"
+
+// Levels a search looks ahead when prefetching: the keys that many levels
+// below a slot fill about one cache line.
+constexpr size_t eytzingerPrefetchLevels(size_t keyBytes, size_t levels)
+{
+    return (size_t(2) << levels) * keyBytes <= PrefetchNodes::LINE_SIZE ?
+            eytzingerPrefetchLevels(keyBytes, levels + 1) : levels;
+}
+
+// Read-only search index over a fixed set of elements, as returned by the
+// freeze() of the trees.
+//
+// The keys are laid out in Eytzinger order: the implicit binary search tree
+// kept breadth first in an array, slot k having its children in slots 2k
+// and 2k + 1. The top levels, which every search walks, share a handful of
+// cache lines, and the 2^d descendants of a slot d levels down are adjacent,
+// so a search prefetches the keys it will reach a few levels ahead while it
+// compares the current one. The comparison only picks the next slot, with
+// no branch to mispredict. Elements sit apart from the keys, in the same
+// order, and are only touched once the search is over.
+//
+// As with the trees, constness is shallow: find() hands out elements whose
+// values may be changed in place. The set of keys never changes.
+template <class K, class V>
+class EytzingerIndex
+{
+public:
+
+    typedef std::pair<const K, V> elem_type;
+
+    typedef elem_type* elem_ptr;
+
+    typedef size_t size_type;
+
+public:
+
+    EytzingerIndex();
+
+    template <class ForwardIterator>
+    EytzingerIndex(ForwardIterator, ForwardIterator);
+
+    EytzingerIndex & operator = (EytzingerIndex);
+
+    size_type size() const;
+
+    bool empty() const;
+
+    elem_ptr find(const K &) const;
+
+private:
+
+    static const size_t PREFETCH_LEVELS = eytzingerPrefetchLevels(sizeof(K), 1);
+
+    template <class ForwardIterator>
+    static void layoutRecursion(size_t, ForwardIterator &,
+            std::vector<ForwardIterator> &);
+
+    // Slot 0 is unused, so that slot k is mKeys[k].
+    std::vector<K> mKeys;
+
+    mutable std::vector<elem_type> mElements;
+};
+
+template <class K, class V>
+EytzingerIndex<K, V>::EytzingerIndex()
+    : mKeys(1)
+{
+}
+
+// Builds the index from elements sorted by key, without duplicates, such as
+// those of a BTree in order.
+template <class K, class V>
+template <class ForwardIterator>
+EytzingerIndex<K, V>::EytzingerIndex(ForwardIterator first, ForwardIterator last)
+{
+    size_t n = std::distance(first, last);
+
+    std::vector<ForwardIterator> slots(n + 1, last);
+    layoutRecursion(1, first, slots);
+
+    mKeys.reserve(n + 1);
+    mKeys.push_back(K());
+    mElements.reserve(n);
+    for (size_t k = 1; k <= n; k++)
+    {
+        mKeys.push_back(slots[k]->first);
+        mElements.push_back(elem_type(slots[k]->first, slots[k]->second));
+    }
+}
+
+// The elements have constant keys and cannot be assigned one by one, so the
+// index is copied whole and swapped in.
+template <class K, class V>
+EytzingerIndex<K, V> & EytzingerIndex<K, V>::operator = (EytzingerIndex other)
+{
+    mKeys.swap(other.mKeys);
+    mElements.swap(other.mElements);
+
+    return *this;
+}
+
+template <class K, class V>
+typename EytzingerIndex<K, V>::size_type EytzingerIndex<K, V>::size() const
+{
+    return mElements.size();
+}
+
+template <class K, class V>
+bool EytzingerIndex<K, V>::empty() const
+{
+    return mElements.empty();
+}
+
+// Every search runs the full height of the implicit tree. Going right
+// appends a 1 to the slot number and going left a 0, so on leaving the
+// array the trailing 1s count the right turns taken after the last left
+// one; dropping them and that left turn gives the first key not less than
+// the one searched.
+template <class K, class V>
+typename EytzingerIndex<K, V>::elem_ptr
+EytzingerIndex<K, V>::find(const K & key) const
+{
+    const K * keys = mKeys.data();
+    size_t n = mElements.size();
+
+    // The address is formed as an integer: far below the leaves it points
+    // past the array, where it is only ever prefetched.
+    uintptr_t base = reinterpret_cast<uintptr_t>(keys);
+    size_t block = size_t(1) << PREFETCH_LEVELS;
+
+    size_t k = 1;
+    while (k <= n)
+    {
+        PrefetchNodes::range(reinterpret_cast<const void *>(
+                base + (k << PREFETCH_LEVELS) * sizeof(K)), block * sizeof(K));
+        k = 2 * k + (keys[k] < key);
+    }
+
+    k >>= __builtin_ctzl(~k) + 1;
+
+    if (k == 0 || key < keys[k])
+        return NULL;
+
+    return &mElements[k - 1];
+}
+
+// Hands out the sorted elements in order to the slots of the subtree under
+// slot k, which is an in-order walk of the implicit tree.
+template <class K, class V>
+template <class ForwardIterator>
+void EytzingerIndex<K, V>::layoutRecursion(size_t k, ForwardIterator & next,
+        std::vector<ForwardIterator> & slots)
+{
+    if (k >= slots.size())
+        return;
+
+    layoutRecursion(2 * k, next, slots);
+    slots[k] = next++;
+    layoutRecursion(2 * k + 1, next, slots);
+}
+
+#endif//__EYTZINGER_H__
@@ -0,0 +1,172 @@
+#ifndef __FORK_JOIN_H__
+#define __FORK_JOIN_H__
+
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <functional>
+#include <exception>
+#include <cstddef>
+
+// Fixed set of worker threads for divide and conquer over the trees.
+//
+// invoke(left, right) runs left on the calling thread and offers right to
+// the workers. While right is still queued or running, the caller does not
+// sit idle: it runs queued tasks itself, newest first, which is usually
+// its own right half. Workers take the oldest task, the biggest piece of
+// the work. A pool with no workers runs everything on the caller.
+class ForkJoinPool
+{
+public:
+
+    explicit ForkJoinPool(size_t workers = std::thread::hardware_concurrency());
+
+    ~ForkJoinPool();
+
+    size_t workers() const;
+
+    template <class Left, class Right>
+    void invoke(Left &, Right &);
+
+private:
+
+    struct Task
+    {
+        std::function<void ()> run;
+        bool done;
+        std::exception_ptr error;
+    };
+
+    ForkJoinPool(const ForkJoinPool &);
+
+    ForkJoinPool & operator = (const ForkJoinPool &);
+
+    void runTask(Task *, std::unique_lock<std::mutex> &);
+
+    void work();
+
+    std::mutex mLock;
+
+    std::condition_variable mQueued;
+
+    std::condition_variable mFinished;
+
+    std::deque<Task *> mQueue;
+
+    std::vector<std::thread> mWorkers;
+
+    bool mStopping;
+};
+
+inline ForkJoinPool::ForkJoinPool(size_t workers)
+    : mStopping(false)
+{
+    for (size_t index = 0; index < workers; index++)
+        mWorkers.push_back(std::thread(&ForkJoinPool::work, this));
+}
+
+inline ForkJoinPool::~ForkJoinPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mStopping = true;
+    }
+    mQueued.notify_all();
+
+    for (size_t index = 0; index < mWorkers.size(); index++)
+        mWorkers[index].join();
+}
+
+inline size_t ForkJoinPool::workers() const
+{
+    return mWorkers.size();
+}
+
+// Returns once both calls are done. An exception from either is thrown
+// here, the one from left first.
+template <class Left, class Right>
+void ForkJoinPool::invoke(Left & left, Right & right)
+{
+    Task task;
+    task.run = [&right]() { right(); };
+    task.done = false;
+
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mQueue.push_back(&task);
+    }
+    mQueued.notify_one();
+
+    std::exception_ptr error;
+    try
+    {
+        left();
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+
+    std::unique_lock<std::mutex> lock(mLock);
+    while (!task.done)
+    {
+        if (mQueue.empty())
+        {
+            mFinished.wait(lock);
+            continue;
+        }
+
+        Task * next = mQueue.back();
+        mQueue.pop_back();
+        runTask(next, lock);
+    }
+    lock.unlock();
+
+    if (error)
+        std::rethrow_exception(error);
+    if (task.error)
+        std::rethrow_exception(task.error);
+}
+
+// Called and returns with the lock held; the task itself runs without it.
+inline void ForkJoinPool::runTask(Task * task, std::unique_lock<std::mutex> & lock)
+{
+    lock.unlock();
+
+    std::exception_ptr error;
+    try
+    {
+        task->run();
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+
+    lock.lock();
+    task->error = error;
+    task->done = true;
+    mFinished.notify_all();
+}
+
+inline void ForkJoinPool::work()
+{
+    std::unique_lock<std::mutex> lock(mLock);
+
+    for (;;)
+    {
+        while (!mStopping && mQueue.empty())
+            mQueued.wait(lock);
+
+        if (mQueue.empty())
+            return;
+
+        Task * next = mQueue.front();
+        mQueue.pop_front();
+        runTask(next, lock);
+    }
+}
+
+#endif//__FORK_JOIN_H__
@@ -0,0 +1,415 @@
+#ifndef __LOGGED_B_TREE_H__
+#define __LOGGED_B_TREE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <utility>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "bTree.h"
+#include "wal.h"
+
+// BTree kept in memory and made durable by a write-ahead log.
+//
+// The tree lives in <path>.checkpoint, a sorted dump of all elements, plus
+// the inserts and erases logged to <path>.log since that dump was written.
+// Opening bulk loads the checkpoint and replays the log. Writes are logged
+// in groups: every groupSize writes, or on commit(), the pending records go
+// to disk with one sync, so a crash loses at most the writes after the last
+// commit. Once the log passes checkpointBytes a new checkpoint replaces the
+// old one and the log starts over; a checkpointBytes of 0 leaves that to
+// explicit checkpoint() calls.
+//
+// As in BTree, inserting a present key replaces its value, which makes
+// replaying a log twice harmless.
+template <class K, class V, size_t N>
+class LoggedBTree : private BTree<K, V, N>
+{
+public:
+
+    typedef BTree<K, V, N> tree_type;
+    typedef typename tree_type::node_type node_type;
+    typedef typename tree_type::node_ptr node_ptr;
+    typedef typename tree_type::key_type key_type;
+    typedef typename tree_type::value_type value_type;
+    typedef typename tree_type::value_ptr value_ptr;
+    typedef const value_type* const_value_ptr;
+    typedef typename tree_type::size_type size_type;
+
+    static const size_t DEFAULT_GROUP_SIZE = 256;
+
+    static const uint64_t DEFAULT_CHECKPOINT_BYTES = uint64_t(64) << 20;
+
+public:
+
+    explicit LoggedBTree(const char *, size_t groupSize = DEFAULT_GROUP_SIZE,
+            uint64_t checkpointBytes = DEFAULT_CHECKPOINT_BYTES);
+
+    ~LoggedBTree();
+
+    using tree_type::size;
+    using tree_type::height;
+    using tree_type::empty;
+    using tree_type::preOrder;
+    using tree_type::postOrder;
+    using tree_type::levelOrder;
+    using tree_type::stats;
+    using tree_type::freeze;
+
+    const_value_ptr find(const K &) const;
+
+    void inOrder(void (*) (const K &, const V &));
+
+    void insert(const K &, const V &);
+
+    void erase(const K &);
+
+    void clear();
+
+    void commit();
+
+    void checkpoint();
+
+    size_t replayed() const;
+
+private:
+
+    struct CheckpointHeader
+    {
+        uint64_t magic;
+        uint64_t keySize;
+        uint64_t valueSize;
+        uint64_t count;
+    };
+
+    // Feeds replayed records to the tree without logging them again.
+    struct Replayer
+    {
+        LoggedBTree & tree;
+
+        void insert(const K & key, const V & value) { tree.tree_type::insert(key, value); }
+
+        void erase(const K & key) { tree.tree_type::erase(key); }
+    };
+
+    LoggedBTree(const LoggedBTree &);
+
+    LoggedBTree & operator = (const LoggedBTree &);
+
+    void written();
+
+    void load();
+
+    static void inOrderRecursion(node_ptr, void (*) (const K &, const V &));
+
+    void checkpointRecursion(node_ptr, int, std::vector<char> &);
+
+    static void writeAll(int, const char *, size_t);
+
+    static void syncDirectory(const std::string &);
+
+    static void fail(const std::string &);
+
+    static const uint64_t MAGIC = 0x54504b4345484342ULL;
+
+    // Checkpoint bytes gathered before each write to the file.
+    static const size_t CHECKPOINT_CHUNK = 1 << 20;
+
+    std::string mCheckpointPath;
+
+    WriteAheadLog<K, V> mLog;
+
+    size_t mGroupSize;
+
+    uint64_t mCheckpointBytes;
+
+    size_t mReplayed;
+};
+
+template <class K, class V, size_t N>
+LoggedBTree<K, V, N>::LoggedBTree(const char * path, size_t groupSize,
+        uint64_t checkpointBytes)
+    : mCheckpointPath(std::string(path) + ".checkpoint"),
+      mLog((std::string(path) + ".log").c_str()),
+      mGroupSize(groupSize), mCheckpointBytes(checkpointBytes), mReplayed(0)
+{
+    load();
+
+    Replayer replayer = {*this};
+    mReplayed = mLog.replay(replayer);
+}
+
+template <class K, class V, size_t N>
+LoggedBTree<K, V, N>::~LoggedBTree()
+{
+    // No exceptions out of the destructor; call commit() to see errors.
+    try
+    {
+        mLog.commit();
+    }
+    catch (...)
+    {
+    }
+}
+
+// Values are read-only here: a write through them would never reach the
+// log. Insert the key again to change its value.
+template <class K, class V, size_t N>
+typename LoggedBTree<K, V, N>::const_value_ptr
+LoggedBTree<K, V, N>::find(const K & key) const
+{
+    return tree_type::find(key);
+}
+
+template <class K, class V, size_t N>
+void LoggedBTree<K, V, N>::inOrder(void (* visit) (const K &, const V &))
+{
+    inOrderRecursion(this->mRoot, visit);
+}
+
+template <class K, class V, size_t N>
+void LoggedBTree<K, V, N>::insert(const K & key, const V & value)
+{
+    mLog.logInsert(key, value);
+    tree_type::insert(key, value);
+    written();
+}
+
+template <class K, class V, size_t N>
+void LoggedBTree<K, V, N>::erase(const K & key)
+{
+    if (tree_type::find(key) == NULL)
+        return;
+
+    mLog.logErase(key);
+    tree_type::erase(key);
+    written();
+}
+
+// The empty tree is written as a checkpoint, which also empties the log.
+template <class K, class V, size_t N>
+void LoggedBTree<K, V, N>::clear()
+{
+    tree_type::clear();
+    checkpoint();
+}
+
+// Makes every write so far durable.
+template <class K, class V, size_t N>
+void LoggedBTree<K, V, N>::commit()
+{
+    mLog.commit();
+
+    if (mCheckpointBytes != 0 && mLog.bytes() >= mCheckpointBytes)
+        checkpoint();
+}
+
+// Writes the whole tree to a new checkpoint file and renames it over the
+// old one, so that a crash at any point leaves one complete checkpoint.
+// The log is emptied only after the rename; if a crash comes between the
+// two, the next open replays records the checkpoint already holds.
+template <class K, class V, size_t N>
+void LoggedBTree<K, V, N>::checkpoint()
+{
+    std::string temporary = mCheckpointPath + ".tmp";
+
+    int file = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (file < 0)
+        fail("cannot create " + temporary);
+
+    try
+    {
+        CheckpointHeader header = {MAGIC, sizeof(K), sizeof(V), this->size()};
+        std::vector<char> chunk(reinterpret_cast<char *>(&header),
+                reinterpret_cast<char *>(&header + 1));
+
+        checkpointRecursion(this->mRoot, file, chunk);
+        writeAll(file, chunk.data(), chunk.size());
+
+        if (::fsync(file) != 0)
+            fail("cannot sync " + temporary);
+    }
+    catch (...)
+    {
+        ::close(file);
+        throw;
+    }
+
+    ::close(file);
+
+    if (::rename(temporary.c_str(), mCheckpointPath.c_str()) != 0)
+        fail("cannot replace " + mCheckpointPath);
+    syncDirectory(mCheckpointPath);
+
+    mLog.reset();
+}
+
+// Number of log records applied when the tree was opened.
+template <class K, class V, size_t N>
+size_t LoggedBTree<K, V, N>::replayed() const
+{
+    return mReplayed;
+}
+
+template <class K, class V, size_t N>
+void LoggedBTree<K, V, N>::written()
+{
+    if (mLog.pending() >= mGroupSize)
+        commit();
+}
+
+template <class K, class V, size_t N>
+void LoggedBTree<K, V, N>::load()
+{
+    int file = ::open(mCheckpointPath.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        if (errno == ENOENT)
+            return;
+        fail("cannot open " + mCheckpointPath);
+    }
+
+    std::vector<char> data;
+    char buffer[CHECKPOINT_CHUNK / 16];
+    for (;;)
+    {
+        ssize_t n = ::read(file, buffer, sizeof buffer);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+        {
+            int error = errno;
+            ::close(file);
+            errno = error;
+            fail("cannot read " + mCheckpointPath);
+        }
+        if (n == 0)
+            break;
+        data.insert(data.end(), buffer, buffer + n);
+    }
+    ::close(file);
+
+    const size_t ELEMENT_SIZE = sizeof(K) + sizeof(V);
+
+    CheckpointHeader header;
+    if (data.size() >= sizeof header)
+        std::memcpy(&header, data.data(), sizeof header);
+
+    if (data.size() < sizeof header || header.magic != MAGIC ||
+            header.keySize != sizeof(K) || header.valueSize != sizeof(V) ||
+            data.size() - sizeof header != header.count * ELEMENT_SIZE)
+    {
+        errno = EINVAL;
+        fail(mCheckpointPath + " is not a checkpoint of this key and value type");
+    }
+
+    std::vector<std::pair<K, V> > elements(header.count);
+    const char * p = data.data() + sizeof header;
+    for (size_t i = 0; i < elements.size(); i++, p += ELEMENT_SIZE)
+    {
+        std::memcpy(&elements[i].first, p, sizeof(K));
+        std::memcpy(&elements[i].second, p + sizeof(K), sizeof(V));
+    }
+
+    this->bulkLoad(elements.begin(), elements.end());
+}
+
+template <class K, class V, size_t N>
+void LoggedBTree<K, V, N>::inOrderRecursion(node_ptr t,
+        void (* visit) (const K &, const V &))
+{
+    if (t == NULL)
+        return;
+
+    size_t index = 0;
+    while (index < t->size)
+    {
+        inOrderRecursion(t->children[index], visit);
+        visit(t->keys[index], t->values[index]);
+        index++;
+    }
+    inOrderRecursion(t->children[index], visit);
+}
+
+// Appends the elements under t in key order, writing the chunk out
+// whenever it fills.
+template <class K, class V, size_t N>
+void LoggedBTree<K, V, N>::checkpointRecursion(node_ptr t, int file,
+        std::vector<char> & chunk)
+{
+    if (t == NULL)
+        return;
+
+    for (size_t i = 0; i <= t->size; i++)
+    {
+        checkpointRecursion(t->children[i], file, chunk);
+
+        if (i == t->size)
+            break;
+
+        const char * key = reinterpret_cast<const char *>(&t->keys[i]);
+        const char * value = reinterpret_cast<const char *>(&t->values[i]);
+        chunk.insert(chunk.end(), key, key + sizeof(K));
+        chunk.insert(chunk.end(), value, value + sizeof(V));
+
+        if (chunk.size() >= CHECKPOINT_CHUNK)
+        {
+            writeAll(file, chunk.data(), chunk.size());
+            chunk.clear();
+        }
+    }
+}
+
+template <class K, class V, size_t N>
+void LoggedBTree<K, V, N>::writeAll(int file, const char * data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t n = ::write(file, data, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            fail("cannot write checkpoint");
+        data += n;
+        size -= n;
+    }
+}
+
+// A rename is durable only once the directory holding it is synced.
+template <class K, class V, size_t N>
+void LoggedBTree<K, V, N>::syncDirectory(const std::string & path)
+{
+    size_t slash = path.rfind('/');
+    std::string directory = slash == std::string::npos ? "." :
+            slash == 0 ? "/" : path.substr(0, slash);
+
+    int file = ::open(directory.c_str(), O_RDONLY);
+    if (file < 0)
+        fail("cannot open " + directory);
+
+    int result = ::fsync(file);
+    int error = errno;
+    ::close(file);
+
+    if (result != 0)
+    {
+        errno = error;
+        fail("cannot sync " + directory);
+    }
+}
+
+template <class K, class V, size_t N>
+void LoggedBTree<K, V, N>::fail(const std::string & message)
+{
+    throw std::runtime_error(message + ": " + std::strerror(errno));
+}
+
+#endif//__LOGGED_B_TREE_H__
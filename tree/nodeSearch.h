@@ -0,0 +1,207 @@
+#ifndef __NODE_SEARCH_H__
+#define __NODE_SEARCH_H__
+
+#include <cstddef>
+#include <type_traits>
+
+#if defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#endif
+
+// Lower bound search over the sorted key array of a tree node: returns the
+// number of keys that are smaller than the searched one.
+//
+// Signed 32/64 bit integers, float and double keys compare a whole block of
+// keys at once (AVX2 if available, else SSE4.2) and turn the comparison mask
+// into the slot index with a popcount. Other arithmetic keys use a branchless
+// scalar count, anything else the plain linear scan.
+
+enum KeyKind
+{
+    KEY_GENERIC,
+    KEY_SIGNED,
+    KEY_FLOAT
+};
+
+template <class K>
+struct KeyKindOf
+{
+    static const int value =
+        std::is_integral<K>::value && std::is_signed<K>::value ? KEY_SIGNED :
+        std::is_floating_point<K>::value ? KEY_FLOAT : KEY_GENERIC;
+};
+
+template <int Kind, size_t Bytes>
+struct SimdLess
+{
+    static const size_t LANES = 0;
+};
+
+#if defined(__AVX2__)
+
+template <>
+struct SimdLess<KEY_SIGNED, 4>
+{
+    static const size_t LANES = 8;
+
+    template <class K>
+    static unsigned mask(const K * keys, const K & key)
+    {
+        __m256i k = _mm256_set1_epi32(key);
+        __m256i v = _mm256_loadu_si256((const __m256i *) keys);
+        return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(k, v)));
+    }
+};
+
+template <>
+struct SimdLess<KEY_SIGNED, 8>
+{
+    static const size_t LANES = 4;
+
+    template <class K>
+    static unsigned mask(const K * keys, const K & key)
+    {
+        __m256i k = _mm256_set1_epi64x(key);
+        __m256i v = _mm256_loadu_si256((const __m256i *) keys);
+        return _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(k, v)));
+    }
+};
+
+template <>
+struct SimdLess<KEY_FLOAT, 4>
+{
+    static const size_t LANES = 8;
+
+    template <class K>
+    static unsigned mask(const K * keys, const K & key)
+    {
+        __m256 k = _mm256_set1_ps(key);
+        __m256 v = _mm256_loadu_ps(keys);
+        return _mm256_movemask_ps(_mm256_cmp_ps(v, k, _CMP_LT_OQ));
+    }
+};
+
+template <>
+struct SimdLess<KEY_FLOAT, 8>
+{
+    static const size_t LANES = 4;
+
+    template <class K>
+    static unsigned mask(const K * keys, const K & key)
+    {
+        __m256d k = _mm256_set1_pd(key);
+        __m256d v = _mm256_loadu_pd(keys);
+        return _mm256_movemask_pd(_mm256_cmp_pd(v, k, _CMP_LT_OQ));
+    }
+};
+
+#elif defined(__SSE4_2__)
+
+template <>
+struct SimdLess<KEY_SIGNED, 4>
+{
+    static const size_t LANES = 4;
+
+    template <class K>
+    static unsigned mask(const K * keys, const K & key)
+    {
+        __m128i k = _mm_set1_epi32(key);
+        __m128i v = _mm_loadu_si128((const __m128i *) keys);
+        return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(k, v)));
+    }
+};
+
+template <>
+struct SimdLess<KEY_SIGNED, 8>
+{
+    static const size_t LANES = 2;
+
+    template <class K>
+    static unsigned mask(const K * keys, const K & key)
+    {
+        __m128i k = _mm_set1_epi64x(key);
+        __m128i v = _mm_loadu_si128((const __m128i *) keys);
+        return _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(k, v)));
+    }
+};
+
+template <>
+struct SimdLess<KEY_FLOAT, 4>
+{
+    static const size_t LANES = 4;
+
+    template <class K>
+    static unsigned mask(const K * keys, const K & key)
+    {
+        return _mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(keys), _mm_set1_ps(key)));
+    }
+};
+
+template <>
+struct SimdLess<KEY_FLOAT, 8>
+{
+    static const size_t LANES = 2;
+
+    template <class K>
+    static unsigned mask(const K * keys, const K & key)
+    {
+        return _mm_movemask_pd(_mm_cmplt_pd(_mm_loadu_pd(keys), _mm_set1_pd(key)));
+    }
+};
+
+#endif
+
+template <class K, size_t Lanes = SimdLess<KeyKindOf<K>::value, sizeof(K)>::LANES,
+         bool Arithmetic = std::is_arithmetic<K>::value>
+struct NodeSearch
+{
+    static size_t lowerBound(const K * keys, size_t size, const K & key)
+    {
+        typedef SimdLess<KeyKindOf<K>::value, sizeof(K)> Simd;
+        const unsigned FULL = (1u << Lanes) - 1;
+
+        size_t index = 0;
+        for (; index + Lanes <= size; index += Lanes)
+        {
+            unsigned mask = Simd::mask(keys + index, key);
+            if (mask != FULL)
+                return index + __builtin_popcount(mask);
+        }
+
+        return index + NodeSearch<K, 0>::lowerBound(keys + index, size - index, key);
+    }
+};
+
+template <class K>
+struct NodeSearch<K, 0, true>
+{
+    static size_t lowerBound(const K * keys, size_t size, const K & key)
+    {
+        size_t index = 0;
+        for (size_t i = 0; i < size; i++)
+            index += keys[i] < key;
+
+        return index;
+    }
+};
+
+template <class K>
+struct NodeSearch<K, 0, false>
+{
+    static size_t lowerBound(const K * keys, size_t size, const K & key)
+    {
+        size_t index = 0;
+        while (index < size && keys[index] < key)
+            index++;
+
+        return index;
+    }
+};
+
+template <class K>
+inline size_t nodeLowerBound(const K * keys, size_t size, const K & key)
+{
+    return NodeSearch<K>::lowerBound(keys, size, key);
+}
+
+#endif//__NODE_SEARCH_H__
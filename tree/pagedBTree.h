@@ -0,0 +1,662 @@
+#ifndef __PAGED_B_TREE_H__
+#define __PAGED_B_TREE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <stdexcept>
+#include <type_traits>
+
+#include "pager.h"
+#include "nodeSearch.h"
+
+// BTree whose nodes are pages of a file mapped by Pager.
+//
+// The algorithms are those of BTree with child pointers replaced by page
+// ids (0 meaning no child). The order follows from the page size: a node
+// holds as many keys as fit in one page. Keys and values are stored as raw
+// bytes, so both have to be trivially copyable. Opening an existing file
+// only maps it; the tree is usable at once.
+template <class K, class V, size_t PageSize = 4096>
+class PagedBTree
+{
+public:
+
+    typedef Pager<PageSize> pager_type;
+    typedef typename pager_type::page_id page_id;
+
+    // Room for size, the extra child and alignment padding is kept aside.
+    static const size_t N = (PageSize - 4 * sizeof(uint64_t)) /
+            (sizeof(K) + sizeof(V) + sizeof(page_id));
+
+    struct Node
+    {
+        typedef K key_type;
+        typedef V value_type;
+        typedef Node* node_ptr;
+        typedef uint64_t size_type;
+
+        size_type size;
+        K keys[N];
+        page_id children[N + 1];
+        V values[N];
+    };
+
+    static_assert(std::is_trivially_copyable<K>::value &&
+            std::is_trivially_copyable<V>::value,
+            "paged keys and values must be trivially copyable");
+    static_assert(N >= 3 && sizeof(Node) <= PageSize,
+            "page too small for a node of order 3");
+
+    typedef Node node_type;
+    typedef node_type* node_ptr;
+    typedef K key_type;
+    typedef V value_type;
+    typedef value_type* value_ptr;
+    typedef typename node_type::size_type size_type;
+
+    struct ElemChild
+    {
+        K key;
+        V value;
+        page_id node;
+    };
+
+public:
+
+    explicit PagedBTree(const char *);
+
+    size_type size() const;
+
+    size_type height() const;
+
+    bool empty() const;
+
+    value_ptr find(const K &) const;
+
+    void insert(const K &, const V &);
+
+    void erase(const K &);
+
+    void clear();
+
+    void sync();
+
+    void preOrder(void (*) (node_ptr));
+
+    void inOrder(void (*) (const K &, V &));
+
+    void postOrder(void (*) (node_ptr));
+
+private:
+
+    // Lives in the user area of the pager header page.
+    struct Meta
+    {
+        uint64_t keySize;
+        uint64_t valueSize;
+        uint64_t order;
+        page_id root;
+        uint64_t treeSize;
+    };
+
+    PagedBTree(const PagedBTree &);
+
+    PagedBTree & operator = (const PagedBTree &);
+
+    Meta * meta() const;
+
+    node_ptr node(page_id) const;
+
+    page_id newNode();
+
+    ElemChild insertRecursion(page_id, const K &, const V &, bool &);
+
+    bool eraseRecursion(page_id, const K &);
+
+    static size_t searchNode(node_ptr, const K &);
+
+    ElemChild insertToNode(node_ptr, const K &, const V &, page_id);
+
+    ElemChild splitNode(node_ptr, const K &, const V &, page_id);
+
+    static void insertNotFull(node_ptr, const K &, const V &, page_id);
+
+    void eraseLeaf(page_id, const K &);
+
+    void repairNode(node_ptr, size_t);
+
+    void borrowFromLeftBro(node_ptr, size_t);
+
+    void borrowFromRightBro(node_ptr, size_t);
+
+    void mergeNodes(node_ptr, size_t);
+
+    node_ptr findLargest(page_id) const;
+
+    void preOrderRecursion(page_id, void (*) (node_ptr));
+
+    void inOrderRecursion(page_id, void (*) (const K &, V &));
+
+    void postOrderRecursion(page_id, void (*) (node_ptr));
+
+    void clearRecursion(page_id);
+
+    static_assert(sizeof(Meta) <= PageSize - sizeof(typename pager_type::Header),
+            "tree metadata does not fit the header page");
+
+    pager_type mPager;
+};
+
+template <class K, class V, size_t PageSize>
+PagedBTree<K, V, PageSize>::PagedBTree(const char * path)
+    : mPager(path)
+{
+    if (mPager.created())
+    {
+        meta()->keySize = sizeof(K);
+        meta()->valueSize = sizeof(V);
+        meta()->order = N;
+        meta()->root = 0;
+        meta()->treeSize = 0;
+    }
+    else if (meta()->keySize != sizeof(K) || meta()->valueSize != sizeof(V) ||
+            meta()->order != N)
+        throw std::runtime_error(std::string(path) +
+                " holds a tree of another key or value type");
+}
+
+template <class K, class V, size_t PageSize>
+typename PagedBTree<K, V, PageSize>::size_type
+PagedBTree<K, V, PageSize>::size() const
+{
+    return meta()->treeSize;
+}
+
+template <class K, class V, size_t PageSize>
+typename PagedBTree<K, V, PageSize>::size_type
+PagedBTree<K, V, PageSize>::height() const
+{
+    size_type h = 0;
+
+    for (page_id id = meta()->root; id != 0; id = node(id)->children[0])
+        h++;
+
+    return h;
+}
+
+template <class K, class V, size_t PageSize>
+bool PagedBTree<K, V, PageSize>::empty() const
+{
+    return meta()->treeSize == 0;
+}
+
+// The pointer stays valid until the next insert or erase.
+template <class K, class V, size_t PageSize>
+typename PagedBTree<K, V, PageSize>::value_ptr
+PagedBTree<K, V, PageSize>::find(const K & key) const
+{
+    page_id id = meta()->root;
+
+    while (id != 0)
+    {
+        node_ptr t = node(id);
+        size_t index = searchNode(t, key);
+
+        if (index < t->size && t->keys[index] == key)
+            return &t->values[index];
+
+        id = t->children[index];
+    }
+
+    return NULL;
+}
+
+// Inserting a present key replaces its value, so keys stay unique.
+template <class K, class V, size_t PageSize>
+void PagedBTree<K, V, PageSize>::insert(const K & key, const V & value)
+{
+    bool added = true;
+
+    if (meta()->root == 0)
+    {
+        page_id root = newNode();
+        insertNotFull(node(root), key, value, 0);
+        meta()->root = root;
+    }
+    else
+    {
+        ElemChild result = insertRecursion(meta()->root, key, value, added);
+
+        if (result.node != 0)
+        {
+            page_id root = newNode();
+            node_ptr t = node(root);
+            t->children[0] = meta()->root;
+            insertNotFull(t, result.key, result.value, result.node);
+            meta()->root = root;
+        }
+    }
+
+    if (added)
+        meta()->treeSize++;
+}
+
+template <class K, class V, size_t PageSize>
+void PagedBTree<K, V, PageSize>::erase(const K & key)
+{
+    page_id root = meta()->root;
+    if (root == 0)
+        return;
+
+    if (eraseRecursion(root, key))
+        meta()->treeSize--;
+
+    if (node(root)->size == 0)
+    {
+        meta()->root = node(root)->children[0];
+        mPager.release(root);
+    }
+}
+
+template <class K, class V, size_t PageSize>
+void PagedBTree<K, V, PageSize>::clear()
+{
+    clearRecursion(meta()->root);
+
+    meta()->root = 0;
+    meta()->treeSize = 0;
+}
+
+template <class K, class V, size_t PageSize>
+void PagedBTree<K, V, PageSize>::sync()
+{
+    mPager.sync();
+}
+
+template <class K, class V, size_t PageSize>
+void PagedBTree<K, V, PageSize>::preOrder(void (* visit) (node_ptr))
+{
+    preOrderRecursion(meta()->root, visit);
+}
+
+template <class K, class V, size_t PageSize>
+void PagedBTree<K, V, PageSize>::inOrder(void (* visit) (const K &, V &))
+{
+    inOrderRecursion(meta()->root, visit);
+}
+
+template <class K, class V, size_t PageSize>
+void PagedBTree<K, V, PageSize>::postOrder(void (* visit) (node_ptr))
+{
+    postOrderRecursion(meta()->root, visit);
+}
+
+template <class K, class V, size_t PageSize>
+typename PagedBTree<K, V, PageSize>::Meta *
+PagedBTree<K, V, PageSize>::meta() const
+{
+    return static_cast<Meta *>(mPager.userHeader());
+}
+
+template <class K, class V, size_t PageSize>
+typename PagedBTree<K, V, PageSize>::node_ptr
+PagedBTree<K, V, PageSize>::node(page_id id) const
+{
+    return static_cast<node_ptr>(mPager.page(id));
+}
+
+// Pages come back zeroed, which is an empty leaf.
+template <class K, class V, size_t PageSize>
+typename PagedBTree<K, V, PageSize>::page_id
+PagedBTree<K, V, PageSize>::newNode()
+{
+    return mPager.allocate();
+}
+
+// added is cleared when key is already present and only its value changes.
+template <class K, class V, size_t PageSize>
+typename PagedBTree<K, V, PageSize>::ElemChild
+PagedBTree<K, V, PageSize>::insertRecursion(page_id id, const K & key,
+        const V & value, bool & added)
+{
+    node_ptr t = node(id);
+    size_t index = searchNode(t, key);
+
+    if (index < t->size && t->keys[index] == key)
+    {
+        t->values[index] = value;
+        added = false;
+        return ElemChild{K(), V(), 0};
+    }
+
+    if (t->children[0] == 0)
+        return insertToNode(t, key, value, 0);
+
+    ElemChild result = insertRecursion(t->children[index], key, value, added);
+
+    if (result.node == 0)
+        return result;
+
+    return insertToNode(t, result.key, result.value, result.node);
+}
+
+template <class K, class V, size_t PageSize>
+bool PagedBTree<K, V, PageSize>::eraseRecursion(page_id id, const K & key)
+{
+    if (id == 0)
+        return false;
+
+    node_ptr t = node(id);
+    size_t index = searchNode(t, key);
+
+    if (index < t->size && t->keys[index] == key)
+    {
+        if (t->children[index] == 0)
+        {
+            eraseLeaf(id, key);
+            return true;
+        }
+        else
+        {
+            node_ptr leaf = findLargest(t->children[index]);
+            t->keys[index] = leaf->keys[leaf->size - 1];
+            t->values[index] = leaf->values[leaf->size - 1];
+            eraseLeaf(t->children[index], t->keys[index]);
+        }
+    }
+    else if (!eraseRecursion(t->children[index], key))
+        return false;
+
+    repairNode(t, index);
+    return true;
+}
+
+template <class K, class V, size_t PageSize>
+size_t PagedBTree<K, V, PageSize>::searchNode(node_ptr t, const K & key)
+{
+    return nodeLowerBound(t->keys, t->size, key);
+}
+
+template <class K, class V, size_t PageSize>
+typename PagedBTree<K, V, PageSize>::ElemChild
+PagedBTree<K, V, PageSize>::insertToNode(node_ptr t, const K & key,
+        const V & value, page_id child)
+{
+    if (t->size < N - 1)
+    {
+        insertNotFull(t, key, value, child);
+        return ElemChild{K(), V(), 0};
+    }
+
+    return splitNode(t, key, value, child);
+}
+
+// Pages are mapped at fixed addresses, so t stays valid across newNode().
+template <class K, class V, size_t PageSize>
+typename PagedBTree<K, V, PageSize>::ElemChild
+PagedBTree<K, V, PageSize>::splitNode(node_ptr t, const K & key,
+        const V & value, page_id child)
+{
+    insertNotFull(t, key, value, child);
+
+    page_id id = newNode();
+    node_ptr right = node(id);
+    size_t d = (N + 1) / 2 - 1;
+    ElemChild result = {t->keys[d], t->values[d], id};
+
+    size_t index = 0;
+    while (index + d + 1 < N)
+    {
+        right->keys[index] = t->keys[index + d + 1];
+        right->values[index] = t->values[index + d + 1];
+        right->children[index] = t->children[index + d + 1];
+        t->children[index + d + 1] = 0;
+        index++;
+    }
+    right->children[index] = t->children[index + d + 1];
+    t->children[index + d + 1] = 0;
+
+    right->size = index;
+    t->size = d;
+
+    return result;
+}
+
+template <class K, class V, size_t PageSize>
+void PagedBTree<K, V, PageSize>::insertNotFull(node_ptr t, const K & key,
+        const V & value, page_id child)
+{
+    size_t index = t->size;
+
+    while (index > 0 && t->keys[index - 1] > key)
+    {
+        t->keys[index] = t->keys[index - 1];
+        t->values[index] = t->values[index - 1];
+        t->children[index + 1] = t->children[index];
+        index--;
+    }
+
+    t->keys[index] = key;
+    t->values[index] = value;
+    t->children[index + 1] = child;
+    t->size++;
+}
+
+template <class K, class V, size_t PageSize>
+void PagedBTree<K, V, PageSize>::eraseLeaf(page_id id, const K & key)
+{
+    if (id == 0)
+        return;
+
+    node_ptr t = node(id);
+    size_t index = searchNode(t, key);
+
+    if (t->children[0] != 0)
+    {
+        // As in BTree: the element removed is the largest of the subtree.
+        while (index < t->size && !(key < t->keys[index]))
+            index++;
+
+        eraseLeaf(t->children[index], key);
+        repairNode(t, index);
+    }
+    else
+    {
+        while (++index < t->size)
+        {
+            t->keys[index - 1] = t->keys[index];
+            t->values[index - 1] = t->values[index];
+        }
+        t->size--;
+    }
+}
+
+template <class K, class V, size_t PageSize>
+void PagedBTree<K, V, PageSize>::repairNode(node_ptr t, size_t index)
+{
+    const size_t MIN_NUM = (N - 1) / 2;
+    node_ptr x = node(t->children[index]);
+
+    if (x->size >= MIN_NUM)
+        return;
+
+    node_ptr leftBro = index > 0 ? node(t->children[index - 1]) : NULL;
+    node_ptr rightBro = index < t->size ? node(t->children[index + 1]) : NULL;
+
+    if (leftBro != NULL && leftBro->size > MIN_NUM)
+        borrowFromLeftBro(t, index);
+    else if (rightBro != NULL && rightBro->size > MIN_NUM)
+        borrowFromRightBro(t, index);
+    else
+        mergeNodes(t, (leftBro == NULL ? index : index - 1));
+}
+
+template <class K, class V, size_t PageSize>
+void PagedBTree<K, V, PageSize>::borrowFromLeftBro(node_ptr t, size_t index)
+{
+    node_ptr x = node(t->children[index]);
+    node_ptr left = node(t->children[index - 1]);
+
+    size_t indexL = left->size;
+    size_t indexX = x->size;
+
+    x->children[indexX + 1] = x->children[indexX];
+    while (indexX > 0)
+    {
+        x->keys[indexX] = x->keys[indexX - 1];
+        x->values[indexX] = x->values[indexX - 1];
+        x->children[indexX] = x->children[indexX - 1];
+        indexX--;
+    }
+
+    x->keys[0] = t->keys[index - 1];
+    x->values[0] = t->values[index - 1];
+    x->children[0] = left->children[indexL];
+    t->keys[index - 1] = left->keys[indexL - 1];
+    t->values[index - 1] = left->values[indexL - 1];
+    left->children[indexL] = 0;
+
+    left->size--;
+    x->size++;
+}
+
+template <class K, class V, size_t PageSize>
+void PagedBTree<K, V, PageSize>::borrowFromRightBro(node_ptr t, size_t index)
+{
+    node_ptr x = node(t->children[index]);
+    node_ptr right = node(t->children[index + 1]);
+
+    size_t indexR = 1;
+    size_t indexX = x->size;
+
+    x->keys[indexX] = t->keys[index];
+    x->values[indexX] = t->values[index];
+    x->children[indexX + 1] = right->children[0];
+    t->keys[index] = right->keys[0];
+    t->values[index] = right->values[0];
+
+    while (indexR < right->size)
+    {
+        right->keys[indexR - 1] = right->keys[indexR];
+        right->values[indexR - 1] = right->values[indexR];
+        right->children[indexR - 1] = right->children[indexR];
+        indexR++;
+    }
+    right->children[indexR - 1] = right->children[indexR];
+    right->children[indexR] = 0;
+
+    right->size--;
+    x->size++;
+}
+
+template <class K, class V, size_t PageSize>
+void PagedBTree<K, V, PageSize>::mergeNodes(node_ptr t, size_t index)
+{
+    node_ptr left = node(t->children[index]);
+    page_id rightId = t->children[index + 1];
+    node_ptr right = node(rightId);
+    size_t indexL = left->size;
+
+    left->keys[indexL] = t->keys[index];
+    left->values[indexL++] = t->values[index];
+    while (++index < t->size)
+    {
+        t->keys[index - 1] = t->keys[index];
+        t->values[index - 1] = t->values[index];
+        t->children[index] = t->children[index + 1];
+    }
+    t->children[index] = 0;
+    t->size--;
+
+    size_t indexR = 0;
+    while (indexR < right->size)
+    {
+        left->keys[indexL] = right->keys[indexR];
+        left->values[indexL] = right->values[indexR];
+        left->children[indexL++] = right->children[indexR++];
+    }
+    left->children[indexL] = right->children[indexR];
+    left->size = indexL;
+
+    mPager.release(rightId);
+}
+
+template <class K, class V, size_t PageSize>
+typename PagedBTree<K, V, PageSize>::node_ptr
+PagedBTree<K, V, PageSize>::findLargest(page_id id) const
+{
+    node_ptr t = node(id);
+
+    while (t->children[t->size] != 0)
+        t = node(t->children[t->size]);
+
+    return t;
+}
+
+template <class K, class V, size_t PageSize>
+void PagedBTree<K, V, PageSize>::preOrderRecursion(page_id id,
+        void (* visit) (node_ptr))
+{
+    if (id == 0)
+        return;
+
+    node_ptr t = node(id);
+    visit(t);
+
+    if (t->children[0] != 0)
+        for (size_t index = 0; index <= t->size; index++)
+            preOrderRecursion(t->children[index], visit);
+}
+
+template <class K, class V, size_t PageSize>
+void PagedBTree<K, V, PageSize>::inOrderRecursion(page_id id,
+        void (* visit) (const K &, V &))
+{
+    if (id == 0)
+        return;
+
+    node_ptr t = node(id);
+
+    size_t index = 0;
+    while (index < t->size)
+    {
+        inOrderRecursion(t->children[index], visit);
+        visit(t->keys[index], t->values[index]);
+        index++;
+    }
+    inOrderRecursion(t->children[index], visit);
+}
+
+template <class K, class V, size_t PageSize>
+void PagedBTree<K, V, PageSize>::postOrderRecursion(page_id id,
+        void (* visit) (node_ptr))
+{
+    if (id == 0)
+        return;
+
+    node_ptr t = node(id);
+
+    if (t->children[0] != 0)
+        for (size_t index = 0; index <= t->size; index++)
+            postOrderRecursion(t->children[index], visit);
+
+    visit(t);
+}
+
+template <class K, class V, size_t PageSize>
+void PagedBTree<K, V, PageSize>::clearRecursion(page_id id)
+{
+    if (id == 0)
+        return;
+
+    node_ptr t = node(id);
+
+    if (t->children[0] != 0)
+        for (size_t index = 0; index <= t->size; index++)
+            clearRecursion(t->children[index]);
+
+    mPager.release(id);
+}
+
+#endif//__PAGED_B_TREE_H__
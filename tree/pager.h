@@ -0,0 +1,257 @@
+#ifndef __PAGER_H__
+#define __PAGER_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// File of fixed-size pages mapped with mmap.
+//
+// The whole address range the file may grow to is mapped once up front, so
+// page addresses stay valid while the file grows. Page 0 holds the pager
+// header followed by a small area for the owner of the file (userHeader());
+// page id 0 therefore doubles as the null page id. Freed pages are kept in a
+// list threaded through their first bytes and reused by allocate().
+template <size_t PageSize>
+class Pager
+{
+public:
+
+    typedef uint64_t page_id;
+
+    static const size_t PAGE_SIZE = PageSize;
+
+    static const size_t DEFAULT_RESERVE = size_t(1) << 36;
+
+    struct Header
+    {
+        uint64_t magic;
+        uint64_t pageSize;
+        uint64_t pageCount;
+        page_id freeHead;
+    };
+
+    static_assert(PageSize >= 2 * sizeof(Header) && PageSize % 64 == 0,
+            "page size must be a multiple of 64 and hold the header");
+
+public:
+
+    Pager(const char *, size_t reserve = DEFAULT_RESERVE);
+
+    ~Pager();
+
+    bool created() const;
+
+    void * page(page_id) const;
+
+    void * userHeader() const;
+
+    page_id allocate();
+
+    void release(page_id);
+
+    uint64_t pageCount() const;
+
+    void sync();
+
+private:
+
+    Pager(const Pager &);
+
+    Pager & operator = (const Pager &);
+
+    Header * header() const;
+
+    void open(const char *);
+
+    void close();
+
+    void grow(uint64_t);
+
+    static void fail(const std::string &);
+
+    static const uint64_t MAGIC = 0x31524547415042ULL;
+
+    int mFile;
+
+    char * mBase;
+
+    size_t mReserve;
+
+    uint64_t mFileSize;
+
+    bool mCreated;
+};
+
+template <size_t PageSize>
+Pager<PageSize>::Pager(const char * path, size_t reserve)
+    : mFile(-1), mBase(NULL), mReserve(reserve), mFileSize(0), mCreated(false)
+{
+    try
+    {
+        open(path);
+    }
+    catch (...)
+    {
+        close();
+        throw;
+    }
+}
+
+template <size_t PageSize>
+Pager<PageSize>::~Pager()
+{
+    // No exceptions out of the destructor; call sync() to see errors.
+    if (mBase != NULL)
+        ::msync(mBase, header()->pageCount * PageSize, MS_SYNC);
+
+    close();
+}
+
+template <size_t PageSize>
+void Pager<PageSize>::open(const char * path)
+{
+    mFile = ::open(path, O_RDWR | O_CREAT, 0644);
+    if (mFile < 0)
+        fail(std::string("cannot open ") + path);
+
+    struct stat st;
+    if (::fstat(mFile, &st) != 0)
+        fail("cannot stat page file");
+    mFileSize = st.st_size;
+
+    void * base = ::mmap(NULL, mReserve, PROT_READ | PROT_WRITE, MAP_SHARED, mFile, 0);
+    if (base == MAP_FAILED)
+        fail("cannot map page file");
+    mBase = static_cast<char *>(base);
+
+    if (mFileSize == 0)
+    {
+        grow(1);
+        header()->magic = MAGIC;
+        header()->pageSize = PageSize;
+        header()->pageCount = 1;
+        header()->freeHead = 0;
+        mCreated = true;
+    }
+    else if (mFileSize < sizeof(Header) || header()->magic != MAGIC ||
+            header()->pageSize != PageSize ||
+            mFileSize < header()->pageCount * PageSize)
+    {
+        errno = EINVAL;
+        fail(std::string(path) + " is not a page file of this page size");
+    }
+}
+
+template <size_t PageSize>
+void Pager<PageSize>::close()
+{
+    if (mBase != NULL)
+        ::munmap(mBase, mReserve);
+
+    if (mFile >= 0)
+        ::close(mFile);
+
+    mBase = NULL;
+    mFile = -1;
+}
+
+template <size_t PageSize>
+bool Pager<PageSize>::created() const
+{
+    return mCreated;
+}
+
+template <size_t PageSize>
+void * Pager<PageSize>::page(page_id id) const
+{
+    return mBase + id * PageSize;
+}
+
+template <size_t PageSize>
+void * Pager<PageSize>::userHeader() const
+{
+    return mBase + sizeof(Header);
+}
+
+template <size_t PageSize>
+typename Pager<PageSize>::page_id
+Pager<PageSize>::allocate()
+{
+    page_id id = header()->freeHead;
+
+    if (id != 0)
+        header()->freeHead = *static_cast<page_id *>(page(id));
+    else
+    {
+        id = header()->pageCount;
+        grow(id + 1);
+        header()->pageCount = id + 1;
+    }
+
+    std::memset(page(id), 0, PageSize);
+    return id;
+}
+
+template <size_t PageSize>
+void Pager<PageSize>::release(page_id id)
+{
+    *static_cast<page_id *>(page(id)) = header()->freeHead;
+    header()->freeHead = id;
+}
+
+template <size_t PageSize>
+uint64_t Pager<PageSize>::pageCount() const
+{
+    return header()->pageCount;
+}
+
+template <size_t PageSize>
+void Pager<PageSize>::sync()
+{
+    if (::msync(mBase, header()->pageCount * PageSize, MS_SYNC) != 0)
+        fail("cannot sync page file");
+}
+
+template <size_t PageSize>
+typename Pager<PageSize>::Header *
+Pager<PageSize>::header() const
+{
+    return reinterpret_cast<Header *>(mBase);
+}
+
+template <size_t PageSize>
+void Pager<PageSize>::grow(uint64_t pages)
+{
+    if (pages * PageSize > mReserve)
+        throw std::length_error("page file exceeds the reserved mapping");
+
+    if (mFileSize >= pages * PageSize)
+        return;
+
+    // Grow the file in chunks so that ftruncate is not paid per page.
+    uint64_t size = std::max<uint64_t>(pages * PageSize, mFileSize + mFileSize / 4);
+    size = std::min<uint64_t>((size + PageSize - 1) / PageSize * PageSize, mReserve);
+
+    if (::ftruncate(mFile, size) != 0)
+        fail("cannot grow page file");
+
+    mFileSize = size;
+}
+
+template <size_t PageSize>
+void Pager<PageSize>::fail(const std::string & message)
+{
+    throw std::runtime_error(message + ": " + std::strerror(errno));
+}
+
+#endif//__PAGER_H__
@@ -0,0 +1,34 @@
+#ifndef __PREFETCH_H__
+#define __PREFETCH_H__
+
+#include <cstddef>
+#include <cstdint>
+
+// Prefetch policies for the searches of the trees, passed as their last
+// template argument. A search hands the policy each node it is about to
+// visit as soon as the node's address is known; NoPrefetch, the default,
+// compiles to nothing, PrefetchNodes requests every cache line of the
+// given range.
+
+struct NoPrefetch
+{
+    static void range(const void *, size_t) {}
+};
+
+struct PrefetchNodes
+{
+    static const size_t LINE_SIZE = 64;
+
+    // Leaf children arrive here as NULL; the line arithmetic is done on
+    // integers so that they stay a harmless prefetch of address zero.
+    static void range(const void * address, size_t bytes)
+    {
+        uintptr_t first = reinterpret_cast<uintptr_t>(address) & ~(LINE_SIZE - 1);
+        uintptr_t last = reinterpret_cast<uintptr_t>(address) + bytes - 1;
+
+        for (uintptr_t line = first; line <= last; line += LINE_SIZE)
+            __builtin_prefetch(reinterpret_cast<const void *>(line));
+    }
+};
+
+#endif//__PREFETCH_H__
@@ -5,8 +5,15 @@
 #include <cstddef>
 #include <algorithm>
 #include <list>
+#include <vector>
+#include <cstdint>
 
-template <class K, class V>
+#include "prefetch.h"
+#include "eytzinger.h"
+#include "treeIterator.h"
+#include "forkJoin.h"
+
+template <class K, class V, class Prefetch = NoPrefetch, bool Compact = false>
 class RedBlackTree
 {
 public:
@@ -17,30 +24,92 @@ public:
         BLACK
     };
 
-    struct Node
+    // Node with every field stored as is.
+    template <bool IsCompact, class Unused = void>
+    struct NodeLayout
     {
         typedef std::pair<const K, V> elem_type;
         typedef elem_type* elem_ptr;
         typedef size_t size_type;
 
+        static const bool STORES_BLACK_COUNT = true;
+
         elem_type element;
         NodeColor color;
         size_type blackCount;
-        Node *leftChild, *rightChild;
+        size_type subtreeSize;
+        NodeLayout *leftChild, *rightChild;
 
-        Node(const elem_type & element, NodeColor color)
-            : element(element), color(color), blackCount(1), 
+        NodeLayout(const elem_type & element, NodeColor color)
+            : element(element), color(color), blackCount(1), subtreeSize(1),
             leftChild(NULL), rightChild(NULL) {}
 
-        Node(const elem_type & element, NodeColor color,
-                Node * leftChild, Node * rightChild)
-            : element(element), color(color), blackCount(1), 
-            leftChild(leftChild), rightChild(rightChild) {}
+        NodeLayout * left() const { return leftChild; }
+        NodeLayout * right() const { return rightChild; }
+        void setLeft(NodeLayout * t) { leftChild = t; }
+        void setRight(NodeLayout * t) { rightChild = t; }
+
+        NodeColor getColor() const { return color; }
+        void setColor(NodeColor c) { color = c; }
+
+        size_type getBlackCount() const { return blackCount; }
+        void setBlackCount(size_type count) { blackCount = count; }
+    };
+
+    // Node for large trees of small elements. The color lives in the low
+    // bit of the right child pointer, which node alignment leaves free, and
+    // the black count is counted down the left spine when asked for.
+    template <class Unused>
+    struct NodeLayout<true, Unused>
+    {
+        typedef std::pair<const K, V> elem_type;
+        typedef elem_type* elem_ptr;
+        typedef size_t size_type;
+
+        static const bool STORES_BLACK_COUNT = false;
+
+        elem_type element;
+        size_type subtreeSize;
+        NodeLayout * leftChild;
+        uintptr_t rightAndColor;
+
+        NodeLayout(const elem_type & element, NodeColor color)
+            : element(element), subtreeSize(1), leftChild(NULL),
+            rightAndColor(color) {}
+
+        NodeLayout * left() const { return leftChild; }
+        NodeLayout * right() const
+        {
+            return reinterpret_cast<NodeLayout *>(rightAndColor & ~uintptr_t(1));
+        }
+        void setLeft(NodeLayout * t) { leftChild = t; }
+        void setRight(NodeLayout * t)
+        {
+            rightAndColor = reinterpret_cast<uintptr_t>(t) | (rightAndColor & 1);
+        }
+
+        NodeColor getColor() const { return NodeColor(rightAndColor & 1); }
+        void setColor(NodeColor c)
+        {
+            rightAndColor = (rightAndColor & ~uintptr_t(1)) | uintptr_t(c);
+        }
+
+        size_type getBlackCount() const
+        {
+            size_type count = 1;
+            for (NodeLayout * t = leftChild; t != NULL; t = t->leftChild)
+                count += t->getColor() == BLACK;
+
+            return count;
+        }
+        void setBlackCount(size_type) {}
     };
 
+    static_assert(BLACK == 1 && RED == 0, "a color must fit in one bit");
+
 public:
     
-    typedef Node node_type;
+    typedef NodeLayout<Compact> node_type;
 
     typedef node_type* node_ptr;
 
@@ -50,6 +119,8 @@ public:
 
     typedef typename node_type::size_type size_type;
 
+    typedef BinaryTreeIterator<node_type> iterator;
+
     typedef NodeColor color_type;
 
 public:
@@ -58,6 +129,8 @@ public:
 
     ~RedBlackTree();
 
+    size_type size() const;
+
     size_type height() const;
 
     bool empty() const;
@@ -66,6 +139,20 @@ public:
 
     elem_ptr find(const K &) const;
 
+    iterator begin() const;
+
+    iterator end() const;
+
+    iterator lower_bound(const K &) const;
+
+    iterator upper_bound(const K &) const;
+
+    std::pair<iterator, iterator> equal_range(const K &) const;
+
+    elem_ptr select(size_type) const;
+
+    size_type rank(const K &) const;
+
     void insert(const K &, const V &);
 
     void erase(const K &);
@@ -78,31 +165,66 @@ public:
 
     void levelOrder(void (*) (node_ptr));
 
+    EytzingerIndex<K, V> freeze() const;
+
+    void join(RedBlackTree &);
+
+    void split(const K &, RedBlackTree &);
+
+    void unionWith(RedBlackTree &);
+
+    void unionWith(RedBlackTree &, ForkJoinPool &);
+
+    void intersectWith(RedBlackTree &);
+
+    void intersectWith(RedBlackTree &, ForkJoinPool &);
+
+    void differenceWith(RedBlackTree &);
+
+    void differenceWith(RedBlackTree &, ForkJoinPool &);
+
 private:
 
+    // Bound on the height, for the path stacks of insert and erase: no path
+    // is more than twice as long as the shortest one.
+    static const size_t MAX_HEIGHT = 2 * 8 * sizeof(size_type);
+
+    // Combined size below which the set operations stop forking.
+    static const size_type PARALLEL_GRAIN = 1 << 14;
+
+    // A subtree handled by join, split and the set operations, with its
+    // black height. The heights are handed down and back up with the
+    // subtrees rather than read from the nodes, which the compact layout
+    // could only do by walking the left spine. The root may be red.
+    struct Piece
+    {
+        node_ptr root;
+        size_type height;
+    };
+
     void adjustRoot();
 
+    void adopt(node_ptr, RedBlackTree &);
+
+    void replaceChild(node_ptr, node_ptr, node_ptr);
+
     static color_type getColor(node_ptr);
 
     static size_type countColor(node_ptr, color_type);
 
     static size_type getBlackCount(node_ptr);
 
-    static int getBlackFactor(node_ptr);
-
-    static size_type heightRecursion(node_ptr);
-
-    static size_type updateBlackCount(node_ptr);
+    static size_type getSubtreeSize(node_ptr);
 
-    static node_ptr insertRecursion(node_ptr, const K &, const V &);
+    static void updateSubtreeSize(node_ptr);
 
-    static node_ptr eraseRecursion(node_ptr, const K &);
+    static size_type heightRecursion(node_ptr);
 
-    static node_ptr eraseLargest(node_ptr, node_ptr & largest);
+    static void updateBlackCount(node_ptr);
 
-    static node_ptr insertAdjustRecursion(node_ptr);
+    static node_ptr insertAdjust(node_ptr);
 
-    static node_ptr eraseAdjustRecursion(node_ptr);
+    static node_ptr eraseAdjust(node_ptr, bool leftShort);
 
     static node_ptr insertChangeColor(node_ptr);
 
@@ -148,6 +270,41 @@ private:
 
     static void postOrderRecursion(node_ptr, void (*) (node_ptr));
 
+    static void freezeRecursion(node_ptr, std::vector<std::pair<K, V> > &);
+
+    static size_type blackHeight(node_ptr);
+
+    static Piece piece(node_ptr);
+
+    static Piece leftPiece(Piece);
+
+    static Piece rightPiece(Piece);
+
+    static node_ptr link(node_ptr, node_ptr, node_ptr);
+
+    static Piece joinNodes(Piece, node_ptr, Piece);
+
+    static node_ptr joinRight(node_ptr, size_type, node_ptr, node_ptr, size_type);
+
+    static node_ptr joinLeft(node_ptr, size_type, node_ptr, node_ptr, size_type);
+
+    static Piece concat(Piece, Piece);
+
+    static Piece splitLast(Piece, node_ptr & last);
+
+    static node_ptr splitNodes(Piece, const K &, Piece & less, Piece & greater);
+
+    static Piece unionRecursion(Piece, Piece, ForkJoinPool *);
+
+    static Piece intersectRecursion(Piece, Piece, ForkJoinPool *);
+
+    static Piece differenceRecursion(Piece, Piece, ForkJoinPool *);
+
+    template <class Left, class Right>
+    static void both(ForkJoinPool *, size_type, Left &, Right &);
+
+    static void freeRecursion(node_ptr);
+
 protected:
 
     node_ptr mRoot;
@@ -155,50 +312,64 @@ protected:
     size_type mTreeSize;
 };
 
-template <class K, class V>
-RedBlackTree<K, V>::RedBlackTree()
+template <class K, class V, class Prefetch, bool Compact>
+RedBlackTree<K, V, Prefetch, Compact>::RedBlackTree()
     : mRoot(NULL), mTreeSize(0)
 {
 
 }
 
-template <class K, class V>
-RedBlackTree<K, V>::~RedBlackTree()
+template <class K, class V, class Prefetch, bool Compact>
+RedBlackTree<K, V, Prefetch, Compact>::~RedBlackTree()
 {
     clear();
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::size_type
-RedBlackTree<K, V>::height() const
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::size_type
+RedBlackTree<K, V, Prefetch, Compact>::size() const
+{
+    return mTreeSize;
+}
+
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::size_type
+RedBlackTree<K, V, Prefetch, Compact>::height() const
 {
     return heightRecursion(this->mRoot);
 }
 
-template <class K, class V>
-bool RedBlackTree<K, V>::empty() const
+template <class K, class V, class Prefetch, bool Compact>
+bool RedBlackTree<K, V, Prefetch, Compact>::empty() const
 {
     return mTreeSize == 0;
 }
 
-template <class K, class V>
-void RedBlackTree<K, V>::clear()
+template <class K, class V, class Prefetch, bool Compact>
+void RedBlackTree<K, V, Prefetch, Compact>::clear()
 {
     postOrder([](node_ptr t){delete t;});
+
+    mRoot = NULL;
+    mTreeSize = 0;
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::elem_ptr
-RedBlackTree<K, V>::find(const K & key) const
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::elem_ptr
+RedBlackTree<K, V, Prefetch, Compact>::find(const K & key) const
 {
     node_ptr p = this->mRoot;
 
     while (p != NULL)
     {
+        // Prefetch both children while the key of p is compared.
+        Prefetch::range(p->left(), sizeof(node_type));
+        Prefetch::range(p->right(), sizeof(node_type));
+
         if (key < p->element.first)
-            p = p->leftChild;
+            p = p->left();
         else if (key > p->element.first)
-            p = p->rightChild;
+            p = p->right();
         else
             return &p->element;
     }
@@ -206,42 +377,270 @@ RedBlackTree<K, V>::find(const K & key) const
     return NULL;
 }
 
-template <class K, class V>
-void RedBlackTree<K, V>::insert(const K & key, const V & value)
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::iterator
+RedBlackTree<K, V, Prefetch, Compact>::begin() const
+{
+    return iterator::first(&mRoot);
+}
+
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::iterator
+RedBlackTree<K, V, Prefetch, Compact>::end() const
+{
+    return iterator(&mRoot);
+}
+
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::iterator
+RedBlackTree<K, V, Prefetch, Compact>::lower_bound(const K & key) const
 {
-    mRoot = insertRecursion(mRoot, key, value);
+    return iterator::lowerBound(&mRoot, key);
+}
+
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::iterator
+RedBlackTree<K, V, Prefetch, Compact>::upper_bound(const K & key) const
+{
+    return iterator::upperBound(&mRoot, key);
+}
+
+template <class K, class V, class Prefetch, bool Compact>
+std::pair<typename RedBlackTree<K, V, Prefetch, Compact>::iterator, typename RedBlackTree<K, V, Prefetch, Compact>::iterator>
+RedBlackTree<K, V, Prefetch, Compact>::equal_range(const K & key) const
+{
+    iterator first = lower_bound(key);
+    iterator last = first;
+    if (first != end() && !(key < first->first))
+        ++last;
+
+    return std::make_pair(first, last);
+}
+
+// The element with index rank in key order, counting from 0, or NULL when
+// there are not that many elements.
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::elem_ptr
+RedBlackTree<K, V, Prefetch, Compact>::select(size_type rank) const
+{
+    node_ptr p = this->mRoot;
+
+    while (p != NULL)
+    {
+        size_type left = getSubtreeSize(p->left());
+
+        if (rank < left)
+            p = p->left();
+        else if (rank > left)
+        {
+            rank -= left + 1;
+            p = p->right();
+        }
+        else
+            return &p->element;
+    }
+
+    return NULL;
+}
+
+// Number of keys less than key, whether key is present or not.
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::size_type
+RedBlackTree<K, V, Prefetch, Compact>::rank(const K & key) const
+{
+    size_type result = 0;
+    node_ptr p = this->mRoot;
+
+    while (p != NULL)
+    {
+        if (key < p->element.first)
+            p = p->left();
+        else if (key > p->element.first)
+        {
+            result += getSubtreeSize(p->left()) + 1;
+            p = p->right();
+        }
+        else
+            return result + getSubtreeSize(p->left());
+    }
+
+    return result;
+}
+
+// Inserting a present key replaces its value. The new node is red, so the
+// only rule it can break is a red parent; recoloring moves that two levels
+// up, and the first rotation ends it.
+template <class K, class V, class Prefetch, bool Compact>
+void RedBlackTree<K, V, Prefetch, Compact>::insert(const K & key, const V & value)
+{
+    node_ptr path[MAX_HEIGHT];
+    size_t depth = 0;
+
+    node_ptr t = mRoot;
+    while (t != NULL)
+    {
+        if (key < t->element.first)
+        {
+            path[depth++] = t;
+            t = t->left();
+        }
+        else if (key > t->element.first)
+        {
+            path[depth++] = t;
+            t = t->right();
+        }
+        else
+        {
+            t->element.second = value;
+            return;
+        }
+    }
+
+    t = new node_type(elem_type(key, value), color_type::RED);
+    if (depth == 0)
+        mRoot = t;
+    else if (key < path[depth - 1]->element.first)
+        path[depth - 1]->setLeft(t);
+    else
+        path[depth - 1]->setRight(t);
+
+    mTreeSize++;
+    for (size_t level = 0; level < depth; level++)
+        path[level]->subtreeSize++;
+
+    // t is red; while its parent is red too, the grandparent is black.
+    while (depth >= 2 && getColor(path[depth - 1]) == color_type::RED)
+    {
+        node_ptr grandParent = path[depth - 2];
+        depth -= 2;
+
+        t = insertAdjust(grandParent);
+        replaceChild(depth > 0 ? path[depth - 1] : NULL, grandParent, t);
+
+        if (t != grandParent)
+            break;
+    }
 
     adjustRoot();
 }
 
-template <class K, class V>
-void RedBlackTree<K, V>::erase(const K & key)
+// A node with two children is replaced by its predecessor, so the node
+// taken out of the tree has at most one child. Taking out a black node
+// leaves its side one black short; a red child repays that at once,
+// otherwise the shortage moves up until a rotation or a red parent
+// absorbs it.
+template <class K, class V, class Prefetch, bool Compact>
+void RedBlackTree<K, V, Prefetch, Compact>::erase(const K & key)
 {
-    mRoot = eraseRecursion(mRoot, key);
+    node_ptr path[MAX_HEIGHT];
+    size_t depth = 0;
+
+    node_ptr t = mRoot;
+    while (t != NULL)
+    {
+        if (key < t->element.first)
+        {
+            path[depth++] = t;
+            t = t->left();
+        }
+        else if (key > t->element.first)
+        {
+            path[depth++] = t;
+            t = t->right();
+        }
+        else
+            break;
+    }
+
+    if (t == NULL)
+        return;
+
+    node_ptr target = t;
+    size_t targetDepth = depth;
+
+    if (target->left() != NULL && target->right() != NULL)
+    {
+        path[depth++] = target;
+        t = target->left();
+        while (t->right() != NULL)
+        {
+            path[depth++] = t;
+            t = t->right();
+        }
+    }
+
+    node_ptr child = t->left() != NULL ? t->left() : t->right();
+    node_ptr parent = depth > 0 ? path[depth - 1] : NULL;
+    bool leftShort = parent != NULL && parent->left() == t;
+    color_type removed = t->getColor();
+
+    replaceChild(parent, t, child);
+
+    if (t != target)
+    {
+        t->setLeft(target->left());
+        t->setRight(target->right());
+        t->setColor(target->getColor());
+        t->setBlackCount(target->getBlackCount());
+        t->subtreeSize = target->subtreeSize;
+
+        replaceChild(targetDepth > 0 ? path[targetDepth - 1] : NULL, target, t);
+        path[targetDepth] = t;
+    }
+
+    delete target;
+    mTreeSize--;
+    for (size_t level = 0; level < depth; level++)
+        path[level]->subtreeSize--;
+
+    if (removed == color_type::RED)
+        return;
+
+    if (getColor(child) == color_type::RED)
+    {
+        child->setColor(color_type::BLACK);
+        return;
+    }
+
+    while (depth > 0)
+    {
+        parent = path[--depth];
+        node_ptr grandParent = depth > 0 ? path[depth - 1] : NULL;
+        color_type parentColor = parent->getColor();
+
+        t = eraseAdjust(parent, leftShort);
+        replaceChild(grandParent, parent, t);
+
+        // Only a recolored black parent passes the shortage on.
+        if (t != parent || parentColor == color_type::RED)
+            break;
+
+        leftShort = grandParent != NULL && grandParent->left() == parent;
+    }
 
     adjustRoot();
 }
 
-template <class K, class V>
-void RedBlackTree<K, V>::preOrder(void (* visit) (node_ptr))
+template <class K, class V, class Prefetch, bool Compact>
+void RedBlackTree<K, V, Prefetch, Compact>::preOrder(void (* visit) (node_ptr))
 {
     preOrderRecursion(this->mRoot, visit);
 }
 
-template <class K, class V>
-void RedBlackTree<K, V>::inOrder(void (* visit) (node_ptr))
+template <class K, class V, class Prefetch, bool Compact>
+void RedBlackTree<K, V, Prefetch, Compact>::inOrder(void (* visit) (node_ptr))
 {
     inOrderRecursion(this->mRoot, visit);
 }
 
-template <class K, class V>
-void RedBlackTree<K, V>::postOrder(void (* visit) (node_ptr))
+template <class K, class V, class Prefetch, bool Compact>
+void RedBlackTree<K, V, Prefetch, Compact>::postOrder(void (* visit) (node_ptr))
 {
     postOrderRecursion(this->mRoot, visit);
 }
 
-template <class K, class V>
-void RedBlackTree<K, V>::levelOrder(void (* visit) (node_ptr))
+template <class K, class V, class Prefetch, bool Compact>
+void RedBlackTree<K, V, Prefetch, Compact>::levelOrder(void (* visit) (node_ptr))
 {
     std::list<node_ptr> l;
     node_ptr t = this->mRoot;
@@ -250,10 +649,10 @@ void RedBlackTree<K, V>::levelOrder(void (* visit) (node_ptr))
     {
         visit(t);
 
-        if (t->leftChild != NULL)
-            l.push_back(t->leftChild);
-        if (t->rightChild != NULL)
-            l.push_back(t->rightChild);
+        if (t->left() != NULL)
+            l.push_back(t->left());
+        if (t->right() != NULL)
+            l.push_back(t->right());
 
         if (l.empty())
             return;
@@ -263,150 +662,196 @@ void RedBlackTree<K, V>::levelOrder(void (* visit) (node_ptr))
     }
 }
 
-template <class K, class V>
-void RedBlackTree<K, V>::adjustRoot()
+// Copies the elements into a read-only index for faster searches; later
+// changes to the tree do not reach it.
+template <class K, class V, class Prefetch, bool Compact>
+EytzingerIndex<K, V> RedBlackTree<K, V, Prefetch, Compact>::freeze() const
 {
-    if (getColor(mRoot) == color_type::RED)
-        mRoot->color = color_type::BLACK;
+    std::vector<std::pair<K, V> > elements;
+    elements.reserve(this->mTreeSize);
+    freezeRecursion(this->mRoot, elements);
+
+    return EytzingerIndex<K, V>(elements.begin(), elements.end());
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::color_type
-RedBlackTree<K, V>::getColor(node_ptr t)
+// Appends the elements of other, which must all be greater than the keys
+// here, and leaves other empty.
+template <class K, class V, class Prefetch, bool Compact>
+void RedBlackTree<K, V, Prefetch, Compact>::join(RedBlackTree & other)
 {
-    if (t == NULL)
-        return color_type::BLACK;
+    adopt(concat(piece(mRoot), piece(other.mRoot)).root, other);
+}
+
+// Moves the elements with keys from key upwards into other, replacing
+// what other held.
+template <class K, class V, class Prefetch, bool Compact>
+void RedBlackTree<K, V, Prefetch, Compact>::split(const K & key, RedBlackTree & other)
+{
+    other.clear();
 
-    return t->color;
+    Piece less, greater;
+    node_ptr middle = splitNodes(piece(mRoot), key, less, greater);
+    if (middle != NULL)
+        greater = joinNodes(piece(NULL), middle, greater);
+
+    mRoot = less.root;
+    mTreeSize = getSubtreeSize(less.root);
+    adjustRoot();
+
+    other.adopt(greater.root, other);
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::size_type
-RedBlackTree<K, V>::countColor(node_ptr t, color_type color)
+// The set operations take the nodes of other, which is left empty, and
+// work in O(m log(n/m + 1)) for sizes m <= n. With a pool, the two halves
+// of each step run in parallel while they are big enough to pay for it.
+//
+// For keys in both trees the union keeps the value from other.
+template <class K, class V, class Prefetch, bool Compact>
+void RedBlackTree<K, V, Prefetch, Compact>::unionWith(RedBlackTree & other)
 {
-    if (t == NULL)
-        return 0;
+    adopt(unionRecursion(piece(mRoot), piece(other.mRoot), NULL).root, other);
+}
 
-    size_type result = getColor(t->leftChild) == color ? 1 : 0;
-    result += getColor(t->rightChild) == color ? 1 : 0;
+template <class K, class V, class Prefetch, bool Compact>
+void RedBlackTree<K, V, Prefetch, Compact>::unionWith(RedBlackTree & other, ForkJoinPool & pool)
+{
+    adopt(unionRecursion(piece(mRoot), piece(other.mRoot), &pool).root, other);
+}
 
-    return result;
+// Keeps the elements whose keys are also in other, with their values here.
+template <class K, class V, class Prefetch, bool Compact>
+void RedBlackTree<K, V, Prefetch, Compact>::intersectWith(RedBlackTree & other)
+{
+    adopt(intersectRecursion(piece(mRoot), piece(other.mRoot), NULL).root, other);
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::size_type
-RedBlackTree<K, V>::getBlackCount(node_ptr t)
+template <class K, class V, class Prefetch, bool Compact>
+void RedBlackTree<K, V, Prefetch, Compact>::intersectWith(RedBlackTree & other, ForkJoinPool & pool)
 {
-    if (t == NULL)
-        return 0;
+    adopt(intersectRecursion(piece(mRoot), piece(other.mRoot), &pool).root, other);
+}
+
+// Drops the elements whose keys are in other.
+template <class K, class V, class Prefetch, bool Compact>
+void RedBlackTree<K, V, Prefetch, Compact>::differenceWith(RedBlackTree & other)
+{
+    adopt(differenceRecursion(piece(mRoot), piece(other.mRoot), NULL).root, other);
+}
+
+template <class K, class V, class Prefetch, bool Compact>
+void RedBlackTree<K, V, Prefetch, Compact>::differenceWith(RedBlackTree & other, ForkJoinPool & pool)
+{
+    adopt(differenceRecursion(piece(mRoot), piece(other.mRoot), &pool).root, other);
+}
 
-    return t->blackCount;
+template <class K, class V, class Prefetch, bool Compact>
+void RedBlackTree<K, V, Prefetch, Compact>::adjustRoot()
+{
+    if (getColor(mRoot) == color_type::RED)
+        mRoot->setColor(color_type::BLACK);
 }
 
-template <class K, class V>
-int RedBlackTree<K, V>::getBlackFactor(node_ptr t)
+// Takes root as the whole tree once other has given up its nodes.
+template <class K, class V, class Prefetch, bool Compact>
+void RedBlackTree<K, V, Prefetch, Compact>::adopt(node_ptr root, RedBlackTree & other)
 {
-    size_type l = getBlackCount(t->leftChild);
-    size_type r = getBlackCount(t->rightChild);
+    other.mRoot = NULL;
+    other.mTreeSize = 0;
 
-    l += getColor(t->leftChild) == color_type::BLACK;
-    r += getColor(t->rightChild) == color_type::BLACK;
+    mRoot = root;
+    mTreeSize = getSubtreeSize(root);
+    adjustRoot();
+}
 
-    return l - r;
+template <class K, class V, class Prefetch, bool Compact>
+void RedBlackTree<K, V, Prefetch, Compact>::replaceChild(node_ptr parent,
+        node_ptr child, node_ptr replacement)
+{
+    if (parent == NULL)
+        mRoot = replacement;
+    else if (parent->left() == child)
+        parent->setLeft(replacement);
+    else
+        parent->setRight(replacement);
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::size_type
-RedBlackTree<K, V>::heightRecursion(node_ptr t)
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::color_type
+RedBlackTree<K, V, Prefetch, Compact>::getColor(node_ptr t)
 {
     if (t == NULL)
-        return 0;
+        return color_type::BLACK;
 
-    size_type l = heightRecursion(t->leftChild);
-    size_type r = heightRecursion(t->rightChild);
-    return std::max(l, r) + 1;
+    return t->getColor();
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::size_type
-RedBlackTree<K, V>::updateBlackCount(node_ptr t)
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::size_type
+RedBlackTree<K, V, Prefetch, Compact>::countColor(node_ptr t, color_type color)
 {
-    size_type result = getBlackCount(t->leftChild);
-    result += getColor(t->leftChild) == color_type::BLACK;
+    if (t == NULL)
+        return 0;
+
+    size_type result = getColor(t->left()) == color ? 1 : 0;
+    result += getColor(t->right()) == color ? 1 : 0;
 
-    t->blackCount = result;
     return result;
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::node_ptr
-RedBlackTree<K, V>::insertRecursion(node_ptr t, const K & key, const V & value)
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::size_type
+RedBlackTree<K, V, Prefetch, Compact>::getBlackCount(node_ptr t)
 {
     if (t == NULL)
-        return new node_type(elem_type(key, value), color_type::RED);
-
-    if (key < t->element.first)
-        t->leftChild = insertRecursion(t->leftChild, key, value);
-    else
-        t->rightChild = insertRecursion(t->rightChild, key, value);
+        return 0;
 
-    return insertAdjustRecursion(t);
+    return t->getBlackCount();
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::node_ptr
-RedBlackTree<K, V>::eraseRecursion(node_ptr t, const K & key)
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::size_type
+RedBlackTree<K, V, Prefetch, Compact>::getSubtreeSize(node_ptr t)
 {
     if (t == NULL)
-        return t;
+        return 0;
 
-    if (key < t->element.first)
-        t->leftChild = eraseRecursion(t->leftChild, key);
-    else if (key > t->element.first)
-        t->rightChild = eraseRecursion(t->rightChild, key);
-    else if (t->leftChild == NULL)
-    {
-        node_ptr newRoot = t->rightChild;
+    return t->subtreeSize;
+}
 
-        delete t;
-        return newRoot;
-    }
-    else
-    {
-        node_ptr newRoot;
-        t->leftChild = eraseLargest(t->leftChild, newRoot);
-        newRoot->leftChild = t->leftChild;
-        newRoot->rightChild = t->rightChild;
+template <class K, class V, class Prefetch, bool Compact>
+void RedBlackTree<K, V, Prefetch, Compact>::updateSubtreeSize(node_ptr t)
+{
+    t->subtreeSize = getSubtreeSize(t->left()) + getSubtreeSize(t->right()) + 1;
+}
 
-        delete t;
-        t = newRoot;
-    }
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::size_type
+RedBlackTree<K, V, Prefetch, Compact>::heightRecursion(node_ptr t)
+{
+    if (t == NULL)
+        return 0;
 
-    return eraseAdjustRecursion(t);
+    size_type l = heightRecursion(t->left());
+    size_type r = heightRecursion(t->right());
+    return std::max(l, r) + 1;
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::node_ptr
-RedBlackTree<K, V>::eraseLargest(node_ptr t, node_ptr & largest)
+template <class K, class V, class Prefetch, bool Compact>
+void RedBlackTree<K, V, Prefetch, Compact>::updateBlackCount(node_ptr t)
 {
-    if (t == NULL)
-        return largest = t;
+    // Counting down the left spine here would cost a path per rotation.
+    if (!node_type::STORES_BLACK_COUNT)
+        return;
 
-    if (t->rightChild == NULL)
-    {
-        largest = t;
-        return t->leftChild;
-    }
-    else
-    {
-        t->rightChild = eraseLargest(t->rightChild, largest);
-        return eraseAdjustRecursion(t);
-    }
+    size_type result = getBlackCount(t->left());
+    result += getColor(t->left()) == color_type::BLACK;
+
+    t->setBlackCount(result);
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::node_ptr
-RedBlackTree<K, V>::insertAdjustRecursion(node_ptr t)
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::node_ptr
+RedBlackTree<K, V, Prefetch, Compact>::insertAdjust(node_ptr t)
 {
     updateBlackCount(t);
 
@@ -415,24 +860,24 @@ RedBlackTree<K, V>::insertAdjustRecursion(node_ptr t)
 
     if (countColor(t, color_type::RED) == 2)
     {
-        if (countColor(t->leftChild, color_type::RED) == 1 ||
-                countColor(t->rightChild, color_type::RED) == 1)
+        if (countColor(t->left(), color_type::RED) == 1 ||
+                countColor(t->right(), color_type::RED) == 1)
             return insertChangeColor(t);
     }
     else if (countColor(t, color_type::RED) == 1)
     {
-        if (getColor(t->leftChild) == color_type::RED)
+        if (getColor(t->left()) == color_type::RED)
         {
-            if (getColor(t->leftChild->leftChild) == color_type::RED)
+            if (getColor(t->left()->left()) == color_type::RED)
                 return insertRotateLL(t);
-            else if (getColor(t->leftChild->rightChild) == color_type::RED)
+            else if (getColor(t->left()->right()) == color_type::RED)
                 return insertRotateLR(t);
         }
         else
         {
-            if (getColor(t->rightChild->leftChild) == color_type::RED)
+            if (getColor(t->right()->left()) == color_type::RED)
                 return insertRotateRL(t);
-            else if (getColor(t->rightChild->rightChild) == color_type::RED)
+            else if (getColor(t->right()->right()) == color_type::RED)
                 return insertRotateRR(t);
         }
     }
@@ -440,130 +885,128 @@ RedBlackTree<K, V>::insertAdjustRecursion(node_ptr t)
     return t;
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::node_ptr
-RedBlackTree<K, V>::eraseAdjustRecursion(node_ptr t)
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::node_ptr
+RedBlackTree<K, V, Prefetch, Compact>::eraseAdjust(node_ptr t, bool leftShort)
 {
-    if (getBlackFactor(t) == -1)
+    if (leftShort)
     {
-        if (getColor(t->rightChild) == color_type::BLACK)
-            if (countColor(t->rightChild, color_type::RED) == 0)
+        if (getColor(t->right()) == color_type::BLACK)
+            if (countColor(t->right(), color_type::RED) == 0)
                 return eraseChangeColorLb(t);
-            else if (getColor(t->rightChild->leftChild) == color_type::BLACK)
+            else if (getColor(t->right()->left()) == color_type::BLACK)
                 return eraseRotateLb1(t);
             else 
                 return eraseRotateLb2(t);
         else
-            if (countColor(t->rightChild->leftChild, color_type::RED) == 0)
+            if (countColor(t->right()->left(), color_type::RED) == 0)
                 return eraseRotateLr0(t);
-            else if (getColor(t->rightChild->leftChild->leftChild) == color_type::BLACK)
+            else if (getColor(t->right()->left()->left()) == color_type::BLACK)
                 return eraseRotateLr1(t);
             else
                 return eraseRotateLr2(t);
     }
-    else if (getBlackFactor(t) == 1)
+    else
     {
-        if (getColor(t->leftChild) == color_type::BLACK)
-            if (countColor(t->leftChild, color_type::RED) == 0)
+        if (getColor(t->left()) == color_type::BLACK)
+            if (countColor(t->left(), color_type::RED) == 0)
                 return eraseChangeColorRb(t);
-            else if (getColor(t->leftChild->rightChild) == color_type::BLACK)
+            else if (getColor(t->left()->right()) == color_type::BLACK)
                 return eraseRotateRb1(t);
             else 
                 return eraseRotateRb2(t);
         else
-            if (countColor(t->leftChild->rightChild, color_type::RED) == 0)
+            if (countColor(t->left()->right(), color_type::RED) == 0)
                 return eraseRotateRr0(t);
-            else if (getColor(t->leftChild->rightChild->rightChild) == color_type::BLACK)
+            else if (getColor(t->left()->right()->right()) == color_type::BLACK)
                 return eraseRotateRr1(t);
             else
                 return eraseRotateRr2(t);
     }
-
-    return t;
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::node_ptr
-RedBlackTree<K, V>::insertChangeColor(node_ptr t)
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::node_ptr
+RedBlackTree<K, V, Prefetch, Compact>::insertChangeColor(node_ptr t)
 {
-    t->color = color_type::RED;
-    t->leftChild->color = color_type::BLACK;
-    t->rightChild->color = color_type::BLACK;
+    t->setColor(color_type::RED);
+    t->left()->setColor(color_type::BLACK);
+    t->right()->setColor(color_type::BLACK);
 
     updateBlackCount(t);
     return t;
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::node_ptr
-RedBlackTree<K, V>::insertRotateLL(node_ptr t)
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::node_ptr
+RedBlackTree<K, V, Prefetch, Compact>::insertRotateLL(node_ptr t)
 {
-    t->color = color_type::RED;
-    t->leftChild->color = color_type::BLACK;
+    t->setColor(color_type::RED);
+    t->left()->setColor(color_type::BLACK);
 
     return rotateRight(t);
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::node_ptr
-RedBlackTree<K, V>::insertRotateLR(node_ptr t)
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::node_ptr
+RedBlackTree<K, V, Prefetch, Compact>::insertRotateLR(node_ptr t)
 {
-    t->color = color_type::RED;
-    t->leftChild->rightChild->color = color_type::BLACK;
+    t->setColor(color_type::RED);
+    t->left()->right()->setColor(color_type::BLACK);
     
-    t->leftChild = rotateLeft(t->leftChild);
+    t->setLeft(rotateLeft(t->left()));
     return rotateRight(t);
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::node_ptr
-RedBlackTree<K, V>::insertRotateRL(node_ptr t)
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::node_ptr
+RedBlackTree<K, V, Prefetch, Compact>::insertRotateRL(node_ptr t)
 {
-    t->color = color_type::RED;
-    t->rightChild->leftChild->color = color_type::BLACK;
+    t->setColor(color_type::RED);
+    t->right()->left()->setColor(color_type::BLACK);
     
-    t->rightChild = rotateRight(t->rightChild);
+    t->setRight(rotateRight(t->right()));
     return rotateLeft(t);
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::node_ptr
-RedBlackTree<K, V>::insertRotateRR(node_ptr t)
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::node_ptr
+RedBlackTree<K, V, Prefetch, Compact>::insertRotateRR(node_ptr t)
 {
-    t->color = color_type::RED;
-    t->rightChild->color = color_type::BLACK;
+    t->setColor(color_type::RED);
+    t->right()->setColor(color_type::BLACK);
     return rotateLeft(t);
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::node_ptr
-RedBlackTree<K, V>::eraseChangeColorLb(node_ptr t)
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::node_ptr
+RedBlackTree<K, V, Prefetch, Compact>::eraseChangeColorLb(node_ptr t)
 {
-    t->color = color_type::BLACK;
-    t->rightChild->color = color_type::RED;
+    t->setColor(color_type::BLACK);
+    t->right()->setColor(color_type::RED);
 
     updateBlackCount(t);
     return t;
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::node_ptr
-RedBlackTree<K, V>::eraseChangeColorRb(node_ptr t)
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::node_ptr
+RedBlackTree<K, V, Prefetch, Compact>::eraseChangeColorRb(node_ptr t)
 {
-    t->color = color_type::BLACK;
-    t->leftChild->color = color_type::RED;
+    t->setColor(color_type::BLACK);
+    t->left()->setColor(color_type::RED);
 
     updateBlackCount(t);
     return t;
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::node_ptr
-RedBlackTree<K, V>::eraseRotateLb1(node_ptr t)
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::node_ptr
+RedBlackTree<K, V, Prefetch, Compact>::eraseRotateLb1(node_ptr t)
 {
-    t->rightChild->color = t->color;
-    t->color = color_type::BLACK;
-    t->rightChild->rightChild->color = color_type::BLACK;
+    t->right()->setColor(t->getColor());
+    t->setColor(color_type::BLACK);
+    t->right()->right()->setColor(color_type::BLACK);
 
     node_ptr newRoot = rotateLeft(t);
     updateBlackCount(t);
@@ -572,14 +1015,14 @@ RedBlackTree<K, V>::eraseRotateLb1(node_ptr t)
     return newRoot;
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::node_ptr
-RedBlackTree<K, V>::eraseRotateLb2(node_ptr t)
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::node_ptr
+RedBlackTree<K, V, Prefetch, Compact>::eraseRotateLb2(node_ptr t)
 {
-    t->rightChild->leftChild->color = t->color;
-    t->color = color_type::BLACK;
+    t->right()->left()->setColor(t->getColor());
+    t->setColor(color_type::BLACK);
 
-    t->rightChild = rotateRight(t->rightChild);
+    t->setRight(rotateRight(t->right()));
     node_ptr newRoot = rotateLeft(t);
     updateBlackCount(t);
     updateBlackCount(newRoot);
@@ -587,13 +1030,13 @@ RedBlackTree<K, V>::eraseRotateLb2(node_ptr t)
     return newRoot;
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::node_ptr
-RedBlackTree<K, V>::eraseRotateRb1(node_ptr t)
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::node_ptr
+RedBlackTree<K, V, Prefetch, Compact>::eraseRotateRb1(node_ptr t)
 {
-    t->leftChild->color = t->color;
-    t->color = color_type::BLACK;
-    t->leftChild->leftChild->color = color_type::BLACK;
+    t->left()->setColor(t->getColor());
+    t->setColor(color_type::BLACK);
+    t->left()->left()->setColor(color_type::BLACK);
 
     node_ptr newRoot = rotateRight(t);
     updateBlackCount(t);
@@ -602,14 +1045,14 @@ RedBlackTree<K, V>::eraseRotateRb1(node_ptr t)
     return newRoot;
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::node_ptr
-RedBlackTree<K, V>::eraseRotateRb2(node_ptr t)
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::node_ptr
+RedBlackTree<K, V, Prefetch, Compact>::eraseRotateRb2(node_ptr t)
 {
-    t->leftChild->rightChild->color = t->color;
-    t->color = color_type::BLACK;
+    t->left()->right()->setColor(t->getColor());
+    t->setColor(color_type::BLACK);
 
-    t->leftChild = rotateLeft(t->leftChild);
+    t->setLeft(rotateLeft(t->left()));
     node_ptr newRoot = rotateRight(t);
     updateBlackCount(t);
     updateBlackCount(newRoot);
@@ -617,12 +1060,12 @@ RedBlackTree<K, V>::eraseRotateRb2(node_ptr t)
     return newRoot;
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::node_ptr
-RedBlackTree<K, V>::eraseRotateLr0(node_ptr t)
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::node_ptr
+RedBlackTree<K, V, Prefetch, Compact>::eraseRotateLr0(node_ptr t)
 {
-    t->rightChild->color = color_type::BLACK;
-    t->rightChild->leftChild->color = color_type::RED;
+    t->right()->setColor(color_type::BLACK);
+    t->right()->left()->setColor(color_type::RED);
 
     node_ptr newRoot = rotateLeft(t);
     updateBlackCount(t);
@@ -630,13 +1073,13 @@ RedBlackTree<K, V>::eraseRotateLr0(node_ptr t)
     return newRoot;
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::node_ptr
-RedBlackTree<K, V>::eraseRotateLr1(node_ptr t)
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::node_ptr
+RedBlackTree<K, V, Prefetch, Compact>::eraseRotateLr1(node_ptr t)
 {
-    t->rightChild->leftChild->rightChild->color = color_type::BLACK;
+    t->right()->left()->right()->setColor(color_type::BLACK);
 
-    t->rightChild = rotateRight(t->rightChild);
+    t->setRight(rotateRight(t->right()));
     node_ptr newRoot = rotateLeft(t);
 
     updateBlackCount(t);
@@ -645,14 +1088,14 @@ RedBlackTree<K, V>::eraseRotateLr1(node_ptr t)
     return newRoot;
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::node_ptr
-RedBlackTree<K, V>::eraseRotateLr2(node_ptr t)
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::node_ptr
+RedBlackTree<K, V, Prefetch, Compact>::eraseRotateLr2(node_ptr t)
 {
-    t->rightChild->leftChild->leftChild->color = color_type::BLACK;
+    t->right()->left()->left()->setColor(color_type::BLACK);
 
-    t->rightChild->leftChild = rotateRight(t->rightChild->leftChild);
-    t->rightChild = rotateRight(t->rightChild);
+    t->right()->setLeft(rotateRight(t->right()->left()));
+    t->setRight(rotateRight(t->right()));
     node_ptr newRoot = rotateLeft(t);
 
     updateBlackCount(t);
@@ -661,12 +1104,12 @@ RedBlackTree<K, V>::eraseRotateLr2(node_ptr t)
     return newRoot;
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::node_ptr
-RedBlackTree<K, V>::eraseRotateRr0(node_ptr t)
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::node_ptr
+RedBlackTree<K, V, Prefetch, Compact>::eraseRotateRr0(node_ptr t)
 {
-    t->leftChild->color = color_type::BLACK;
-    t->leftChild->rightChild->color = color_type::RED;
+    t->left()->setColor(color_type::BLACK);
+    t->left()->right()->setColor(color_type::RED);
 
     node_ptr newRoot = rotateRight(t);
     updateBlackCount(t);
@@ -674,13 +1117,13 @@ RedBlackTree<K, V>::eraseRotateRr0(node_ptr t)
     return newRoot;
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::node_ptr
-RedBlackTree<K, V>::eraseRotateRr1(node_ptr t)
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::node_ptr
+RedBlackTree<K, V, Prefetch, Compact>::eraseRotateRr1(node_ptr t)
 {
-    t->leftChild->rightChild->leftChild->color = color_type::BLACK;
+    t->left()->right()->left()->setColor(color_type::BLACK);
 
-    t->leftChild = rotateLeft(t->leftChild);
+    t->setLeft(rotateLeft(t->left()));
     node_ptr newRoot = rotateRight(t);
 
     updateBlackCount(t);
@@ -689,14 +1132,14 @@ RedBlackTree<K, V>::eraseRotateRr1(node_ptr t)
     return newRoot;
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::node_ptr
-RedBlackTree<K, V>::eraseRotateRr2(node_ptr t)
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::node_ptr
+RedBlackTree<K, V, Prefetch, Compact>::eraseRotateRr2(node_ptr t)
 {
-    t->leftChild->rightChild->rightChild->color = color_type::BLACK;
+    t->left()->right()->right()->setColor(color_type::BLACK);
 
-    t->leftChild->rightChild = rotateRight(t->leftChild->rightChild);
-    t->leftChild = rotateLeft(t->leftChild);
+    t->left()->setRight(rotateLeft(t->left()->right()));
+    t->setLeft(rotateLeft(t->left()));
     node_ptr newRoot = rotateRight(t);
 
     updateBlackCount(t);
@@ -705,65 +1148,411 @@ RedBlackTree<K, V>::eraseRotateRr2(node_ptr t)
     return newRoot;
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::node_ptr
-RedBlackTree<K, V>::rotateLeft(node_ptr t)
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::node_ptr
+RedBlackTree<K, V, Prefetch, Compact>::rotateLeft(node_ptr t)
 {
-    node_ptr newRoot = t->rightChild;
-    t->rightChild = newRoot->leftChild;
-    newRoot->leftChild = t;
+    node_ptr newRoot = t->right();
+    t->setRight(newRoot->left());
+    newRoot->setLeft(t);
+
+    // Every rotation of the case helpers goes through here, which keeps
+    // the subtree sizes right without them knowing.
+    newRoot->subtreeSize = t->subtreeSize;
+    updateSubtreeSize(t);
 
     return newRoot;
 }
 
-template <class K, class V>
-typename RedBlackTree<K, V>::node_ptr
-RedBlackTree<K, V>::rotateRight(node_ptr t)
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::node_ptr
+RedBlackTree<K, V, Prefetch, Compact>::rotateRight(node_ptr t)
 {
-    node_ptr newRoot = t->leftChild;
-    t->leftChild = newRoot->rightChild;
-    newRoot->rightChild = t;
+    node_ptr newRoot = t->left();
+    t->setLeft(newRoot->right());
+    newRoot->setRight(t);
+
+    newRoot->subtreeSize = t->subtreeSize;
+    updateSubtreeSize(t);
 
     return newRoot;
 }
 
-template <class K, class V>
-void RedBlackTree<K, V>::preOrderRecursion(
+template <class K, class V, class Prefetch, bool Compact>
+void RedBlackTree<K, V, Prefetch, Compact>::preOrderRecursion(
         node_ptr t,
         void (* visit) (node_ptr))
 {
     if (t != NULL)
     {
         visit(t);
-        preOrderRecursion(t->leftChild, visit);
-        preOrderRecursion(t->rightChild, visit);
+        preOrderRecursion(t->left(), visit);
+        preOrderRecursion(t->right(), visit);
     }
 }
 
-template <class K, class V>
-void RedBlackTree<K, V>::inOrderRecursion(
+template <class K, class V, class Prefetch, bool Compact>
+void RedBlackTree<K, V, Prefetch, Compact>::inOrderRecursion(
         node_ptr t,
         void (* visit) (node_ptr))
 {
     if (t != NULL)
     {
-        inOrderRecursion(t->leftChild, visit);
+        inOrderRecursion(t->left(), visit);
         visit(t);
-        inOrderRecursion(t->rightChild, visit);
+        inOrderRecursion(t->right(), visit);
     }
 }
 
-template <class K, class V>
-void RedBlackTree<K, V>::postOrderRecursion(
+template <class K, class V, class Prefetch, bool Compact>
+void RedBlackTree<K, V, Prefetch, Compact>::postOrderRecursion(
         node_ptr t,
         void (* visit) (node_ptr))
 {
     if (t != NULL)
     {
-        postOrderRecursion(t->leftChild, visit);
-        postOrderRecursion(t->rightChild, visit);
+        postOrderRecursion(t->left(), visit);
+        postOrderRecursion(t->right(), visit);
         visit(t);
     }
 }
 
+template <class K, class V, class Prefetch, bool Compact>
+void RedBlackTree<K, V, Prefetch, Compact>::freezeRecursion(node_ptr t,
+        std::vector<std::pair<K, V> > & elements)
+{
+    if (t != NULL)
+    {
+        freezeRecursion(t->left(), elements);
+        elements.push_back(t->element);
+        freezeRecursion(t->right(), elements);
+    }
+}
+
+// Black nodes on any path down from t, counting the NULL below a leaf.
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::size_type
+RedBlackTree<K, V, Prefetch, Compact>::blackHeight(node_ptr t)
+{
+    if (t == NULL)
+        return 1;
+
+    return t->getBlackCount() + (t->getColor() == color_type::BLACK);
+}
+
+// The whole tree under t as a piece. Only the entry points call this; the
+// recursions below pass the heights along.
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::Piece
+RedBlackTree<K, V, Prefetch, Compact>::piece(node_ptr t)
+{
+    return Piece{t, blackHeight(t)};
+}
+
+// The subtrees of the root of t; below a black root they are one lower.
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::Piece
+RedBlackTree<K, V, Prefetch, Compact>::leftPiece(Piece t)
+{
+    return Piece{t.root->left(), t.height - (t.root->getColor() == color_type::BLACK)};
+}
+
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::Piece
+RedBlackTree<K, V, Prefetch, Compact>::rightPiece(Piece t)
+{
+    return Piece{t.root->right(), t.height - (t.root->getColor() == color_type::BLACK)};
+}
+
+// Makes middle a red node over left and right, whose black heights match.
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::node_ptr
+RedBlackTree<K, V, Prefetch, Compact>::link(node_ptr left, node_ptr middle, node_ptr right)
+{
+    middle->setLeft(left);
+    middle->setRight(right);
+    middle->setColor(color_type::RED);
+
+    updateSubtreeSize(middle);
+    updateBlackCount(middle);
+
+    return middle;
+}
+
+// Joins left, middle and right, in key order, into one tree. The shorter
+// tree is hung from the spine of the taller one at the level of matching
+// black height, which costs the difference of the heights; the root of the
+// result may be red. Either way the result is as high as the taller tree
+// once its root is black.
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::Piece
+RedBlackTree<K, V, Prefetch, Compact>::joinNodes(Piece left, node_ptr middle, Piece right)
+{
+    if (getColor(left.root) == color_type::RED)
+    {
+        left.root->setColor(color_type::BLACK);
+        left.height++;
+    }
+    if (getColor(right.root) == color_type::RED)
+    {
+        right.root->setColor(color_type::BLACK);
+        right.height++;
+    }
+
+    if (left.height > right.height)
+        return Piece{joinRight(left.root, left.height, middle, right.root,
+                right.height), left.height};
+    else if (left.height < right.height)
+        return Piece{joinLeft(left.root, left.height, middle, right.root,
+                right.height), right.height};
+    else
+        return Piece{link(left.root, middle, right.root), left.height};
+}
+
+// Goes down the right spine of t, of black height height, to the black
+// node as high as right, and puts middle there with right beside it. The
+// red middle may clash with a red parent; a rotation at the black node
+// above them moves the clash one level up, where it is solved the same
+// way or ends at the root, which joinNodes made black.
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::node_ptr
+RedBlackTree<K, V, Prefetch, Compact>::joinRight(node_ptr t, size_type height, node_ptr middle,
+        node_ptr right, size_type rightHeight)
+{
+    if (getColor(t) == color_type::BLACK && height == rightHeight)
+        return link(t, middle, right);
+
+    size_type childHeight = height - (getColor(t) == color_type::BLACK);
+    t->setRight(joinRight(t->right(), childHeight, middle, right, rightHeight));
+    updateSubtreeSize(t);
+
+    if (getColor(t) == color_type::BLACK &&
+            getColor(t->right()) == color_type::RED &&
+            getColor(t->right()->right()) == color_type::RED)
+    {
+        t->right()->right()->setColor(color_type::BLACK);
+
+        node_ptr newRoot = rotateLeft(t);
+        updateBlackCount(newRoot);
+        return newRoot;
+    }
+
+    return t;
+}
+
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::node_ptr
+RedBlackTree<K, V, Prefetch, Compact>::joinLeft(node_ptr left, size_type leftHeight, node_ptr middle,
+        node_ptr t, size_type height)
+{
+    if (getColor(t) == color_type::BLACK && height == leftHeight)
+        return link(left, middle, t);
+
+    size_type childHeight = height - (getColor(t) == color_type::BLACK);
+    t->setLeft(joinLeft(left, leftHeight, middle, t->left(), childHeight));
+    updateSubtreeSize(t);
+    updateBlackCount(t);
+
+    if (getColor(t) == color_type::BLACK &&
+            getColor(t->left()) == color_type::RED &&
+            getColor(t->left()->left()) == color_type::RED)
+    {
+        t->left()->left()->setColor(color_type::BLACK);
+
+        node_ptr newRoot = rotateRight(t);
+        updateBlackCount(t);
+        updateBlackCount(newRoot);
+        return newRoot;
+    }
+
+    return t;
+}
+
+// Joins two trees without a middle node by taking the largest node of
+// the left one.
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::Piece
+RedBlackTree<K, V, Prefetch, Compact>::concat(Piece left, Piece right)
+{
+    if (left.root == NULL)
+        return right;
+    if (right.root == NULL)
+        return left;
+
+    node_ptr last;
+    left = splitLast(left, last);
+
+    return joinNodes(left, last, right);
+}
+
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::Piece
+RedBlackTree<K, V, Prefetch, Compact>::splitLast(Piece t, node_ptr & last)
+{
+    Piece left = leftPiece(t);
+    Piece right = rightPiece(t);
+
+    if (right.root == NULL)
+    {
+        last = t.root;
+        return left;
+    }
+
+    right = splitLast(right, last);
+    return joinNodes(left, t.root, right);
+}
+
+// Splits t into the keys less than key and the keys greater than it, and
+// returns the node holding key itself, or NULL. Each level joins the
+// subtree it leaves behind onto one side; the joins along the way cost
+// O(log n) together, as the heights they join grow steadily.
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::node_ptr
+RedBlackTree<K, V, Prefetch, Compact>::splitNodes(Piece t, const K & key, Piece & less, Piece & greater)
+{
+    if (t.root == NULL)
+    {
+        less = greater = t;
+        return NULL;
+    }
+
+    Piece left = leftPiece(t);
+    Piece right = rightPiece(t);
+    node_ptr middle;
+
+    if (key < t.root->element.first)
+    {
+        middle = splitNodes(left, key, less, greater);
+        greater = joinNodes(greater, t.root, right);
+    }
+    else if (key > t.root->element.first)
+    {
+        middle = splitNodes(right, key, less, greater);
+        less = joinNodes(left, t.root, less);
+    }
+    else
+    {
+        less = left;
+        greater = right;
+        middle = t.root;
+    }
+
+    return middle;
+}
+
+// Splits other at the root key of t, and unites the halves on each side
+// with the subtrees of t.
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::Piece
+RedBlackTree<K, V, Prefetch, Compact>::unionRecursion(Piece t, Piece other, ForkJoinPool * pool)
+{
+    if (t.root == NULL)
+        return other;
+    if (other.root == NULL)
+        return t;
+
+    size_type work = getSubtreeSize(t.root) + getSubtreeSize(other.root);
+
+    Piece less, greater;
+    node_ptr match = splitNodes(other, t.root->element.first, less, greater);
+    if (match != NULL)
+    {
+        t.root->element.second = match->element.second;
+        delete match;
+    }
+
+    Piece left = leftPiece(t);
+    Piece right = rightPiece(t);
+    auto doLeft = [&]() { left = unionRecursion(left, less, pool); };
+    auto doRight = [&]() { right = unionRecursion(right, greater, pool); };
+    both(pool, work, doLeft, doRight);
+
+    return joinNodes(left, t.root, right);
+}
+
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::Piece
+RedBlackTree<K, V, Prefetch, Compact>::intersectRecursion(Piece t, Piece other, ForkJoinPool * pool)
+{
+    if (t.root == NULL || other.root == NULL)
+    {
+        freeRecursion(t.root);
+        freeRecursion(other.root);
+        return piece(NULL);
+    }
+
+    size_type work = getSubtreeSize(t.root) + getSubtreeSize(other.root);
+
+    Piece less, greater;
+    node_ptr match = splitNodes(other, t.root->element.first, less, greater);
+
+    Piece left = leftPiece(t);
+    Piece right = rightPiece(t);
+    auto doLeft = [&]() { left = intersectRecursion(left, less, pool); };
+    auto doRight = [&]() { right = intersectRecursion(right, greater, pool); };
+    both(pool, work, doLeft, doRight);
+
+    if (match != NULL)
+    {
+        delete match;
+        return joinNodes(left, t.root, right);
+    }
+
+    delete t.root;
+    return concat(left, right);
+}
+
+// Here t is split at the root key of other, whose node is dropped along
+// with any match.
+template <class K, class V, class Prefetch, bool Compact>
+typename RedBlackTree<K, V, Prefetch, Compact>::Piece
+RedBlackTree<K, V, Prefetch, Compact>::differenceRecursion(Piece t, Piece other, ForkJoinPool * pool)
+{
+    if (t.root == NULL || other.root == NULL)
+    {
+        freeRecursion(other.root);
+        return t;
+    }
+
+    size_type work = getSubtreeSize(t.root) + getSubtreeSize(other.root);
+
+    Piece less, greater;
+    node_ptr match = splitNodes(t, other.root->element.first, less, greater);
+    delete match;
+
+    Piece otherLeft = leftPiece(other);
+    Piece otherRight = rightPiece(other);
+    delete other.root;
+
+    auto doLeft = [&]() { less = differenceRecursion(less, otherLeft, pool); };
+    auto doRight = [&]() { greater = differenceRecursion(greater, otherRight, pool); };
+    both(pool, work, doLeft, doRight);
+
+    return concat(less, greater);
+}
+
+template <class K, class V, class Prefetch, bool Compact>
+template <class Left, class Right>
+void RedBlackTree<K, V, Prefetch, Compact>::both(ForkJoinPool * pool, size_type work, Left & left, Right & right)
+{
+    if (pool != NULL && work >= PARALLEL_GRAIN)
+        pool->invoke(left, right);
+    else
+    {
+        left();
+        right();
+    }
+}
+
+template <class K, class V, class Prefetch, bool Compact>
+void RedBlackTree<K, V, Prefetch, Compact>::freeRecursion(node_ptr t)
+{
+    if (t != NULL)
+    {
+        freeRecursion(t->left());
+        freeRecursion(t->right());
+        delete t;
+    }
+}
+
 #endif//__RED_BLACK_TREE_H__
@@ -0,0 +1,759 @@
+#ifndef __SNAPSHOT_B_TREE_H__
+#define __SNAPSHOT_B_TREE_H__
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+#include "nodeSearch.h"
+
+// B tree with O(1) copy-on-write snapshots.
+//
+// Nodes are reference counted and may be shared by the tree and any number
+// of snapshots; snapshot() only takes a reference to the root. insert and
+// erase copy the shared nodes on the paths they change (path copying), so a
+// node reachable from a snapshot is never written again. A node is freed
+// when the last tree or snapshot referring to it lets go.
+//
+// Like BTree, the tree itself has a single writer: snapshot(), insert() and
+// erase() need external synchronisation. A Snapshot can be read, copied and
+// released from any thread while the tree keeps changing.
+template <class K, class V, size_t N>
+class SnapshotBTree
+{
+    static_assert(N >= 3, "SnapshotBTree needs N >= 3");
+
+public:
+
+    struct Node
+    {
+        typedef K key_type;
+        typedef V value_type;
+        typedef Node* node_ptr;
+        typedef size_t size_type;
+
+        std::atomic<size_t> refs;
+        size_type size;
+        K keys[N];
+        node_ptr children[N + 1];
+        V values[N];
+
+        Node()
+            : refs(1), size(0), children{NULL} {}
+
+        Node(const K & key, const V & value)
+            : refs(1), size(1), children{NULL}
+        {
+            keys[0] = key;
+            values[0] = value;
+        }
+
+        Node(const K & key, const V & value, node_ptr child1, node_ptr child2)
+            : refs(1), size(1), children{child1, child2}
+        {
+            keys[0] = key;
+            values[0] = value;
+        }
+
+        // Private copy for a writer; the children gain a parent.
+        Node(const Node & other)
+            : refs(1), size(other.size), children{NULL}
+        {
+            for (size_t index = 0; index < size; index++)
+            {
+                keys[index] = other.keys[index];
+                values[index] = other.values[index];
+            }
+
+            if (other.children[0] != NULL)
+                for (size_t index = 0; index <= size; index++)
+                    children[index] = acquire(other.children[index]);
+        }
+    };
+
+    typedef Node node_type;
+    typedef node_type* node_ptr;
+    typedef K key_type;
+    typedef V value_type;
+    typedef const value_type* const_value_ptr;
+    typedef typename node_type::size_type size_type;
+
+    struct ElemChild
+    {
+        typedef typename Node::node_ptr node_ptr;
+
+        K key;
+        V value;
+        node_ptr node;
+    };
+
+    // Read-only view of the tree at the time snapshot() was called. Copies
+    // share the nodes; the last copy to go releases them.
+    class Snapshot
+    {
+    public:
+
+        Snapshot()
+            : mRoot(NULL), mTreeSize(0) {}
+
+        Snapshot(const Snapshot & other)
+            : mRoot(acquire(other.mRoot)), mTreeSize(other.mTreeSize) {}
+
+        ~Snapshot()
+        {
+            release(mRoot);
+        }
+
+        Snapshot & operator = (const Snapshot & other)
+        {
+            node_ptr root = acquire(other.mRoot);
+            release(mRoot);
+            mRoot = root;
+            mTreeSize = other.mTreeSize;
+            return *this;
+        }
+
+        size_type size() const
+        {
+            return mTreeSize;
+        }
+
+        size_type height() const
+        {
+            return heightOf(mRoot);
+        }
+
+        bool empty() const
+        {
+            return mTreeSize == 0;
+        }
+
+        const_value_ptr find(const K & key) const
+        {
+            return findRecursion(mRoot, key);
+        }
+
+        void inOrder(void (* visit) (const K &, const V &)) const
+        {
+            inOrderRecursion(mRoot, visit);
+        }
+
+    private:
+
+        friend class SnapshotBTree;
+
+        Snapshot(node_ptr root, size_type size)
+            : mRoot(root), mTreeSize(size) {}
+
+        node_ptr mRoot;
+
+        size_type mTreeSize;
+    };
+
+public:
+
+    SnapshotBTree();
+
+    ~SnapshotBTree();
+
+    size_type size() const;
+
+    size_type height() const;
+
+    bool empty() const;
+
+    const_value_ptr find(const K &) const;
+
+    Snapshot snapshot() const;
+
+    void insert(const K &, const V &);
+
+    void erase(const K &);
+
+    void clear();
+
+    void preOrder(void (*) (node_ptr));
+
+    void inOrder(void (*) (const K &, const V &));
+
+    void postOrder(void (*) (node_ptr));
+
+private:
+
+    SnapshotBTree(const SnapshotBTree &);
+
+    SnapshotBTree & operator = (const SnapshotBTree &);
+
+    static node_ptr acquire(node_ptr);
+
+    static void release(node_ptr);
+
+    static node_ptr unshare(node_ptr);
+
+    static size_type heightOf(node_ptr);
+
+    static const_value_ptr findRecursion(node_ptr, const K &);
+
+    static ElemChild insertRecursion(node_ptr, const K &, const V &, bool &);
+
+    static bool eraseRecursion(node_ptr, const K &);
+
+    static size_t searchNode(node_ptr, const K &);
+
+    static ElemChild insertToNode(node_ptr, const K &, const V &, node_ptr);
+
+    static ElemChild splitNode(node_ptr, const K &, const V &, node_ptr);
+
+    static void insertNotFull(node_ptr, const K &, const V &, node_ptr);
+
+    static void eraseLeaf(node_ptr, const K &);
+
+    static void repairNode(node_ptr, size_t);
+
+    static void borrowFromLeftBro(node_ptr, size_t);
+
+    static void borrowFromRightBro(node_ptr, size_t);
+
+    static void mergeNodes(node_ptr, size_t);
+
+    static node_ptr findLargest(node_ptr);
+
+    static void preOrderRecursion(node_ptr, void (*) (node_ptr));
+
+    static void inOrderRecursion(node_ptr, void (*) (const K &, const V &));
+
+    static void postOrderRecursion(node_ptr, void (*) (node_ptr));
+
+    node_ptr mRoot;
+
+    size_type mTreeSize;
+
+};
+
+template <class K, class V, size_t N>
+SnapshotBTree<K, V, N>::SnapshotBTree()
+    : mRoot(NULL), mTreeSize(0)
+{
+
+}
+
+template <class K, class V, size_t N>
+SnapshotBTree<K, V, N>::~SnapshotBTree()
+{
+    clear();
+}
+
+template <class K, class V, size_t N>
+typename SnapshotBTree<K, V, N>::size_type
+SnapshotBTree<K, V, N>::size() const
+{
+    return mTreeSize;
+}
+
+template <class K, class V, size_t N>
+typename SnapshotBTree<K, V, N>::size_type
+SnapshotBTree<K, V, N>::height() const
+{
+    return heightOf(mRoot);
+}
+
+template <class K, class V, size_t N>
+bool SnapshotBTree<K, V, N>::empty() const
+{
+    return mTreeSize == 0;
+}
+
+// Values may be shared with snapshots, so they are read-only here; insert
+// the key again to change its value.
+template <class K, class V, size_t N>
+typename SnapshotBTree<K, V, N>::const_value_ptr
+SnapshotBTree<K, V, N>::find(const K & key) const
+{
+    return findRecursion(mRoot, key);
+}
+
+template <class K, class V, size_t N>
+typename SnapshotBTree<K, V, N>::Snapshot
+SnapshotBTree<K, V, N>::snapshot() const
+{
+    return Snapshot(acquire(mRoot), mTreeSize);
+}
+
+// Inserting a present key replaces its value, so keys stay unique.
+template <class K, class V, size_t N>
+void SnapshotBTree<K, V, N>::insert(const K & key, const V & value)
+{
+    bool added = true;
+
+    if (mRoot == NULL)
+        mRoot = new node_type(key, value);
+    else
+    {
+        mRoot = unshare(mRoot);
+        ElemChild result = insertRecursion(mRoot, key, value, added);
+
+        if (result.node != NULL)
+        {
+            node_ptr newRoot = new node_type(result.key, result.value,
+                    mRoot, result.node);
+            mRoot = newRoot;
+        }
+    }
+
+    if (added)
+        mTreeSize++;
+}
+
+template <class K, class V, size_t N>
+void SnapshotBTree<K, V, N>::erase(const K & key)
+{
+    // Look first, so that erasing a missing key copies nothing.
+    if (findRecursion(mRoot, key) == NULL)
+        return;
+
+    mRoot = unshare(mRoot);
+    if (eraseRecursion(mRoot, key))
+        mTreeSize--;
+
+    if (mRoot->size == 0)
+    {
+        // The root is not shared, so its only child just changes hands.
+        node_ptr newRoot = mRoot->children[0];
+        delete mRoot;
+        mRoot = newRoot;
+    }
+}
+
+template <class K, class V, size_t N>
+void SnapshotBTree<K, V, N>::clear()
+{
+    release(mRoot);
+
+    mRoot = NULL;
+    mTreeSize = 0;
+}
+
+template <class K, class V, size_t N>
+void SnapshotBTree<K, V, N>::preOrder(void (* visit) (node_ptr))
+{
+    preOrderRecursion(mRoot, visit);
+}
+
+template <class K, class V, size_t N>
+void SnapshotBTree<K, V, N>::inOrder(void (* visit) (const K &, const V &))
+{
+    inOrderRecursion(mRoot, visit);
+}
+
+template <class K, class V, size_t N>
+void SnapshotBTree<K, V, N>::postOrder(void (* visit) (node_ptr))
+{
+    postOrderRecursion(mRoot, visit);
+}
+
+template <class K, class V, size_t N>
+typename SnapshotBTree<K, V, N>::node_ptr
+SnapshotBTree<K, V, N>::acquire(node_ptr t)
+{
+    if (t != NULL)
+        t->refs.fetch_add(1, std::memory_order_relaxed);
+
+    return t;
+}
+
+template <class K, class V, size_t N>
+void SnapshotBTree<K, V, N>::release(node_ptr t)
+{
+    if (t == NULL || t->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    if (t->children[0] != NULL)
+        for (size_t index = 0; index <= t->size; index++)
+            release(t->children[index]);
+
+    delete t;
+}
+
+// Returns a node the caller may write in place of t: t itself if nobody
+// else refers to it, else a private copy, dropping the caller's reference
+// to t. Only the writer creates references to nodes it can reach, so a
+// count of 1 stays 1.
+template <class K, class V, size_t N>
+typename SnapshotBTree<K, V, N>::node_ptr
+SnapshotBTree<K, V, N>::unshare(node_ptr t)
+{
+    if (t->refs.load(std::memory_order_acquire) == 1)
+        return t;
+
+    node_ptr copy = new node_type(*t);
+    release(t);
+    return copy;
+}
+
+template <class K, class V, size_t N>
+typename SnapshotBTree<K, V, N>::size_type
+SnapshotBTree<K, V, N>::heightOf(node_ptr t)
+{
+    size_type h = 0;
+
+    for (; t != NULL; t = t->children[0])
+        h++;
+
+    return h;
+}
+
+template <class K, class V, size_t N>
+typename SnapshotBTree<K, V, N>::const_value_ptr
+SnapshotBTree<K, V, N>::findRecursion(node_ptr t, const K & key)
+{
+    if (t == NULL)
+        return NULL;
+
+    size_t index = searchNode(t, key);
+
+    if (index < t->size && t->keys[index] == key)
+        return &t->values[index];
+
+    return findRecursion(t->children[index], key);
+}
+
+// t has been unshared by the caller; so is every node written below it.
+// added is cleared when key is already present and only its value changes.
+template <class K, class V, size_t N>
+typename SnapshotBTree<K, V, N>::ElemChild
+SnapshotBTree<K, V, N>::insertRecursion(node_ptr t, const K & key, const V & value,
+        bool & added)
+{
+    size_t index = searchNode(t, key);
+
+    if (index < t->size && t->keys[index] == key)
+    {
+        t->values[index] = value;
+        added = false;
+        return ElemChild{K(), V(), NULL};
+    }
+
+    if (t->children[0] == NULL)
+        return insertToNode(t, key, value, NULL);
+
+    t->children[index] = unshare(t->children[index]);
+
+    ElemChild result = insertRecursion(t->children[index], key, value, added);
+
+    if (result.node == NULL)
+        return result;
+
+    return insertToNode(t, result.key, result.value, result.node);
+}
+
+template <class K, class V, size_t N>
+bool SnapshotBTree<K, V, N>::eraseRecursion(node_ptr t, const K & key)
+{
+    size_t index = searchNode(t, key);
+
+    if (index < t->size && t->keys[index] == key)
+    {
+        if (t->children[index] == NULL)
+        {
+            eraseLeaf(t, key);
+            return true;
+        }
+        else
+        {
+            node_ptr leaf = findLargest(t->children[index]);
+            t->keys[index] = leaf->keys[leaf->size - 1];
+            t->values[index] = leaf->values[leaf->size - 1];
+            t->children[index] = unshare(t->children[index]);
+            eraseLeaf(t->children[index], t->keys[index]);
+        }
+    }
+    else
+    {
+        if (t->children[index] == NULL)
+            return false;
+
+        t->children[index] = unshare(t->children[index]);
+        if (!eraseRecursion(t->children[index], key))
+            return false;
+    }
+
+    repairNode(t, index);
+    return true;
+}
+
+template <class K, class V, size_t N>
+size_t SnapshotBTree<K, V, N>::searchNode(node_ptr t, const K & key)
+{
+    return nodeLowerBound(t->keys, t->size, key);
+}
+
+template <class K, class V, size_t N>
+typename SnapshotBTree<K, V, N>::ElemChild
+SnapshotBTree<K, V, N>::insertToNode(node_ptr t, const K & key, const V & value,
+        node_ptr child)
+{
+    if (t->size < N - 1)
+    {
+        insertNotFull(t, key, value, child);
+        return ElemChild{K(), V(), NULL};
+    }
+
+    return splitNode(t, key, value, child);
+}
+
+template <class K, class V, size_t N>
+typename SnapshotBTree<K, V, N>::ElemChild
+SnapshotBTree<K, V, N>::splitNode(node_ptr t, const K & key, const V & value,
+        node_ptr child)
+{
+    insertNotFull(t, key, value, child);
+
+    node_ptr newNode = new node_type();
+    size_t d = (N + 1) / 2 - 1;
+    ElemChild result = {t->keys[d], t->values[d], newNode};
+
+    size_t index = 0;
+    while (index + d + 1 < N)
+    {
+        newNode->keys[index] = t->keys[index + d + 1];
+        newNode->values[index] = t->values[index + d + 1];
+        newNode->children[index] = t->children[index + d + 1];
+        t->children[index + d + 1] = NULL;
+        index++;
+    }
+    newNode->children[index] = t->children[index + d + 1];
+    t->children[index + d + 1] = NULL;
+
+    newNode->size = index;
+    t->size = d;
+
+    return result;
+}
+
+template <class K, class V, size_t N>
+void SnapshotBTree<K, V, N>::insertNotFull(node_ptr t, const K & key,
+        const V & value, node_ptr child)
+{
+    size_t index = t->size;
+
+    while (index > 0 && t->keys[index - 1] > key)
+    {
+        t->keys[index] = t->keys[index - 1];
+        t->values[index] = t->values[index - 1];
+        t->children[index + 1] = t->children[index];
+        index--;
+    }
+
+    t->keys[index] = key;
+    t->values[index] = value;
+    t->children[index + 1] = child;
+    t->size++;
+}
+
+template <class K, class V, size_t N>
+void SnapshotBTree<K, V, N>::eraseLeaf(node_ptr t, const K & key)
+{
+    size_t index = searchNode(t, key);
+
+    if (t->children[0] != NULL)
+    {
+        // The element removed here is always the largest one of the
+        // subtree, so keep walking down even if an equal key shows up
+        // in an internal node.
+        while (index < t->size && !(key < t->keys[index]))
+            index++;
+
+        t->children[index] = unshare(t->children[index]);
+        eraseLeaf(t->children[index], key);
+        repairNode(t, index);
+    }
+    else
+    {
+        while (++index < t->size)
+        {
+            t->keys[index - 1] = t->keys[index];
+            t->values[index - 1] = t->values[index];
+        }
+        t->size--;
+    }
+}
+
+// The child at index is already unshared; a brother is unshared only when
+// it gives up an element or is merged.
+template <class K, class V, size_t N>
+void SnapshotBTree<K, V, N>::repairNode(node_ptr t, size_t index)
+{
+    const size_t MIN_NUM = (N - 1) / 2;
+    node_ptr x = t->children[index];
+
+    if (x->size >= MIN_NUM)
+        return;
+
+    node_ptr leftBro = index > 0 ? t->children[index - 1] : NULL;
+    node_ptr rightBro = index < t->size ? t->children[index + 1] : NULL;
+
+    if (leftBro != NULL && leftBro->size > MIN_NUM)
+    {
+        t->children[index - 1] = unshare(leftBro);
+        borrowFromLeftBro(t, index);
+    }
+    else if (rightBro != NULL && rightBro->size > MIN_NUM)
+    {
+        t->children[index + 1] = unshare(rightBro);
+        borrowFromRightBro(t, index);
+    }
+    else
+    {
+        size_t left = leftBro == NULL ? index : index - 1;
+        t->children[left] = unshare(t->children[left]);
+        t->children[left + 1] = unshare(t->children[left + 1]);
+        mergeNodes(t, left);
+    }
+}
+
+template <class K, class V, size_t N>
+void SnapshotBTree<K, V, N>::borrowFromLeftBro(node_ptr t, size_t index)
+{
+    node_ptr x = t->children[index];
+    node_ptr left = t->children[index - 1];
+
+    size_t indexL = left->size;
+    size_t indexX = x->size;
+
+    x->children[indexX + 1] = x->children[indexX];
+    while (indexX > 0)
+    {
+        x->keys[indexX] = x->keys[indexX - 1];
+        x->values[indexX] = x->values[indexX - 1];
+        x->children[indexX] = x->children[indexX - 1];
+        indexX--;
+    }
+
+    x->keys[0] = t->keys[index - 1];
+    x->values[0] = t->values[index - 1];
+    x->children[0] = left->children[indexL];
+    t->keys[index - 1] = left->keys[indexL - 1];
+    t->values[index - 1] = left->values[indexL - 1];
+    left->children[indexL] = NULL;
+
+    left->size--;
+    x->size++;
+}
+
+template <class K, class V, size_t N>
+void SnapshotBTree<K, V, N>::borrowFromRightBro(node_ptr t, size_t index)
+{
+    node_ptr x = t->children[index];
+    node_ptr right = t->children[index + 1];
+
+    size_t indexR = 1;
+    size_t indexX = x->size;
+
+    x->keys[indexX] = t->keys[index];
+    x->values[indexX] = t->values[index];
+    x->children[indexX + 1] = right->children[0];
+    t->keys[index] = right->keys[0];
+    t->values[index] = right->values[0];
+
+    while (indexR < right->size)
+    {
+        right->keys[indexR - 1] = right->keys[indexR];
+        right->values[indexR - 1] = right->values[indexR];
+        right->children[indexR - 1] = right->children[indexR];
+        indexR++;
+    }
+    right->children[indexR - 1] = right->children[indexR];
+    right->children[indexR] = NULL;
+
+    right->size--;
+    x->size++;
+}
+
+template <class K, class V, size_t N>
+void SnapshotBTree<K, V, N>::mergeNodes(node_ptr t, size_t index)
+{
+    node_ptr left = t->children[index];
+    node_ptr right = t->children[index + 1];
+    size_t indexL = left->size;
+
+    left->keys[indexL] = t->keys[index];
+    left->values[indexL++] = t->values[index];
+    while (++index < t->size)
+    {
+        t->keys[index - 1] = t->keys[index];
+        t->values[index - 1] = t->values[index];
+        t->children[index] = t->children[index + 1];
+    }
+    t->children[index] = NULL;
+    t->size--;
+
+    size_t indexR = 0;
+    while (indexR < right->size)
+    {
+        left->keys[indexL] = right->keys[indexR];
+        left->values[indexL] = right->values[indexR];
+        left->children[indexL++] = right->children[indexR++];
+    }
+    left->children[indexL] = right->children[indexR];
+    left->size = indexL;
+
+    // right is not shared: its children now belong to left.
+    delete right;
+}
+
+template <class K, class V, size_t N>
+typename SnapshotBTree<K, V, N>::node_ptr
+SnapshotBTree<K, V, N>::findLargest(node_ptr t)
+{
+    while (t->children[t->size] != NULL)
+        t = t->children[t->size];
+
+    return t;
+}
+
+template <class K, class V, size_t N>
+void SnapshotBTree<K, V, N>::preOrderRecursion(node_ptr t,
+        void (* visit) (node_ptr))
+{
+    if (t == NULL)
+        return;
+
+    visit(t);
+
+    if (t->children[0] != NULL)
+        for (size_t index = 0; index <= t->size; index++)
+            preOrderRecursion(t->children[index], visit);
+}
+
+template <class K, class V, size_t N>
+void SnapshotBTree<K, V, N>::inOrderRecursion(node_ptr t,
+        void (* visit) (const K &, const V &))
+{
+    if (t == NULL)
+        return;
+
+    size_t index = 0;
+    while (index < t->size)
+    {
+        inOrderRecursion(t->children[index], visit);
+        visit(t->keys[index], t->values[index]);
+        index++;
+    }
+    inOrderRecursion(t->children[index], visit);
+}
+
+template <class K, class V, size_t N>
+void SnapshotBTree<K, V, N>::postOrderRecursion(node_ptr t,
+        void (* visit) (node_ptr))
+{
+    if (t == NULL)
+        return;
+
+    if (t->children[0] != NULL)
+        for (size_t index = 0; index <= t->size; index++)
+            postOrderRecursion(t->children[index], visit);
+
+    visit(t);
+}
+
+#endif//__SNAPSHOT_B_TREE_H__
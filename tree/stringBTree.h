@@ -0,0 +1,579 @@
+#ifndef __STRING_B_TREE_H__
+#define __STRING_B_TREE_H__
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include "bTree.h"
+
+// Size of the node below: ends and the key area replace the key array.
+template <class V>
+struct BTreeNodeSize<std::string, V>
+{
+    static const size_t PREFIX_BYTES = 64;
+    static const size_t SUFFIX_BYTES = 16;
+
+    static constexpr size_t bytes(size_t n)
+    {
+        return roundUp(roundUp(roundUp(sizeof(size_t) +
+                (n + 1) * sizeof(uint16_t) + PREFIX_BYTES + n * SUFFIX_BYTES,
+                alignof(void *)) + (n + 1) * sizeof(void *), alignof(V)) +
+                n * sizeof(V), CACHE_LINE_SIZE);
+    }
+};
+
+// Node of BTree<std::string, V, N>, with prefix-compressed keys.
+//
+// The longest common prefix of the keys is kept once, followed by the
+// remaining suffixes, back to back in a byte area inside the node. The
+// search key is compared with the prefix once per node and with the
+// suffixes only after that, by binary search, without leaving the node.
+// Slot 0 of the area holds the prefix and slot i + 1 the suffix of key i;
+// ends[slot] is where the slot stops.
+//
+// A prefix longer than PREFIX_BYTES or a suffix longer than SUFFIX_BYTES
+// goes to a heap block of its own, and the slot holds an Overflow record
+// pointing to it instead, flagged by HEAP_SLOT in ends. Every slot fits its
+// limit, so the area, sized for N of them, never runs out.
+//
+// The prefix shrinks when a key that does not share it comes in, and grows
+// again when the first or last key leaves or the node is split.
+template <class V, size_t N>
+struct alignas(CACHE_LINE_SIZE) BTreeNode<std::string, V, N>
+{
+    typedef std::string key_type;
+    typedef V value_type;
+    typedef BTreeNode* node_ptr;
+    typedef size_t size_type;
+
+    // Keys are rebuilt from the prefix and a suffix.
+    typedef std::string key_buffer;
+
+    static const size_t PREFIX_BYTES = BTreeNodeSize<std::string, V>::PREFIX_BYTES;
+    static const size_t SUFFIX_BYTES = BTreeNodeSize<std::string, V>::SUFFIX_BYTES;
+
+    size_type size;
+    uint16_t ends[N + 1];
+    char bytes[PREFIX_BYTES + N * SUFFIX_BYTES];
+    node_ptr children[N + 1];
+    V values[N];
+
+    BTreeNode()
+        : size(0), ends{0}, children{NULL} {}
+
+    BTreeNode(const std::string & key, const V & value)
+        : size(0), ends{0}, children{NULL}
+    {
+        insertKey(0, key);
+        values[0] = value;
+        size = 1;
+    }
+
+    BTreeNode(const std::string & key, const V & value, node_ptr child1,
+            node_ptr child2)
+        : size(0), ends{0}, children{child1, child2}
+    {
+        insertKey(0, key);
+        values[0] = value;
+        size = 1;
+    }
+
+    ~BTreeNode();
+
+    std::string key(size_t) const;
+
+    const std::string & key(size_t, std::string &) const;
+
+    std::string prefix() const;
+
+    std::string suffix(size_t) const;
+
+    size_t lowerBound(const std::string &) const;
+
+    bool keyEquals(size_t index, const std::string & key) const
+    {
+        return compare(index, key) == 0;
+    }
+
+    bool keyLess(size_t index, const std::string & key) const
+    {
+        return compare(index, key) < 0;
+    }
+
+    void insertKey(size_t index, const std::string & key)
+    {
+        insertKey(index, size, key);
+    }
+
+    void eraseKey(size_t);
+
+    void setKey(size_t, const std::string &);
+
+    void assignKeys(const std::string *, size_t);
+
+    void appendKeys(const BTreeNode &, size_t, size_t);
+
+    void truncateKeys(size_t);
+
+    template <class Prefetch>
+    void prefetchKeys() const { Prefetch::range(ends, sizeof(ends) + sizeof(bytes)); }
+
+    size_t keyBytes() const;
+
+    size_t heapBytes() const;
+
+private:
+
+    static const uint16_t HEAP_SLOT = 0x8000;
+
+    static_assert(sizeof(bytes) < HEAP_SLOT, "key area too large for ends");
+
+    // A slot moved to the heap.
+    struct Overflow
+    {
+        char * data;
+        size_t length;
+    };
+
+    static_assert(sizeof(Overflow) <= SUFFIX_BYTES, "no room for an overflow slot");
+
+    // Bytes of a slot, wherever they are.
+    struct Slice
+    {
+        const char * data;
+        size_t length;
+    };
+
+    BTreeNode(const BTreeNode &);
+
+    BTreeNode & operator = (const BTreeNode &);
+
+    size_t slotBegin(size_t slot) const { return slot == 0 ? 0 : slotEnd(slot - 1); }
+
+    size_t slotEnd(size_t slot) const { return ends[slot] & ~HEAP_SLOT; }
+
+    Slice slice(size_t) const;
+
+    int compare(size_t, const std::string &) const;
+
+    int compareSuffix(size_t, const char *, size_t) const;
+
+    void insertKey(size_t, size_t, const std::string &);
+
+    static uint16_t writeSlot(char *, size_t, size_t, Slice, Slice);
+
+    void insertSlot(size_t, size_t, Slice);
+
+    void eraseSlot(size_t, size_t);
+
+    void freeSlot(size_t);
+
+    void clearPrefix();
+
+    void repack(size_t, size_t);
+
+    void growPrefix(size_t);
+};
+
+template <class V, size_t N>
+BTreeNode<std::string, V, N>::~BTreeNode()
+{
+    for (size_t slot = 0; slot <= size; slot++)
+        freeSlot(slot);
+}
+
+template <class V, size_t N>
+std::string BTreeNode<std::string, V, N>::key(size_t index) const
+{
+    std::string result;
+    return key(index, result);
+}
+
+template <class V, size_t N>
+const std::string & BTreeNode<std::string, V, N>::key(size_t index,
+        std::string & buffer) const
+{
+    Slice head = slice(0);
+    Slice tail = slice(index + 1);
+
+    buffer.assign(head.data, head.length);
+    buffer.append(tail.data, tail.length);
+    return buffer;
+}
+
+template <class V, size_t N>
+std::string BTreeNode<std::string, V, N>::prefix() const
+{
+    Slice head = slice(0);
+    return std::string(head.data, head.length);
+}
+
+template <class V, size_t N>
+std::string BTreeNode<std::string, V, N>::suffix(size_t index) const
+{
+    Slice tail = slice(index + 1);
+    return std::string(tail.data, tail.length);
+}
+
+template <class V, size_t N>
+size_t BTreeNode<std::string, V, N>::lowerBound(const std::string & key) const
+{
+    Slice head = slice(0);
+    size_t common = std::min(head.length, key.size());
+    int result = std::memcmp(head.data, key.data(), common);
+
+    // A key that leaves the prefix sorts before or after the whole node.
+    if (result > 0 || (result == 0 && key.size() < head.length))
+        return 0;
+    if (result < 0)
+        return size;
+
+    const char * rest = key.data() + head.length;
+    size_t length = key.size() - head.length;
+
+    size_t low = 0;
+    size_t high = size;
+    while (low < high)
+    {
+        size_t middle = (low + high) / 2;
+
+        if (compareSuffix(middle, rest, length) < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return low;
+}
+
+template <class V, size_t N>
+void BTreeNode<std::string, V, N>::eraseKey(size_t index)
+{
+    eraseSlot(index + 1, size + 1);
+
+    size_t count = size - 1;
+    if (count == 0)
+        clearPrefix();
+    else if (index == 0 || index == count)
+        growPrefix(count);
+}
+
+// The prefix is left as it is unless key does not share it.
+template <class V, size_t N>
+void BTreeNode<std::string, V, N>::setKey(size_t index, const std::string & key)
+{
+    eraseSlot(index + 1, size + 1);
+    insertKey(index, size - 1, key);
+}
+
+template <class V, size_t N>
+void BTreeNode<std::string, V, N>::assignKeys(const std::string * keys, size_t count)
+{
+    for (size_t slot = 0; slot <= size; slot++)
+        freeSlot(slot);
+
+    Slice head = {NULL, 0};
+    if (count > 0)
+    {
+        const std::string & first = keys[0];
+        const std::string & last = keys[count - 1];
+
+        head.data = first.data();
+        while (head.length < first.size() && head.length < last.size() &&
+                first[head.length] == last[head.length])
+            head.length++;
+    }
+
+    Slice none = {NULL, 0};
+    ends[0] = writeSlot(bytes, 0, PREFIX_BYTES, head, none);
+
+    for (size_t index = 0; index < count; index++)
+    {
+        Slice tail = {keys[index].data() + head.length, keys[index].size() - head.length};
+        ends[index + 1] = writeSlot(bytes, slotEnd(index), SUFFIX_BYTES, tail, none);
+    }
+}
+
+// Keys [first, last) of other sort after those of this node.
+template <class V, size_t N>
+void BTreeNode<std::string, V, N>::appendKeys(const BTreeNode & other,
+        size_t first, size_t last)
+{
+    if (first == last)
+        return;
+
+    std::string low = size > 0 ? key(0) : other.key(first);
+    std::string high = other.key(last - 1);
+
+    size_t common = 0;
+    while (common < low.size() && common < high.size() && low[common] == high[common])
+        common++;
+
+    Slice none = {NULL, 0};
+    if (size == 0)
+    {
+        freeSlot(0);
+        ends[0] = writeSlot(bytes, 0, PREFIX_BYTES, Slice{high.data(), common}, none);
+    }
+    else if (common < slice(0).length)
+        repack(size, common);
+
+    // Each moved key is the prefix of other and its suffix; the bytes
+    // past this node's prefix make the new suffix.
+    size_t length = slice(0).length;
+    Slice head = other.slice(0);
+
+    for (size_t index = first, slot = size + 1; index < last; index++, slot++)
+    {
+        Slice tail = other.slice(index + 1);
+        Slice part1 = none;
+        Slice part2 = tail;
+
+        if (length <= head.length)
+            part1 = Slice{head.data + length, head.length - length};
+        else
+        {
+            part2.data += length - head.length;
+            part2.length -= length - head.length;
+        }
+
+        ends[slot] = writeSlot(bytes, slotEnd(slot - 1), SUFFIX_BYTES, part1, part2);
+    }
+}
+
+template <class V, size_t N>
+void BTreeNode<std::string, V, N>::truncateKeys(size_t count)
+{
+    for (size_t slot = count + 1; slot <= size; slot++)
+        freeSlot(slot);
+
+    if (count == 0)
+        clearPrefix();
+    else
+        growPrefix(count);
+}
+
+// The area in use, overflow records included, and the heap blocks.
+template <class V, size_t N>
+size_t BTreeNode<std::string, V, N>::keyBytes() const
+{
+    return slotEnd(size) + heapBytes();
+}
+
+template <class V, size_t N>
+size_t BTreeNode<std::string, V, N>::heapBytes() const
+{
+    size_t result = 0;
+    for (size_t slot = 0; slot <= size; slot++)
+        if (ends[slot] & HEAP_SLOT)
+            result += slice(slot).length;
+
+    return result;
+}
+
+template <class V, size_t N>
+typename BTreeNode<std::string, V, N>::Slice
+BTreeNode<std::string, V, N>::slice(size_t slot) const
+{
+    size_t begin = slotBegin(slot);
+
+    if (ends[slot] & HEAP_SLOT)
+    {
+        Overflow overflow;
+        std::memcpy(&overflow, bytes + begin, sizeof(overflow));
+        return Slice{overflow.data, overflow.length};
+    }
+
+    return Slice{bytes + begin, slotEnd(slot) - begin};
+}
+
+// Three-way comparison of key(index) with key.
+template <class V, size_t N>
+int BTreeNode<std::string, V, N>::compare(size_t index, const std::string & key) const
+{
+    Slice head = slice(0);
+    size_t common = std::min(head.length, key.size());
+    int result = std::memcmp(head.data, key.data(), common);
+
+    if (result != 0)
+        return result;
+    if (key.size() < head.length)
+        return 1;
+
+    return compareSuffix(index, key.data() + head.length, key.size() - head.length);
+}
+
+template <class V, size_t N>
+int BTreeNode<std::string, V, N>::compareSuffix(size_t index, const char * rest,
+        size_t length) const
+{
+    Slice tail = slice(index + 1);
+    int result = std::memcmp(tail.data, rest, std::min(tail.length, length));
+
+    if (result != 0)
+        return result;
+
+    return tail.length < length ? -1 : tail.length > length ? 1 : 0;
+}
+
+// Inserts key before key index of the count held.
+template <class V, size_t N>
+void BTreeNode<std::string, V, N>::insertKey(size_t index, size_t count,
+        const std::string & key)
+{
+    if (count == 0)
+    {
+        // A lone key is all prefix.
+        freeSlot(0);
+        Slice none = {NULL, 0};
+        ends[0] = writeSlot(bytes, 0, PREFIX_BYTES, Slice{key.data(), key.size()}, none);
+        ends[1] = slotEnd(0);
+        return;
+    }
+
+    Slice head = slice(0);
+    size_t common = 0;
+    while (common < head.length && common < key.size() && head.data[common] == key[common])
+        common++;
+
+    if (common < head.length)
+        repack(count, common);
+
+    insertSlot(index + 1, count + 1, Slice{key.data() + common, key.size() - common});
+}
+
+// Writes part1 and part2 as one slot starting at position and returns its
+// end for ends, moving the slot to the heap if it is longer than limit.
+template <class V, size_t N>
+uint16_t BTreeNode<std::string, V, N>::writeSlot(char * area, size_t position,
+        size_t limit, Slice part1, Slice part2)
+{
+    size_t length = part1.length + part2.length;
+    char * target = area + position;
+
+    if (length > limit)
+    {
+        Overflow overflow = {new char[length], length};
+        std::memcpy(target, &overflow, sizeof(overflow));
+        target = overflow.data;
+    }
+
+    if (part1.length > 0)
+        std::memcpy(target, part1.data, part1.length);
+    if (part2.length > 0)
+        std::memcpy(target + part1.length, part2.data, part2.length);
+
+    if (length > limit)
+        return uint16_t((position + sizeof(Overflow)) | HEAP_SLOT);
+
+    return uint16_t(position + length);
+}
+
+// Inserts a suffix slot before slot, of the slots held.
+template <class V, size_t N>
+void BTreeNode<std::string, V, N>::insertSlot(size_t slot, size_t slots, Slice tail)
+{
+    size_t position = slotBegin(slot);
+    size_t stored = tail.length > SUFFIX_BYTES ? sizeof(Overflow) : tail.length;
+
+    std::memmove(bytes + position + stored, bytes + position,
+            slotEnd(slots - 1) - position);
+    for (size_t next = slots; next > slot; next--)
+        ends[next] = ends[next - 1] + stored;
+
+    Slice none = {NULL, 0};
+    ends[slot] = writeSlot(bytes, position, SUFFIX_BYTES, tail, none);
+}
+
+template <class V, size_t N>
+void BTreeNode<std::string, V, N>::eraseSlot(size_t slot, size_t slots)
+{
+    freeSlot(slot);
+
+    size_t begin = slotBegin(slot);
+    size_t end = slotEnd(slot);
+
+    std::memmove(bytes + begin, bytes + end, slotEnd(slots - 1) - end);
+    for (size_t next = slot; next + 1 < slots; next++)
+        ends[next] = ends[next + 1] - (end - begin);
+}
+
+template <class V, size_t N>
+void BTreeNode<std::string, V, N>::freeSlot(size_t slot)
+{
+    if (ends[slot] & HEAP_SLOT)
+        delete[] slice(slot).data;
+}
+
+template <class V, size_t N>
+void BTreeNode<std::string, V, N>::clearPrefix()
+{
+    freeSlot(0);
+    ends[0] = 0;
+}
+
+// Rewrites the count keys with their first length bytes as the prefix;
+// those must be common to all of them.
+template <class V, size_t N>
+void BTreeNode<std::string, V, N>::repack(size_t count, size_t length)
+{
+    char area[sizeof(bytes)];
+    uint16_t slots[N + 1];
+
+    Slice head = slice(0);
+    Slice none = {NULL, 0};
+
+    if (length <= head.length)
+        slots[0] = writeSlot(area, 0, PREFIX_BYTES, Slice{head.data, length}, none);
+    else
+    {
+        Slice first = slice(1);
+        first.length = length - head.length;
+        slots[0] = writeSlot(area, 0, PREFIX_BYTES, head, first);
+    }
+
+    for (size_t slot = 1; slot <= count; slot++)
+    {
+        Slice tail = slice(slot);
+        Slice part1 = none;
+
+        if (length <= head.length)
+            part1 = Slice{head.data + length, head.length - length};
+        else
+        {
+            tail.data += length - head.length;
+            tail.length -= length - head.length;
+        }
+
+        size_t position = slots[slot - 1] & ~HEAP_SLOT;
+        slots[slot] = writeSlot(area, position, SUFFIX_BYTES, part1, tail);
+    }
+
+    for (size_t slot = 0; slot <= count; slot++)
+        freeSlot(slot);
+
+    std::memcpy(bytes, area, slots[count] & ~HEAP_SLOT);
+    std::memcpy(ends, slots, (count + 1) * sizeof(uint16_t));
+}
+
+// Moves the bytes that the first and last of the count keys share past
+// the prefix into it.
+template <class V, size_t N>
+void BTreeNode<std::string, V, N>::growPrefix(size_t count)
+{
+    Slice first = slice(1);
+    Slice last = slice(count);
+
+    size_t common = 0;
+    while (common < first.length && common < last.length &&
+            first.data[common] == last.data[common])
+        common++;
+
+    if (common > 0)
+        repack(count, slice(0).length + common);
+}
+
+#endif//__STRING_B_TREE_H__
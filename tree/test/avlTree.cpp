@@ -1,5 +1,6 @@
 #include <iostream>
 #include <cstdlib>
+#include <iterator>
 
 #include "avlTree.h"
 
@@ -11,11 +12,13 @@ typedef AVLTree<Key, Value>::node_type NodeType;
 typedef AVLTree<Key, Value>::node_ptr NodePtr;
 typedef AVLTree<Key, Value>::elem_type ElemType;
 typedef AVLTree<Key, Value>::elem_ptr ElemPtr;
+typedef AVLTree<Key, Value, NoPrefetch, true> CompactTree;
+typedef CompactTree::node_type CompactNode;
 
 void output(NodeType * node)
 {
     cout << " (" << node->element.first << ", " 
-        << node->element.second << ")-" << node->height;
+        << node->element.second << ")" << showpos << node->getBalance() << noshowpos;
 }
 
 void printTree(AVLTree<Key, Value> & t)
@@ -29,6 +32,64 @@ void printTree(AVLTree<Key, Value> & t)
     cout << endl;
 }
 
+int subtreeHeight(const CompactNode * node)
+{
+    if (node == NULL)
+        return 0;
+
+    return 1 + max(subtreeHeight(node->left()), subtreeHeight(node->right()));
+}
+
+int badBalances;
+
+void checkBalance(CompactNode * node)
+{
+    if (node->getBalance() !=
+            subtreeHeight(node->left()) - subtreeHeight(node->right()))
+        badBalances++;
+}
+
+void printCompact(CompactTree & t, int found)
+{
+    badBalances = 0;
+    t.preOrder(checkBalance);
+
+    cout << "compact: " << distance(t.begin(), t.end()) << " elements, "
+        << found << " found, height " << t.height() << ", "
+        << badBalances << " wrong balance factors" << endl;
+}
+
+// The compact layout keeps the balance factor in the tag bits of the
+// right child pointer; a run of inserts and erases sets it through every
+// rotation and rebalance.
+void testCompact()
+{
+    const int count = 1000;
+
+    CompactTree t;
+    for (int i = 0; i < count; i++)
+        t.insert(i * 7 % count, i);
+
+    int found = 0;
+    for (int i = 0; i < count; i++)
+        if (t.find(i * 7 % count) != NULL && t.find(i * 7 % count)->second == i)
+            found++;
+    printCompact(t, found);
+
+    for (int i = 0; i < count; i += 2)
+        t.erase(i);
+
+    found = 0;
+    for (int i = 0; i < count; i++)
+        if (t.find(i) != NULL)
+            found++;
+    printCompact(t, found);
+
+    for (int i = 1; i < count; i += 2)
+        t.erase(i);
+    printCompact(t, 0);
+}
+
 int main()
 {
     static int array[] = {0, 1, 5, 6, 8, 2, 4};
@@ -54,11 +115,32 @@ int main()
 
     cout << endl << endl;
 
+    typedef AVLTree<Key, Value>::iterator Iterator;
+
+    cout << "from 2 up:";
+    for (Iterator it = t.lower_bound(2); it != t.end(); ++it)
+        cout << " (" << it->first << ", " << it->second << ")";
+
+    cout << endl << "backwards:";
+    for (Iterator it = t.end(); it != t.begin(); )
+    {
+        --it;
+        cout << " " << it->first;
+    }
+
+    pair<Iterator, Iterator> range = t.equal_range(7);
+    cout << endl << "first above 5: " << t.upper_bound(5)->first
+        << ", elements with key 7: " << distance(range.first, range.second)
+        << endl << endl;
+
     for (int i = 0; i < size; i++)
     {
         t.erase(array[i]);
         printTree(t);
     }
 
+    cout << endl;
+    testCompact();
+
     return 0;
 }
@@ -0,0 +1,111 @@
+#include <iostream>
+#include <cstdlib>
+
+#include "bEpsilonTree.h"
+
+using namespace std;
+
+const size_t N = 4;
+const size_t BUFFER_SIZE = 4;
+
+typedef int Key;
+typedef int Value;
+typedef BEpsilonTree<Key, Value, N, BUFFER_SIZE> Tree;
+typedef Tree::node_type NodeType;
+typedef Tree::InnerNode InnerNode;
+typedef Tree::buffer_type BufferType;
+
+void output(NodeType * node)
+{
+    cout << (node->leaf ? " [" : " (");
+
+    for (size_t index = 0; index < node->keys.size(); index++)
+        cout << (index == 0 ? "" : ", ") << node->keys[index];
+
+    if (!node->leaf)
+    {
+        // Pending messages, one group per child: +key=value, -key, ~key+delta.
+        const InnerNode * inner = static_cast<const InnerNode *>(node);
+        for (size_t child = 0; child < inner->buffers.size(); child++)
+        {
+            const BufferType & buffer = inner->buffers[child];
+            cout << " |";
+            for (size_t index = 0; index < buffer.size(); index++)
+            {
+                if (buffer[index].type == Tree::MESSAGE_INSERT)
+                    cout << " +" << buffer[index].key << "=" << buffer[index].value;
+                else if (buffer[index].type == Tree::MESSAGE_ERASE)
+                    cout << " -" << buffer[index].key;
+                else
+                    cout << " ~" << buffer[index].key << "+" << buffer[index].value;
+            }
+        }
+    }
+
+    cout << (node->leaf ? "]" : ")");
+}
+
+void printTree(Tree & t)
+{
+    cout << t.height() << " pre:  ";
+    t.preOrder(output);
+    cout << endl;
+}
+
+void printFind(Tree & t, const int * list, int size)
+{
+    for (int i = 0; i < size; i++)
+    {
+        Value v;
+        if (t.find(list[i], v))
+            cout << "(" << list[i] << ", " << v << ")  ";
+        else
+            cout << list[i] << " not found  ";
+    }
+
+    cout << endl;
+}
+
+int main()
+{
+    static int insertList[] = {4, 3, 8, 9, 7, 5, 6, 1, 2, 10, 12, 11};
+    static int upsertList[] = {3, 8, 13};
+    static int eraseList[] = {8, 6, 7, 5, 3, 4, 9, 1};
+    static int size = sizeof(insertList) / sizeof (int);
+    static int upsertSize = sizeof(upsertList) / sizeof (int);
+    static int eraseSize = sizeof(eraseList) / sizeof (int);
+
+    Tree t;
+    for (int i = 0; i < size; i++)
+    {
+        t.insert(insertList[i], insertList[i]);
+        printTree(t);
+    }
+
+    cout << endl << "upsert +100:" << endl;
+    for (int i = 0; i < upsertSize; i++)
+    {
+        t.upsert(upsertList[i], 100);
+        printTree(t);
+    }
+
+    cout << endl;
+    printFind(t, insertList, size);
+    printFind(t, upsertList, upsertSize);
+    cout << endl;
+
+    for (int i = 0; i < eraseSize; i++)
+    {
+        t.erase(eraseList[i]);
+        printTree(t);
+    }
+
+    cout << endl << "flush:" << endl;
+    t.flush();
+    printTree(t);
+    cout << t.size() << " in:   ";
+    t.inOrder([](const Key & key, Value & value){cout << " (" << key << ", " << value << ")";});
+    cout << endl;
+
+    return 0;
+}
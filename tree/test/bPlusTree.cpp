@@ -0,0 +1,74 @@
+#include <iostream>
+#include <cstdlib>
+
+#include "bPlusTree.h"
+
+using namespace std;
+
+const size_t N = 3;
+
+typedef int Key;
+typedef int Value;
+typedef BPlusTree<Key, Value, N>::node_type NodeType;
+typedef BPlusTree<Key, Value, N>::node_ptr NodePtr;
+typedef BPlusTree<Key, Value, N>::value_ptr ValuePtr;
+typedef BPlusTree<Key, Value, N>::Cursor Cursor;
+
+void output(NodeType * node)
+{
+    cout << (node->leaf ? " [" : " (") << node->keys[0];
+
+    size_t index = 1;
+    while (index < node->size)
+        cout << ", " << node->keys[index++];
+
+    cout << (node->leaf ? "]" : ")");
+}
+
+void printTree(BPlusTree<Key, Value, N> & t)
+{
+    cout << t.height() << " pre:  ";
+    t.preOrder(output);
+    cout << endl << t.height() << " in:   ";
+    t.inOrder([](const Key & key, Value & value){cout << " " << key;});
+    cout << endl;
+}
+
+int main()
+{
+    static int insertList[] = {4, 3, 8, 9, 7, 5, 6};
+    static int eraseList[] = {8, 6, 7, 5, 3, 4, 9};
+    static int size = sizeof(insertList) / sizeof (int);
+
+    BPlusTree<Key, Value, N> t;
+    for (int i = 0; i < size; i++)
+    {
+        t.insert(insertList[i], insertList[i]);
+        printTree(t);
+    }
+
+    cout << endl;
+
+    for (int i = 0; i < size; i++)
+    {
+        ValuePtr v = t.find(insertList[i]);
+        if (v != NULL)
+            cout << "(" << insertList[i] << ", " << *v << ")  ";
+        else
+            cout << insertList[i] << " not found  ";
+    }
+
+    cout << endl << "range [4, 8]:";
+    for (Cursor c = t.range(4, 8); c.valid(); c.next())
+        cout << " (" << c.key() << ", " << c.value() << ")";
+
+    cout << endl << endl;
+
+    for (int i = 0; i < size; i++)
+    {
+        t.erase(eraseList[i]);
+        printTree(t);
+    }
+
+    return 0;
+}
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <cstdlib>
+#include <iterator>
 
 #include "bTree.h"
 
@@ -11,16 +12,15 @@ typedef int Key;
 typedef int Value;
 typedef BTree<Key, Value, N>::node_type NodeType;
 typedef BTree<Key, Value, N>::node_ptr NodePtr;
-typedef BTree<Key, Value, N>::elem_type ElemType;
-typedef BTree<Key, Value, N>::elem_ptr ElemPtr;
+typedef BTree<Key, Value, N>::value_ptr ValuePtr;
 
 void output(NodeType * node)
 {
-    cout << " (" << node->elements[0]->first;
+    cout << " (" << node->keys[0];
 
     size_t index = 1;
-    while (node->elements[index] != NULL)
-        cout << ", " << node->elements[index++]->first;
+    while (index < node->size)
+        cout << ", " << node->keys[index++];
 
     cout << ")";
 }
@@ -34,6 +34,21 @@ void printTree(BTree<Key, Value, N> & t)
     cout << endl;
 }
 
+void printStats(const BTreeStats & stats)
+{
+    cout << stats.elements << " elements in " << stats.nodes << " nodes, per level:";
+    for (size_t level = 0; level < stats.levelNodes.size(); level++)
+        cout << " " << stats.levelNodes[level];
+
+    cout << endl << "fill:";
+    for (size_t bucket = 0; bucket < BTreeStats::FILL_BUCKETS; bucket++)
+        cout << " " << stats.fillHistogram[bucket];
+
+    cout << endl << stats.nodeBytes << " node bytes, " << stats.elementBytes
+        << " element bytes; " << stats.splits << " splits, " << stats.merges
+        << " merges, " << stats.borrows << " borrows" << endl;
+}
+
 int main()
 {
     static int insertList[] = {4, 3, 8, 9, 7, 5, 6};
@@ -51,20 +66,104 @@ int main()
 
     for (int i = 0; i < size; i++)
     {
-        BTree<Key, Value, N>::elem_ptr e = t.find(insertList[i]);
-        if (e != NULL)
-            cout << "(" << e->first << ", " << e->second << ")  ";
+        ValuePtr v = t.find(insertList[i]);
+        if (v != NULL)
+            cout << "(" << insertList[i] << ", " << *v << ")  ";
         else
             cout << insertList[i] << " not found  ";
     }
 
     cout << endl << endl;
 
+    typedef BTree<Key, Value, N>::iterator Iterator;
+
+    cout << "from 2 up:";
+    for (Iterator it = t.lower_bound(2); it != t.end(); ++it)
+        cout << " (" << it->first << ", " << it->second << ")";
+
+    cout << endl << "backwards:";
+    for (Iterator it = t.end(); it != t.begin(); )
+    {
+        --it;
+        cout << " " << it->first;
+    }
+
+    pair<Iterator, Iterator> range = t.equal_range(7);
+    cout << endl << "first above 5: " << t.upper_bound(5)->first
+        << ", elements with key 7: " << distance(range.first, range.second)
+        << endl;
+
+    // Inserting a present key replaces its value.
+    for (int i = 1; i <= 5; i++)
+        t.insert(7, 70 + i);
+    range = t.equal_range(7);
+    cout << "7 inserted five more times: " << t.size() << " elements, "
+        << distance(range.first, range.second) << " with key 7, value "
+        << *t.find(7) << endl << endl;
+
+    printStats(t.stats());
+
+    cout << endl;
+
     for (int i = 0; i < size; i++)
     {
         t.erase(eraseList[i]);
         printTree(t);
     }
 
+    printStats(t.stats());
+
+    cout << endl;
+
+    static pair<Key, Value> sortedList[] = {
+        {1, 1}, {2, 2}, {3, 3}, {4, 4}, {5, 5}, {6, 6}, {7, 7}, {8, 8}};
+    static int sortedSize = sizeof(sortedList) / sizeof (pair<Key, Value>);
+
+    BTree<Key, Value, N> loaded(sortedList, sortedList + sortedSize);
+    printTree(loaded);
+
+    cout << endl;
+
+    static pair<Key, Value> batchList[] = {
+        {0, 0}, {9, 9}, {10, 10}, {11, 11}, {12, 12}};
+    static int batchSize = sizeof(batchList) / sizeof (pair<Key, Value>);
+
+    loaded.insertBatch(batchList, batchList + batchSize);
+    printTree(loaded);
+
+    cout << endl;
+
+    loaded.eraseRange(3, 10);
+    printTree(loaded);
+
+    cout << endl;
+
+    // Bulk loading keeps the last element of a run of equal keys.
+    static pair<Key, Value> duplicateList[] = {
+        {1, 1}, {7, 71}, {7, 72}, {7, 73}, {7, 74}, {7, 75}, {9, 9}};
+    static int duplicateSize = sizeof(duplicateList) / sizeof (pair<Key, Value>);
+
+    BTree<Key, Value, N> duplicates(duplicateList, duplicateList + duplicateSize);
+    printTree(duplicates);
+
+    range = duplicates.equal_range(7);
+    Iterator before = range.first;
+    --before;
+    cout << duplicates.size() << " elements, "
+        << distance(range.first, range.second) << " with key 7, value "
+        << range.first->second << endl << "before it: " << before->first
+        << ", after it: " << range.second->first << endl;
+
+    // Erasing a range whose ends were runs in the input.
+    static pair<Key, Value> runList[] = {
+        {1, 1}, {3, 3}, {3, 3}, {4, 4}, {6, 6}, {6, 6}, {6, 6}, {7, 7},
+        {8, 8}, {9, 9}, {9, 9}, {9, 9}, {10, 10}, {12, 12}};
+    static int runSize = sizeof(runList) / sizeof (pair<Key, Value>);
+
+    BTree<Key, Value, N> runs(runList, runList + runSize);
+    runs.eraseRange(6, 9);
+    printTree(runs);
+    cout << runs.size() << " elements after erasing [6, 9)" << endl;
+
     return 0;
 }
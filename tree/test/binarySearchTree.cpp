@@ -1,5 +1,6 @@
 #include <iostream>
 #include <cstdlib>
+#include <iterator>
 
 #include "binarySearchTree.h"
 
@@ -52,6 +53,24 @@ int main()
 
     cout << endl << endl;
 
+    typedef BinarySearchTree<Key, Value>::iterator Iterator;
+
+    cout << "from 2 up:";
+    for (Iterator it = t.lower_bound(2); it != t.end(); ++it)
+        cout << " (" << it->first << ", " << it->second << ")";
+
+    cout << endl << "backwards:";
+    for (Iterator it = t.end(); it != t.begin(); )
+    {
+        --it;
+        cout << " " << it->first;
+    }
+
+    pair<Iterator, Iterator> range = t.equal_range(7);
+    cout << endl << "first above 5: " << t.upper_bound(5)->first
+        << ", elements with key 7: " << distance(range.first, range.second)
+        << endl << endl;
+
     for (int i = 0; i < size; i++)
     {
         t.erase(array[i]);
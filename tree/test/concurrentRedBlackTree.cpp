@@ -0,0 +1,100 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+#include "concurrentRedBlackTree.h"
+
+using namespace std;
+
+typedef int Key;
+typedef int Value;
+typedef ConcurrentRedBlackTree<Key, Value> Tree;
+
+const int WRITERS = 2;
+const int READERS = 4;
+const int KEYS = 100000;
+const int STABLE_KEYS = 1000;
+
+atomic<int> errors(0);
+atomic<bool> writing(true);
+
+// Writer w owns the keys k with k % WRITERS == w: it inserts them all,
+// overwrites the even ones, erases the odd ones and checks its own view.
+void writer(Tree & t, int w)
+{
+    for (int k = w; k < KEYS; k += WRITERS)
+        t.insert(k, k);
+
+    for (int k = w; k < KEYS; k += WRITERS)
+        if (k % 2 == 1)
+            t.erase(k);
+        else
+            t.insert(k, k * 2);
+
+    for (int k = w; k < KEYS; k += WRITERS)
+    {
+        Value v;
+        bool found = t.find(k, v);
+
+        if (found != (k % 2 == 0) || (found && v != k * 2))
+            errors++;
+    }
+}
+
+// Readers look up keys the writers never touch, which must be found on
+// every version the writers publish, and keys the writers change, whose
+// values must be one of the two ever written.
+void reader(Tree & t)
+{
+    unsigned seed = 1;
+
+    while (writing.load())
+    {
+        seed = seed * 1103515245 + 12345;
+        Key k = -1 - Key(seed % STABLE_KEYS);
+        Value v;
+
+        if (!t.find(k, v) || v != k)
+            errors++;
+
+        k = Key((seed >> 8) % KEYS);
+        if (t.find(k, v) && v != k && v != k * 2)
+            errors++;
+    }
+}
+
+int main()
+{
+    Tree t;
+
+    for (Key k = -1; k >= -STABLE_KEYS; k--)
+        t.insert(k, k);
+
+    vector<thread> readers, writers;
+    for (int i = 0; i < READERS; i++)
+        readers.push_back(thread(reader, ref(t)));
+    for (int i = 0; i < WRITERS; i++)
+        writers.push_back(thread(writer, ref(t), i));
+
+    for (size_t i = 0; i < writers.size(); i++)
+        writers[i].join();
+
+    writing.store(false);
+    for (size_t i = 0; i < readers.size(); i++)
+        readers[i].join();
+
+    size_t expected = STABLE_KEYS + KEYS / 2;
+
+    cout << "size: " << t.size() << " (expected " << expected << ")" << endl;
+    cout << "height: " << t.height() << endl;
+    cout << "errors: " << errors.load() << endl;
+
+    for (Key k = -STABLE_KEYS; k < KEYS; k++)
+        t.erase(k);
+
+    cout << "size after erasing all: " << t.size() << endl;
+
+    return errors.load() == 0 && t.size() == 0 ? 0 : 1;
+}
@@ -0,0 +1,64 @@
+#include <iostream>
+#include <cstdlib>
+
+#include "redBlackTree.h"
+#include "bTree.h"
+#include "eytzinger.h"
+
+using namespace std;
+
+const size_t N = 3;
+
+typedef int Key;
+typedef int Value;
+typedef EytzingerIndex<Key, Value> Index;
+
+void printFinds(const Index & index, const int * keys, int size)
+{
+    for (int i = 0; i < size; i++)
+    {
+        Index::elem_ptr e = index.find(keys[i]);
+        if (e != NULL)
+            cout << "(" << e->first << ", " << e->second << ")  ";
+        else
+            cout << keys[i] << " not found  ";
+    }
+
+    cout << endl;
+}
+
+int main()
+{
+    static int insertList[] = {3, 1, 8, 9, 7, 4, 6, 5};
+    static int findList[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    static int size = sizeof(insertList) / sizeof (int);
+    static int findSize = sizeof(findList) / sizeof (int);
+
+    RedBlackTree<Key, Value> t;
+    for (int i = 0; i < size; i++)
+        t.insert(insertList[i], insertList[i] * 10);
+
+    Index frozen = t.freeze();
+    cout << frozen.size() << " elements frozen from a red black tree" << endl;
+    printFinds(frozen, findList, findSize);
+
+    // The index keeps the elements it was built from.
+    t.erase(4);
+    t.insert(2, 20);
+    printFinds(frozen, findList, findSize);
+
+    cout << endl;
+
+    BTree<Key, Value, N> b;
+    for (int i = 0; i < size; i++)
+        b.insert(insertList[i], insertList[i] * 100);
+
+    frozen = b.freeze();
+    cout << frozen.size() << " elements frozen from a B tree" << endl;
+    printFinds(frozen, findList, findSize);
+
+    frozen.find(9)->second = 99;
+    printFinds(frozen, findList, findSize);
+
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include <iostream>
+#include <cstdio>
+
+#include "loggedBTree.h"
+
+using namespace std;
+
+const size_t N = 3;
+
+// Commit after every four writes; checkpoints are taken by hand.
+const size_t GROUP_SIZE = 4;
+
+typedef int Key;
+typedef int Value;
+typedef LoggedBTree<Key, Value, N> Tree;
+typedef Tree::node_type NodeType;
+
+void output(NodeType * node)
+{
+    cout << " (" << node->keys[0];
+
+    size_t index = 1;
+    while (index < node->size)
+        cout << ", " << node->keys[index++];
+
+    cout << ")";
+}
+
+void printElement(const Key & key, const Value & value)
+{
+    cout << " " << key << ":" << value;
+}
+
+void printTree(Tree & t)
+{
+    cout << t.height() << " pre:  ";
+    t.preOrder(output);
+    cout << endl << t.size() << " in:   ";
+    t.inOrder(printElement);
+    cout << endl;
+}
+
+int main()
+{
+    static int insertList[] = {4, 3, 8, 9, 7, 5, 6, 1, 2, 10};
+    static int eraseList[] = {8, 6, 7};
+    static int laterList[] = {11, 12, 13};
+    static int size = sizeof(insertList) / sizeof (int);
+    static int eraseSize = sizeof(eraseList) / sizeof (int);
+    static int laterSize = sizeof(laterList) / sizeof (int);
+
+    const char * path = "loggedBTree";
+    const char * logPath = "loggedBTree.log";
+    const char * checkpointPath = "loggedBTree.checkpoint";
+    remove(logPath);
+    remove(checkpointPath);
+
+    {
+        Tree t(path, GROUP_SIZE, 0);
+        for (int i = 0; i < size; i++)
+            t.insert(insertList[i], insertList[i] * 10);
+        for (int i = 0; i < eraseSize; i++)
+            t.erase(eraseList[i]);
+        t.insert(4, 44);
+
+        printTree(t);
+    }
+
+    {
+        Tree t(path, GROUP_SIZE, 0);
+        cout << endl << "reopened, " << t.replayed() << " records replayed" << endl;
+        printTree(t);
+
+        t.checkpoint();
+        for (int i = 0; i < laterSize; i++)
+            t.insert(laterList[i], laterList[i] * 10);
+        t.commit();
+    }
+
+    // A crash in the middle of a commit leaves part of a frame behind.
+    FILE * log = fopen(logPath, "ab");
+    static const unsigned char torn[] = {0x20, 0, 0, 0, 0x12, 0x34};
+    fwrite(torn, 1, sizeof torn, log);
+    fclose(log);
+
+    {
+        Tree t(path, GROUP_SIZE, 0);
+        cout << endl << "reopened after a torn commit, " << t.replayed()
+            << " records replayed" << endl;
+        printTree(t);
+    }
+
+    remove(logPath);
+    remove(checkpointPath);
+
+    return 0;
+}
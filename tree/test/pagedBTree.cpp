@@ -0,0 +1,92 @@
+#include <iostream>
+#include <cstdio>
+
+#include "pagedBTree.h"
+
+using namespace std;
+
+// Small pages give nodes of order 6, so the demo still splits and merges.
+const size_t PAGE_SIZE = 128;
+
+typedef int Key;
+typedef int Value;
+typedef PagedBTree<Key, Value, PAGE_SIZE> Tree;
+typedef Tree::node_type NodeType;
+typedef Tree::value_ptr ValuePtr;
+
+void output(NodeType * node)
+{
+    cout << " (" << node->keys[0];
+
+    size_t index = 1;
+    while (index < node->size)
+        cout << ", " << node->keys[index++];
+
+    cout << ")";
+}
+
+void printTree(Tree & t)
+{
+    cout << t.height() << " pre:  ";
+    t.preOrder(output);
+    cout << endl << t.height() << " post: ";
+    t.postOrder(output);
+    cout << endl;
+}
+
+int main()
+{
+    static int insertList[] = {4, 3, 8, 9, 7, 5, 6, 1, 2, 10, 12, 11};
+    static int eraseList[] = {8, 6, 7, 5, 3};
+    static int size = sizeof(insertList) / sizeof (int);
+    static int eraseSize = sizeof(eraseList) / sizeof (int);
+
+    const char * path = "pagedBTree.db";
+    remove(path);
+
+    {
+        Tree t(path);
+        for (int i = 0; i < size; i++)
+        {
+            t.insert(insertList[i], insertList[i] * 10);
+            printTree(t);
+        }
+
+        cout << endl;
+
+        for (int i = 0; i < eraseSize; i++)
+        {
+            t.erase(eraseList[i]);
+            printTree(t);
+        }
+
+        // Inserting a present key replaces its value.
+        for (int i = 1; i <= 5; i++)
+            t.insert(4, 40 + i);
+        cout << "4 inserted five more times: " << t.size() << " elements, value "
+            << *t.find(4) << endl;
+
+        t.sync();
+    }
+
+    cout << endl << "reopened" << endl;
+
+    Tree t(path);
+    cout << t.size() << " elements" << endl;
+    printTree(t);
+
+    for (int i = 0; i < size; i++)
+    {
+        ValuePtr v = t.find(insertList[i]);
+        if (v != NULL)
+            cout << "(" << insertList[i] << ", " << *v << ")  ";
+        else
+            cout << insertList[i] << " not found  ";
+    }
+
+    cout << endl;
+
+    remove(path);
+
+    return 0;
+}
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <cstdlib>
+#include <iterator>
 
 #include "redBlackTree.h"
 
@@ -12,18 +13,21 @@ typedef RedBlackTree<Key, Value>::node_ptr NodePtr;
 typedef RedBlackTree<Key, Value>::elem_type ElemType;
 typedef RedBlackTree<Key, Value>::elem_ptr ElemPtr;
 typedef RedBlackTree<Key, Value>::color_type ColorType;
+typedef RedBlackTree<Key, Value, NoPrefetch, true> CompactTree;
+typedef CompactTree::node_type CompactNode;
+typedef CompactTree::color_type CompactColor;
 
 void output(NodeType * node)
 {
     cout << " (" << node->element.first << ", " 
         << node->element.second << ")";
 
-    if (node->color == ColorType::RED)
+    if (node->getColor() == ColorType::RED)
         cout << "-";
     else
         cout << "+";
 
-    cout << node->blackCount;
+    cout << node->getBlackCount();
 }
 
 void printTree(RedBlackTree<Key, Value> & t)
@@ -37,6 +41,73 @@ void printTree(RedBlackTree<Key, Value> & t)
     cout << endl;
 }
 
+// Black nodes on every path down from node, or -1 if the paths differ.
+int blackHeight(const CompactNode * node)
+{
+    if (node == NULL)
+        return 1;
+
+    int left = blackHeight(node->left());
+    int right = blackHeight(node->right());
+    if (left < 0 || left != right)
+        return -1;
+
+    return left + (node->getColor() == CompactColor::BLACK);
+}
+
+int badNodes;
+
+// Counts red nodes with a red child and nodes whose subtrees differ in
+// black height.
+void checkColors(CompactNode * node)
+{
+    bool redChild =
+            (node->left() != NULL && node->left()->getColor() == CompactColor::RED) ||
+            (node->right() != NULL && node->right()->getColor() == CompactColor::RED);
+
+    if ((node->getColor() == CompactColor::RED && redChild) || blackHeight(node) < 0)
+        badNodes++;
+}
+
+void printCompact(CompactTree & t)
+{
+    badNodes = 0;
+    t.preOrder(checkColors);
+
+    size_t selected = 0;
+    for (size_t i = 0; i < t.size(); i++)
+    {
+        CompactTree::elem_ptr e = t.select(i);
+        if (e != NULL && t.rank(e->first) == i)
+            selected++;
+    }
+
+    cout << "compact: " << t.size() << " elements, "
+        << distance(t.begin(), t.end()) << " in order, " << selected
+        << " selected, height " << t.height() << ", " << badNodes
+        << " nodes breaking the color rules" << endl;
+}
+
+// The compact layout keeps the color in the low bit of the right child
+// pointer; a run of inserts and erases recolors and rotates through it.
+void testCompact()
+{
+    const int count = 1000;
+
+    CompactTree t;
+    for (int i = 0; i < count; i++)
+        t.insert(i * 7 % count, i);
+    printCompact(t);
+
+    for (int i = 0; i < count; i += 2)
+        t.erase(i);
+    printCompact(t);
+
+    for (int i = 1; i < count; i += 2)
+        t.erase(i);
+    printCompact(t);
+}
+
 int main()
 {
     static int array[] = {3, 1, 8, 9, 7, 4, 6, 5};
@@ -62,11 +133,65 @@ int main()
 
     cout << endl << endl;
 
+    typedef RedBlackTree<Key, Value>::iterator Iterator;
+
+    cout << "from 2 up:";
+    for (Iterator it = t.lower_bound(2); it != t.end(); ++it)
+        cout << " (" << it->first << ", " << it->second << ")";
+
+    cout << endl << "backwards:";
+    for (Iterator it = t.end(); it != t.begin(); )
+    {
+        --it;
+        cout << " " << it->first;
+    }
+
+    pair<Iterator, Iterator> range = t.equal_range(7);
+    cout << endl << "first above 5: " << t.upper_bound(5)->first
+        << ", elements with key 7: " << distance(range.first, range.second)
+        << endl << endl;
+
+    for (int i = 0; i <= size; i++)
+    {
+        RedBlackTree<Key, Value>::elem_ptr e = t.select(i);
+        if (e != NULL)
+            cout << i << ": " << e->first << " has rank " << t.rank(e->first) << "  ";
+        else
+            cout << i << ": none";
+    }
+
+    cout << endl << "keys below 0, 5 and 10: " << t.rank(0) << ", " << t.rank(5)
+        << ", " << t.rank(10) << endl << endl;
+
     for (int i = 0; i < size; i++)
     {
         t.erase(array[i]);
         printTree(t);
     }
 
+    cout << endl;
+
+    static int otherArray[] = {2, 4, 6, 8, 10};
+    static int otherSize = sizeof(otherArray) / sizeof (int);
+
+    RedBlackTree<Key, Value> other;
+    for (int i = 0; i < size; i++)
+        t.insert(array[i], array[i]);
+    for (int i = 0; i < otherSize; i++)
+        other.insert(otherArray[i], otherArray[i] * 10);
+
+    t.unionWith(other);
+    printTree(t);
+
+    t.split(6, other);
+    printTree(t);
+    printTree(other);
+
+    t.join(other);
+    printTree(t);
+
+    cout << endl;
+    testCompact();
+
     return 0;
 }
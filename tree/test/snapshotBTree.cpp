@@ -0,0 +1,111 @@
+#include <iostream>
+#include <cstdlib>
+
+#include "snapshotBTree.h"
+
+using namespace std;
+
+const size_t N = 3;
+
+typedef int Key;
+typedef int Value;
+typedef SnapshotBTree<Key, Value, N> Tree;
+typedef Tree::node_type NodeType;
+typedef Tree::Snapshot Snapshot;
+
+// Nodes shared with snapshots are marked with their reference count.
+void output(NodeType * node)
+{
+    cout << " (" << node->keys[0];
+
+    size_t index = 1;
+    while (index < node->size)
+        cout << ", " << node->keys[index++];
+
+    cout << ")";
+
+    size_t refs = node->refs.load();
+    if (refs > 1)
+        cout << "*" << refs;
+}
+
+void printKey(const Key & key, const Value & value)
+{
+    cout << " " << key;
+}
+
+void printTree(Tree & t)
+{
+    cout << t.height() << " pre:  ";
+    t.preOrder(output);
+    cout << endl;
+}
+
+void printSnapshot(const char * name, const Snapshot & s)
+{
+    cout << name << " (" << s.size() << "):";
+    s.inOrder(printKey);
+    cout << endl;
+}
+
+int main()
+{
+    static int insertList[] = {4, 3, 8, 9, 7, 5, 6};
+    static int eraseList[] = {8, 6, 7};
+    static int laterList[] = {1, 2, 10};
+    static int size = sizeof(insertList) / sizeof (int);
+    static int eraseSize = sizeof(eraseList) / sizeof (int);
+    static int laterSize = sizeof(laterList) / sizeof (int);
+
+    Tree t;
+    for (int i = 0; i < size; i++)
+        t.insert(insertList[i], insertList[i]);
+    printTree(t);
+
+    Snapshot first = t.snapshot();
+    cout << endl << "snapshot first, then erase:" << endl;
+
+    for (int i = 0; i < eraseSize; i++)
+    {
+        t.erase(eraseList[i]);
+        printTree(t);
+    }
+
+    Snapshot second = t.snapshot();
+    cout << endl << "snapshot second, then insert:" << endl;
+
+    for (int i = 0; i < laterSize; i++)
+    {
+        t.insert(laterList[i], laterList[i]);
+        printTree(t);
+    }
+
+    cout << endl;
+    printSnapshot("first ", first);
+    printSnapshot("second", second);
+    cout << "tree   (" << t.size() << "):";
+    t.inOrder(printKey);
+    cout << endl;
+
+    const Value * v = first.find(8);
+    cout << "8 in first: " << (v != NULL ? "found" : "not found")
+        << ", in tree: " << (t.find(8) != NULL ? "found" : "not found") << endl;
+
+    // Inserting a present key replaces its value; the snapshot keeps the old.
+    Snapshot third = t.snapshot();
+    for (int i = 1; i <= 5; i++)
+        t.insert(5, 50 + i);
+    cout << "5 inserted five more times: " << t.size() << " elements, value "
+        << *t.find(5) << ", in third: " << *third.find(5) << endl;
+    t.erase(5);
+    cout << "5 erased: " << t.size() << " elements, "
+        << (t.find(5) != NULL ? "found" : "not found") << endl;
+    third = Snapshot();
+
+    first = Snapshot();
+    second = Snapshot();
+    cout << endl << "snapshots released:" << endl;
+    printTree(t);
+
+    return 0;
+}
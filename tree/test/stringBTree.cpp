@@ -0,0 +1,98 @@
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <iterator>
+
+#include "bTree.h"
+
+using namespace std;
+
+const size_t N = 4;
+
+typedef string Key;
+typedef int Value;
+typedef BTree<Key, Value, N>::node_type NodeType;
+typedef BTree<Key, Value, N>::value_ptr ValuePtr;
+
+// Prints the shared prefix of a node once, then the suffixes.
+void output(NodeType * node)
+{
+    cout << " [" << node->prefix() << "](" << node->suffix(0);
+
+    size_t index = 1;
+    while (index < node->size)
+        cout << ", " << node->suffix(index++);
+
+    cout << ")";
+}
+
+void printTree(BTree<Key, Value, N> & t)
+{
+    cout << t.height() << " pre:  ";
+    t.preOrder(output);
+    cout << endl;
+}
+
+int main()
+{
+    static const char * insertList[] = {
+        "/usr/lib/libc.so", "/usr/lib/libm.so", "/usr/bin/ls", "/usr/bin/cat",
+        "/usr/lib/libz.so", "/usr/share/man", "/usr/bin/cp", "/etc/hosts"};
+    static const char * eraseList[] = {
+        "/usr/bin/cat", "/usr/lib/libz.so", "/etc/hosts", "/usr/bin/ls"};
+    static int size = sizeof(insertList) / sizeof (const char *);
+    static int eraseSize = sizeof(eraseList) / sizeof (const char *);
+
+    BTree<Key, Value, N> t;
+    for (int i = 0; i < size; i++)
+    {
+        t.insert(insertList[i], i);
+        printTree(t);
+    }
+
+    cout << endl;
+
+    for (int i = 0; i < size; i++)
+    {
+        ValuePtr v = t.find(insertList[i]);
+        if (v != NULL)
+            cout << "(" << insertList[i] << ", " << *v << ")  ";
+        else
+            cout << insertList[i] << " not found  ";
+    }
+
+    cout << endl << endl;
+
+    typedef BTree<Key, Value, N>::iterator Iterator;
+
+    // Keys come out rebuilt from the node prefix and their suffix.
+    cout << "from /usr/bin/cp up:";
+    for (Iterator it = t.lower_bound("/usr/bin/cp"); it != t.end(); ++it)
+        cout << " (" << it->first << ", " << it->second << ")";
+
+    cout << endl << "backwards:";
+    for (Iterator it = t.end(); it != t.begin(); )
+    {
+        --it;
+        cout << " " << it->first;
+    }
+
+    pair<Iterator, Iterator> range = t.equal_range("/usr/lib/libm.so");
+    cout << endl << "first above /usr/lib/: " << t.upper_bound("/usr/lib/")->first
+        << ", elements with key /usr/lib/libm.so: "
+        << distance(range.first, range.second) << endl << endl;
+
+    for (int i = 0; i < eraseSize; i++)
+    {
+        t.erase(eraseList[i]);
+        printTree(t);
+    }
+
+    cout << endl;
+
+    // Everything under /usr/lib/.
+    t.eraseRange("/usr/lib/", "/usr/lib0");
+    printTree(t);
+
+    return 0;
+}
@@ -0,0 +1,645 @@
+#ifndef __TREE_ITERATOR_H__
+#define __TREE_ITERATOR_H__
+
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <algorithm>
+
+// The nearest ancestors of an iterator position, kept inside the iterator
+// so that a step never allocates. Entries are stored by depth modulo
+// Capacity: descending past Capacity levels overwrites the shallowest
+// ones, and holdsParent() turns false once a climb reaches them. The
+// iterator then walks down from the root again to its position. As long
+// as the tree is no taller than Capacity that never happens; in a taller
+// one it happens after at least Capacity levels of net climb, i.e. after
+// a subtree of at least Capacity elements has been passed.
+template <class Entry, size_t Capacity>
+class IteratorPath
+{
+public:
+
+    IteratorPath()
+        : mDepth(0), mLow(0) {}
+
+    size_t depth() const { return mDepth; }
+
+    bool holdsParent() const { return mDepth > mLow; }
+
+    void clear() { mDepth = mLow = 0; }
+
+    void push(const Entry & entry)
+    {
+        mEntries[mDepth % Capacity] = entry;
+        if (++mDepth - mLow > Capacity)
+            mLow = mDepth - Capacity;
+    }
+
+    const Entry & pop() { return mEntries[--mDepth % Capacity]; }
+
+    // Drops the ancestors deeper than depth, after a search that went on
+    // below the position it settled on.
+    void truncate(size_t depth)
+    {
+        mDepth = depth;
+        mLow = std::min(mLow, depth);
+    }
+
+private:
+
+    Entry mEntries[Capacity];
+
+    size_t mDepth, mLow;
+};
+
+// Bidirectional iterator over the in-order elements of BinarySearchTree,
+// AVLTree and RedBlackTree. Node must provide element, left() and right().
+//
+// The nodes have no parent pointers, so the iterator keeps the path from
+// the root to its element. Going down pushes the nodes left behind and
+// going up pops them, so a walk over the whole tree touches every edge
+// twice: a step is amortized O(1). The end iterator holds no node; stepping
+// back from it finds the largest element.
+//
+// Any insert or erase invalidates every iterator of the tree. As with
+// find(), constness is shallow: the values can be changed through an
+// iterator of a const tree.
+template <class Node>
+class BinaryTreeIterator
+{
+public:
+
+    typedef std::bidirectional_iterator_tag iterator_category;
+    typedef typename Node::elem_type value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef value_type* pointer;
+    typedef value_type& reference;
+
+public:
+
+    BinaryTreeIterator()
+        : mRoot(NULL), mNode(NULL) {}
+
+    explicit BinaryTreeIterator(Node * const * root)
+        : mRoot(root), mNode(NULL) {}
+
+    static BinaryTreeIterator first(Node * const *);
+
+    template <class K>
+    static BinaryTreeIterator lowerBound(Node * const *, const K &);
+
+    template <class K>
+    static BinaryTreeIterator upperBound(Node * const *, const K &);
+
+    reference operator * () const { return mNode->element; }
+
+    pointer operator -> () const { return &mNode->element; }
+
+    BinaryTreeIterator & operator ++ ();
+
+    BinaryTreeIterator operator ++ (int);
+
+    BinaryTreeIterator & operator -- ();
+
+    BinaryTreeIterator operator -- (int);
+
+    bool operator == (const BinaryTreeIterator & other) const
+    {
+        return mNode == other.mNode;
+    }
+
+    bool operator != (const BinaryTreeIterator & other) const
+    {
+        return mNode != other.mNode;
+    }
+
+private:
+
+    // Deep enough for any AVL tree of up to 2^32 elements, and for any
+    // red-black tree of up to 2^24.
+    static const size_t PATH_CAPACITY = 48;
+
+    void descendLeftmost(Node *);
+
+    void descendRightmost(Node *);
+
+    Node * climb();
+
+    Node * const * mRoot;
+
+    Node * mNode;
+
+    IteratorPath<Node *, PATH_CAPACITY> mPath;
+};
+
+template <class Node>
+BinaryTreeIterator<Node> BinaryTreeIterator<Node>::first(Node * const * root)
+{
+    BinaryTreeIterator result(root);
+    if (*root != NULL)
+        result.descendLeftmost(*root);
+
+    return result;
+}
+
+// The first element whose key is not less than key. The search goes on
+// below it only while it has not met key itself.
+template <class Node>
+template <class K>
+BinaryTreeIterator<Node> BinaryTreeIterator<Node>::lowerBound(Node * const * root,
+        const K & key)
+{
+    BinaryTreeIterator result(root);
+    size_t depth = 0;
+
+    Node * t = *root;
+    while (t != NULL)
+    {
+        if (t->element.first < key)
+        {
+            result.mPath.push(t);
+            t = t->right();
+            continue;
+        }
+
+        result.mNode = t;
+        depth = result.mPath.depth();
+        if (!(key < t->element.first))
+            break;
+
+        result.mPath.push(t);
+        t = t->left();
+    }
+
+    result.mPath.truncate(depth);
+    return result;
+}
+
+// The first element whose key is greater than key.
+template <class Node>
+template <class K>
+BinaryTreeIterator<Node> BinaryTreeIterator<Node>::upperBound(Node * const * root,
+        const K & key)
+{
+    BinaryTreeIterator result(root);
+    size_t depth = 0;
+
+    for (Node * t = *root; t != NULL; )
+    {
+        if (key < t->element.first)
+        {
+            result.mNode = t;
+            depth = result.mPath.depth();
+            result.mPath.push(t);
+            t = t->left();
+        }
+        else
+        {
+            result.mPath.push(t);
+            t = t->right();
+        }
+    }
+
+    result.mPath.truncate(depth);
+    return result;
+}
+
+// The next element is the leftmost one of the right subtree, or else the
+// nearest ancestor whose left subtree holds this one.
+template <class Node>
+BinaryTreeIterator<Node> & BinaryTreeIterator<Node>::operator ++ ()
+{
+    if (mNode->right() != NULL)
+    {
+        mPath.push(mNode);
+        descendLeftmost(mNode->right());
+        return *this;
+    }
+
+    for (;;)
+    {
+        if (mPath.depth() == 0)
+        {
+            mNode = NULL;
+            return *this;
+        }
+
+        Node * child = mNode;
+        mNode = climb();
+        if (mNode->left() == child)
+            return *this;
+    }
+}
+
+template <class Node>
+BinaryTreeIterator<Node> BinaryTreeIterator<Node>::operator ++ (int)
+{
+    BinaryTreeIterator result(*this);
+    ++*this;
+
+    return result;
+}
+
+template <class Node>
+BinaryTreeIterator<Node> & BinaryTreeIterator<Node>::operator -- ()
+{
+    if (mNode == NULL)
+    {
+        mPath.clear();
+        descendRightmost(*mRoot);
+        return *this;
+    }
+
+    if (mNode->left() != NULL)
+    {
+        mPath.push(mNode);
+        descendRightmost(mNode->left());
+        return *this;
+    }
+
+    for (;;)
+    {
+        if (mPath.depth() == 0)
+        {
+            mNode = NULL;
+            return *this;
+        }
+
+        Node * child = mNode;
+        mNode = climb();
+        if (mNode->right() == child)
+            return *this;
+    }
+}
+
+template <class Node>
+BinaryTreeIterator<Node> BinaryTreeIterator<Node>::operator -- (int)
+{
+    BinaryTreeIterator result(*this);
+    --*this;
+
+    return result;
+}
+
+template <class Node>
+void BinaryTreeIterator<Node>::descendLeftmost(Node * t)
+{
+    while (t->left() != NULL)
+    {
+        mPath.push(t);
+        t = t->left();
+    }
+
+    mNode = t;
+}
+
+template <class Node>
+void BinaryTreeIterator<Node>::descendRightmost(Node * t)
+{
+    while (t->right() != NULL)
+    {
+        mPath.push(t);
+        t = t->right();
+    }
+
+    mNode = t;
+}
+
+// Returns the parent of the current node, finding the path to it again by
+// its key if the iterator no longer holds it.
+template <class Node>
+Node * BinaryTreeIterator<Node>::climb()
+{
+    if (!mPath.holdsParent())
+    {
+        mPath.clear();
+        for (Node * t = *mRoot; t != mNode; )
+        {
+            mPath.push(t);
+            t = mNode->element.first < t->element.first ? t->left() : t->right();
+        }
+    }
+
+    return mPath.pop();
+}
+
+// Bidirectional iterator over the in-order elements of BTree, whose keys
+// and values lie in separate arrays: dereferencing gives a pair of
+// references rather than a reference to a pair, and -> goes through a
+// proxy holding that pair.
+//
+// It keeps the path of (node, child slot) pairs from the root like
+// BinaryTreeIterator, with the same cost and the same rules: any change
+// to the tree invalidates it, and constness is shallow. Nodes that
+// prefix-compress their keys rebuild the one under the iterator inside
+// it, so the key reference stays valid only until the iterator moves or
+// goes away.
+template <class Node>
+class BTreeIterator
+{
+public:
+
+    typedef typename Node::key_type key_type;
+    typedef typename Node::value_type mapped_type;
+
+    typedef std::bidirectional_iterator_tag iterator_category;
+    typedef std::pair<key_type, mapped_type> value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef std::pair<const key_type &, mapped_type &> reference;
+
+    struct pointer
+    {
+        reference element;
+
+        const reference * operator -> () const { return &element; }
+    };
+
+public:
+
+    BTreeIterator()
+        : mRoot(NULL), mNode(NULL), mIndex(0) {}
+
+    explicit BTreeIterator(Node * const * root)
+        : mRoot(root), mNode(NULL), mIndex(0) {}
+
+    static BTreeIterator first(Node * const *);
+
+    template <class K>
+    static BTreeIterator lowerBound(Node * const *, const K &);
+
+    template <class K>
+    static BTreeIterator upperBound(Node * const *, const K &);
+
+    reference operator * () const
+    {
+        return reference(mNode->key(mIndex, mKey), mNode->values[mIndex]);
+    }
+
+    pointer operator -> () const { return pointer{**this}; }
+
+    BTreeIterator & operator ++ ();
+
+    BTreeIterator operator ++ (int);
+
+    BTreeIterator & operator -- ();
+
+    BTreeIterator operator -- (int);
+
+    bool operator == (const BTreeIterator & other) const
+    {
+        return mNode == other.mNode && mIndex == other.mIndex;
+    }
+
+    bool operator != (const BTreeIterator & other) const
+    {
+        return !(*this == other);
+    }
+
+private:
+
+    struct PathEntry
+    {
+        Node * node;
+        size_t index;
+    };
+
+    // Every level fans out at least twice, so this covers 2^16 elements
+    // in the worst case and far more at usual fan-outs.
+    static const size_t PATH_CAPACITY = 16;
+
+    void descendLeftmost(Node *);
+
+    void descendRightmost(Node *);
+
+    PathEntry climb();
+
+    Node * const * mRoot;
+
+    Node * mNode;
+
+    size_t mIndex;
+
+    IteratorPath<PathEntry, PATH_CAPACITY> mPath;
+
+    // Where a node that does not store its keys whole rebuilds the one
+    // under the iterator.
+    mutable typename Node::key_buffer mKey;
+};
+
+template <class Node>
+BTreeIterator<Node> BTreeIterator<Node>::first(Node * const * root)
+{
+    BTreeIterator result(root);
+    if (*root != NULL)
+        result.descendLeftmost(*root);
+
+    return result;
+}
+
+template <class Node>
+template <class K>
+BTreeIterator<Node> BTreeIterator<Node>::lowerBound(Node * const * root, const K & key)
+{
+    BTreeIterator result(root);
+    size_t depth = 0;
+
+    for (Node * t = *root; t != NULL; )
+    {
+        size_t index = t->lowerBound(key);
+
+        if (index < t->size)
+        {
+            result.mNode = t;
+            result.mIndex = index;
+            depth = result.mPath.depth();
+            if (t->keyEquals(index, key))
+                break;
+        }
+
+        result.mPath.push(PathEntry{t, index});
+        t = t->children[index];
+    }
+
+    result.mPath.truncate(depth);
+    return result;
+}
+
+template <class Node>
+template <class K>
+BTreeIterator<Node> BTreeIterator<Node>::upperBound(Node * const * root, const K & key)
+{
+    BTreeIterator result(root);
+    size_t depth = 0;
+
+    for (Node * t = *root; t != NULL; )
+    {
+        size_t index = t->lowerBound(key);
+        if (index < t->size && t->keyEquals(index, key))
+            index++;
+
+        if (index < t->size)
+        {
+            result.mNode = t;
+            result.mIndex = index;
+            depth = result.mPath.depth();
+        }
+
+        result.mPath.push(PathEntry{t, index});
+        t = t->children[index];
+    }
+
+    result.mPath.truncate(depth);
+    return result;
+}
+
+// In an inner node the next element is the leftmost one under the child
+// to the right of this key; in a leaf it is the next key, or, past the
+// last one, the key of the nearest ancestor on the right. While climbing,
+// the position rests on a key of the node reached, for climb() to find
+// the path by if it has to.
+template <class Node>
+BTreeIterator<Node> & BTreeIterator<Node>::operator ++ ()
+{
+    Node * child = mNode->children[mIndex + 1];
+    if (child != NULL)
+    {
+        mPath.push(PathEntry{mNode, mIndex + 1});
+        descendLeftmost(child);
+        return *this;
+    }
+
+    if (mIndex + 1 < mNode->size)
+    {
+        mIndex++;
+        return *this;
+    }
+
+    for (;;)
+    {
+        if (mPath.depth() == 0)
+        {
+            mNode = NULL;
+            mIndex = 0;
+            return *this;
+        }
+
+        PathEntry parent = climb();
+        mNode = parent.node;
+        if (parent.index < mNode->size)
+        {
+            mIndex = parent.index;
+            return *this;
+        }
+        mIndex = mNode->size - 1;
+    }
+}
+
+template <class Node>
+BTreeIterator<Node> BTreeIterator<Node>::operator ++ (int)
+{
+    BTreeIterator result(*this);
+    ++*this;
+
+    return result;
+}
+
+template <class Node>
+BTreeIterator<Node> & BTreeIterator<Node>::operator -- ()
+{
+    if (mNode == NULL)
+    {
+        mPath.clear();
+        descendRightmost(*mRoot);
+        return *this;
+    }
+
+    Node * child = mNode->children[mIndex];
+    if (child != NULL)
+    {
+        mPath.push(PathEntry{mNode, mIndex});
+        descendRightmost(child);
+        return *this;
+    }
+
+    if (mIndex > 0)
+    {
+        mIndex--;
+        return *this;
+    }
+
+    for (;;)
+    {
+        if (mPath.depth() == 0)
+        {
+            mNode = NULL;
+            return *this;
+        }
+
+        PathEntry parent = climb();
+        mNode = parent.node;
+        if (parent.index > 0)
+        {
+            mIndex = parent.index - 1;
+            return *this;
+        }
+        mIndex = 0;
+    }
+}
+
+template <class Node>
+BTreeIterator<Node> BTreeIterator<Node>::operator -- (int)
+{
+    BTreeIterator result(*this);
+    --*this;
+
+    return result;
+}
+
+template <class Node>
+void BTreeIterator<Node>::descendLeftmost(Node * t)
+{
+    while (t->children[0] != NULL)
+    {
+        mPath.push(PathEntry{t, 0});
+        t = t->children[0];
+    }
+
+    mNode = t;
+    mIndex = 0;
+}
+
+template <class Node>
+void BTreeIterator<Node>::descendRightmost(Node * t)
+{
+    while (t->children[t->size] != NULL)
+    {
+        mPath.push(PathEntry{t, t->size});
+        t = t->children[t->size];
+    }
+
+    mNode = t;
+    mIndex = t->size - 1;
+}
+
+// Returns the parent entry of the current node, searching the path to it
+// again by the key under the iterator if it is no longer held.
+template <class Node>
+typename BTreeIterator<Node>::PathEntry BTreeIterator<Node>::climb()
+{
+    if (!mPath.holdsParent())
+    {
+        const key_type & key = mNode->key(mIndex, mKey);
+
+        mPath.clear();
+        for (Node * t = *mRoot; t != mNode; )
+        {
+            size_t index = t->lowerBound(key);
+            mPath.push(PathEntry{t, index});
+            t = t->children[index];
+        }
+    }
+
+    return mPath.pop();
+}
+
+#endif//__TREE_ITERATOR_H__
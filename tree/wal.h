@@ -0,0 +1,312 @@
+#ifndef __WAL_H__
+#define __WAL_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// Append-only log of insert and erase records.
+//
+// Records are buffered in memory and written by commit() as one frame: a
+// header with the payload length and checksum followed by the records, in
+// a single write and a single fdatasync. A record is a one-byte tag, the
+// raw key and, for inserts, the raw value. Opening the log does not read
+// it; replay() applies every complete frame and cuts the file at the first
+// torn or damaged one, which is where a crash in the middle of a commit
+// leaves the end of the file. The frame header counts the payload in 32
+// bits, so a record that would take the pending frame past
+// MAX_FRAME_BYTES commits the records before it first.
+template <class K, class V>
+class WriteAheadLog
+{
+public:
+
+    enum Op
+    {
+        INSERT = 1,
+        ERASE = 2
+    };
+
+    struct FrameHeader
+    {
+        uint32_t bytes;
+        uint32_t checksum;
+    };
+
+    static const size_t MAX_FRAME_BYTES = UINT32_MAX;
+
+    static_assert(std::is_trivially_copyable<K>::value &&
+            std::is_trivially_copyable<V>::value,
+            "logged keys and values must be trivially copyable");
+
+public:
+
+    explicit WriteAheadLog(const char *);
+
+    ~WriteAheadLog();
+
+    template <class Tree>
+    size_t replay(Tree &);
+
+    void logInsert(const K &, const V &);
+
+    void logErase(const K &);
+
+    void commit();
+
+    void reset();
+
+    size_t pending() const;
+
+    uint64_t bytes() const;
+
+    static uint32_t checksum(const char *, size_t);
+
+private:
+
+    WriteAheadLog(const WriteAheadLog &);
+
+    WriteAheadLog & operator = (const WriteAheadLog &);
+
+    void reserve(size_t);
+
+    void append(const void *, size_t);
+
+    void writeAll(const char *, size_t);
+
+    static void fail(const std::string &);
+
+    int mFile;
+
+    std::vector<char> mBuffer;
+
+    size_t mPending;
+
+    uint64_t mFileSize;
+};
+
+template <class K, class V>
+WriteAheadLog<K, V>::WriteAheadLog(const char * path)
+    : mFile(-1), mPending(0), mFileSize(0)
+{
+    mFile = ::open(path, O_RDWR | O_CREAT, 0644);
+    if (mFile < 0)
+        fail(std::string("cannot open ") + path);
+
+    struct stat st;
+    if (::fstat(mFile, &st) != 0)
+    {
+        int error = errno;
+        ::close(mFile);
+        errno = error;
+        fail("cannot stat log file");
+    }
+    mFileSize = st.st_size;
+
+    // The buffer starts with room for the header of the next frame.
+    mBuffer.resize(sizeof(FrameHeader));
+}
+
+template <class K, class V>
+WriteAheadLog<K, V>::~WriteAheadLog()
+{
+    // Records not committed are dropped, as a crash would drop them.
+    ::close(mFile);
+}
+
+// Applies the logged records to the tree in order and returns how many
+// there were. Appends made after replay() go after the last good frame.
+template <class K, class V>
+template <class Tree>
+size_t WriteAheadLog<K, V>::replay(Tree & tree)
+{
+    std::vector<char> data(mFileSize);
+    size_t read = 0;
+    while (read < data.size())
+    {
+        ssize_t n = ::pread(mFile, &data[read], data.size() - read, read);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            fail("cannot read log file");
+        read += n;
+    }
+
+    size_t records = 0;
+    size_t offset = 0;
+    while (data.size() - offset >= sizeof(FrameHeader))
+    {
+        FrameHeader header;
+        std::memcpy(&header, &data[offset], sizeof header);
+
+        const char * payload = &data[offset] + sizeof header;
+        if (header.bytes > data.size() - offset - sizeof header ||
+                checksum(payload, header.bytes) != header.checksum)
+            break;
+
+        // Frames are built only by commit(), so a frame that passed the
+        // checksum holds whole records.
+        const char * end = payload + header.bytes;
+        while (payload < end)
+        {
+            char op = *payload++;
+            K key;
+            std::memcpy(&key, payload, sizeof key);
+            payload += sizeof key;
+
+            if (op == INSERT)
+            {
+                V value;
+                std::memcpy(&value, payload, sizeof value);
+                payload += sizeof value;
+                tree.insert(key, value);
+            }
+            else
+                tree.erase(key);
+
+            records++;
+        }
+
+        offset += sizeof header + header.bytes;
+    }
+
+    if (offset < mFileSize)
+    {
+        if (::ftruncate(mFile, offset) != 0 || ::fdatasync(mFile) != 0)
+            fail("cannot cut the torn end of the log file");
+        mFileSize = offset;
+    }
+
+    return records;
+}
+
+template <class K, class V>
+void WriteAheadLog<K, V>::logInsert(const K & key, const V & value)
+{
+    char op = INSERT;
+    reserve(1 + sizeof key + sizeof value);
+    append(&op, 1);
+    append(&key, sizeof key);
+    append(&value, sizeof value);
+    mPending++;
+}
+
+template <class K, class V>
+void WriteAheadLog<K, V>::logErase(const K & key)
+{
+    char op = ERASE;
+    reserve(1 + sizeof key);
+    append(&op, 1);
+    append(&key, sizeof key);
+    mPending++;
+}
+
+// Writes the buffered records as one frame and waits until they are on
+// disk. Does nothing when no record is pending.
+template <class K, class V>
+void WriteAheadLog<K, V>::commit()
+{
+    if (mPending == 0)
+        return;
+
+    FrameHeader header;
+    header.bytes = uint32_t(mBuffer.size() - sizeof header);
+    header.checksum = checksum(&mBuffer[sizeof header], header.bytes);
+    std::memcpy(&mBuffer[0], &header, sizeof header);
+
+    writeAll(&mBuffer[0], mBuffer.size());
+    if (::fdatasync(mFile) != 0)
+        fail("cannot sync log file");
+
+    mFileSize += mBuffer.size();
+    mBuffer.resize(sizeof header);
+    mPending = 0;
+}
+
+// Empties the log, once a checkpoint holds everything it recorded.
+template <class K, class V>
+void WriteAheadLog<K, V>::reset()
+{
+    if (::ftruncate(mFile, 0) != 0 || ::fdatasync(mFile) != 0)
+        fail("cannot truncate log file");
+
+    mFileSize = 0;
+    mBuffer.resize(sizeof(FrameHeader));
+    mPending = 0;
+}
+
+template <class K, class V>
+size_t WriteAheadLog<K, V>::pending() const
+{
+    return mPending;
+}
+
+// Committed bytes in the log file.
+template <class K, class V>
+uint64_t WriteAheadLog<K, V>::bytes() const
+{
+    return mFileSize;
+}
+
+// 32-bit FNV-1a; enough to tell a torn frame from a written one.
+template <class K, class V>
+uint32_t WriteAheadLog<K, V>::checksum(const char * data, size_t size)
+{
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= uint8_t(data[i]);
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+// Makes room in the pending frame for a record of size bytes.
+template <class K, class V>
+void WriteAheadLog<K, V>::reserve(size_t size)
+{
+    if (mBuffer.size() - sizeof(FrameHeader) + size > MAX_FRAME_BYTES)
+        commit();
+}
+
+template <class K, class V>
+void WriteAheadLog<K, V>::append(const void * data, size_t size)
+{
+    const char * bytes = static_cast<const char *>(data);
+    mBuffer.insert(mBuffer.end(), bytes, bytes + size);
+}
+
+template <class K, class V>
+void WriteAheadLog<K, V>::writeAll(const char * data, size_t size)
+{
+    size_t written = 0;
+    while (written < size)
+    {
+        ssize_t n = ::pwrite(mFile, data + written, size - written,
+                mFileSize + written);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            fail("cannot write log file");
+        written += n;
+    }
+}
+
+template <class K, class V>
+void WriteAheadLog<K, V>::fail(const std::string & message)
+{
+    throw std::runtime_error(message + ": " + std::strerror(errno));
+}
+
+#endif//__WAL_H__